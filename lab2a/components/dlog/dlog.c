@@ -0,0 +1,160 @@
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_freertos_hooks.h"
+#include "hal/cpu_hal.h"
+#include "sdkconfig.h"
+#include "dlog.h"
+
+#define RING_MASK               (DLOG_RING_LEN - 1)
+#define CYCLES_PER_MS           (CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ * 1000)
+
+_Static_assert((DLOG_RING_LEN & RING_MASK) == 0, "DLOG_RING_LEN must be a power of 2");
+
+static const char *TAG = "DLOG";
+
+typedef struct {
+    _Atomic uint32_t head;      //next index to claim
+    _Atomic uint32_t tail;      //next index to read
+    _Atomic uint32_t dropped;
+    _Atomic uint32_t now_cycles;    //cycle count of this core at its last tick, 0 before the first one
+    dlog_rec_t recs[DLOG_RING_LEN];
+} dlog_ring_t;
+
+/*
+the cycle counters are per core and not in sync, the drain can only compare a record with a count taken on the
+same core. the tick hook of every core stores its own count, each pass moves the core's base to it. records are
+at most a few passes old, so their signed distance to the base never gets near the 2^31 cycles (~13.4 s at
+160 MHz) where it would flip sign, even when a core logs nothing for a long time.
+*/
+typedef struct {
+    bool seeded;                //the base is taken from the core's first tick sample
+    uint32_t base_cycles;
+    uint64_t base;              //base_cycles extended past the 32 bit wrap (~27 s at 160 MHz)
+    uint32_t dropped_seen;
+} drain_core_t;
+
+static dlog_ring_t rings[portNUM_PROCESSORS];
+static drain_core_t drain_cores[portNUM_PROCESSORS];
+
+static const char level_chars[] = { 'N', 'E', 'W', 'I', 'D', 'V' };
+
+/*================= WRITE =================*/
+void dlog_write(esp_log_level_t level, const char *tag, const char *fmt, int arg_cnt, ...) {
+    uint32_t cycles = cpu_hal_get_cycle_count();
+    dlog_ring_t *ring = &rings[xPortGetCoreID()];
+
+    //claim a slot, a task preempted here only delays the one that preempted it by a retry
+    uint32_t h = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    do {
+        if (h - atomic_load_explicit(&ring->tail, memory_order_acquire) >= DLOG_RING_LEN) {
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            return;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&ring->head, &h, h + 1, memory_order_relaxed,
+                                                    memory_order_relaxed));
+
+    dlog_rec_t *rec = &ring->recs[h & RING_MASK];
+    rec->cycles = cycles;
+    rec->tag = tag;
+    rec->fmt = fmt;
+    rec->level = level;
+    rec->arg_cnt = arg_cnt;
+
+    va_list ap;
+    va_start(ap, arg_cnt);
+    for (int i = 0; i < arg_cnt; i++) rec->args[i] = va_arg(ap, uint32_t);
+    va_end(ap);
+
+    //the reader only takes the slot once seq says it is complete
+    atomic_store_explicit((_Atomic uint32_t *)&rec->seq, h + 1, memory_order_release);
+}
+
+/*================= READ =================*/
+bool dlog_read(int core, dlog_rec_t *rec) {
+    dlog_ring_t *ring = &rings[core];
+    uint32_t t = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    dlog_rec_t *slot = &ring->recs[t & RING_MASK];
+
+    //an older writer may still fill its slot while a newer one is done, records come out in claim order
+    if (atomic_load_explicit((_Atomic uint32_t *)&slot->seq, memory_order_acquire) != t + 1) return false;
+    *rec = *slot;
+    atomic_store_explicit(&ring->tail, t + 1, memory_order_release);
+    return true;
+}
+
+uint32_t dlog_dropped(int core) {
+    return atomic_load_explicit(&rings[core].dropped, memory_order_relaxed);
+}
+
+/*================= DRAIN =================*/
+static void IRAM_ATTR dlog_tick(void) {
+    atomic_store_explicit(&rings[xPortGetCoreID()].now_cycles, cpu_hal_get_cycle_count(), memory_order_relaxed);
+}
+
+/* move the base of core to its last tick sample, false until the core ticked once */
+static bool drain_advance(int core, drain_core_t *dc) {
+    uint32_t now = atomic_load_explicit(&rings[core].now_cycles, memory_order_relaxed);
+    if (now == 0) return dc->seeded;
+
+    if (!dc->seeded) {
+        //the counter started at boot and has not wrapped yet this early, the stamps stay time since boot
+        dc->base = now;
+        dc->seeded = true;
+    } else {
+        dc->base += now - dc->base_cycles;
+    }
+    dc->base_cycles = now;
+    return true;
+}
+
+static void drain_print(const drain_core_t *dc, const dlog_rec_t *rec) {
+    //signed, records are from shortly before or after the tick the base was taken at
+    uint64_t cycles = dc->base + (int32_t)(rec->cycles - dc->base_cycles);
+
+    char level = (rec->level < sizeof(level_chars)) ? level_chars[rec->level] : '?';
+    printf("%c (%u) %s: ", level, (unsigned int)(cycles / CYCLES_PER_MS), rec->tag);
+    //unused args are ignored by printf, every arg is a 32 bit word like on the call
+    printf(rec->fmt, rec->args[0], rec->args[1], rec->args[2], rec->args[3]);
+    printf("\n");
+}
+
+static void dlog_drain(void *pvParameters) {
+    dlog_rec_t rec;
+
+    for (;;) {
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            drain_core_t *dc = &drain_cores[core];
+            //advanced on every pass, also when the core logged nothing
+            if (!drain_advance(core, dc)) continue;
+            while (dlog_read(core, &rec)) drain_print(dc, &rec);
+
+            uint32_t dropped = dlog_dropped(core);
+            if (dropped != dc->dropped_seen) {
+                printf("W (%u) %s: core %d dropped %u records\n", (unsigned int)(dc->base / CYCLES_PER_MS), TAG,
+                       core, (unsigned int)(dropped - dc->dropped_seen));
+                dc->dropped_seen = dropped;
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(DLOG_DRAIN_PERIOD_MS));
+    }
+
+    vTaskDelete(NULL);
+}
+
+void dlog_init(void) {
+    //every core samples its own counter, the calling core's count means nothing for the other one
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        drain_cores[core].seeded = false;
+        esp_register_freertos_tick_hook_for_cpu(dlog_tick, core);
+    }
+
+    if (xTaskCreatePinnedToCore(&dlog_drain, "dlog_drain", DLOG_DRAIN_STACK, NULL, DLOG_DRAIN_PRIO, NULL,
+                                DLOG_DRAIN_CORE) == pdPASS) {
+        ESP_LOGI(TAG, "dlog_drain created success, %d records of %d bytes per core", DLOG_RING_LEN,
+                 (int)sizeof(dlog_rec_t));
+    }
+}
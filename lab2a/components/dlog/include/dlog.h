@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_log.h"
+
+/*
+deferred binary log: a log call stores a fixed size record instead of formatting and writing to the uart.
+
+- a record is the cpu cycle count, tag and format pointers (their ids, both must point to constant strings),
+the level and up to DLOG_ARG_MAX 32 bit args. 64 bit and float args are not supported.
+- %s args are stored as pointers too, only constant strings can be passed.
+- every core has its own ring, writers claim a slot with a compare and swap and commit it with a sequence number,
+so tasks and isrs log without locks. a full ring drops the new record and counts it.
+- a drain task (dlog_init) formats the records in the esp log format "I (ms) TAG: msg" some time later, outside
+the code being measured. dlog_read gives the raw records to another consumer instead.
+- the drain runs at the idle priority, it never preempts a task that logs, and is pinned to the last core: on a
+dual core build it stays off core 0 where the labs run their tasks. on a single core build it shares its time
+slice round robin with the other idle priority tasks, so a task that spins at that priority is still switched by
+the tick and not by the drain, and its records beyond what the uart drains in that slice are dropped.
+a tick hook on every core samples that core's cycle counter, the drain turns record stamps into ms with it.
+- DLOGx takes the same arguments as ESP_LOGx. defining DLOG_REPLACE_ESP_LOG before including this header
+turns the ESP_LOGx calls of that file into DLOGx.
+*/
+
+#ifndef DLOG_RING_LEN
+#define DLOG_RING_LEN           256     //records per core, power of 2
+#endif
+#define DLOG_ARG_MAX            4
+#define DLOG_DRAIN_PERIOD_MS    100
+#define DLOG_DRAIN_PRIO         tskIDLE_PRIORITY
+#define DLOG_DRAIN_CORE         (portNUM_PROCESSORS - 1)
+#define DLOG_DRAIN_STACK        2048
+
+typedef struct {
+    uint32_t seq;               //ring index + 1 once the record is complete
+    uint32_t cycles;            //cpu cycle count of the core that logged
+    const char *tag;
+    const char *fmt;
+    uint8_t level;              //esp_log_level_t
+    uint8_t arg_cnt;
+    uint32_t args[DLOG_ARG_MAX];
+} dlog_rec_t;
+
+void dlog_init(void);
+
+void dlog_write(esp_log_level_t level, const char *tag, const char *fmt, int arg_cnt, ...)
+    __attribute__((format(printf, 3, 5)));
+
+/* next record logged on core into rec, false when there is none. one reader per core */
+bool dlog_read(int core, dlog_rec_t *rec);
+
+/* records dropped on core because its ring was full */
+uint32_t dlog_dropped(int core);
+
+#define DLOG_NARGS_(_0, _1, _2, _3, _4, _5, N, ...) N
+#define DLOG_NARGS(...) DLOG_NARGS_(_, ##__VA_ARGS__, 5, 4, 3, 2, 1, 0)
+
+#define DLOG_LEVEL(level, tag, fmt, ...) do {                                               \
+        _Static_assert(DLOG_NARGS(__VA_ARGS__) <= DLOG_ARG_MAX, "too many dlog args");      \
+        if (LOG_LOCAL_LEVEL >= (level)) {                                                   \
+            dlog_write((level), (tag), (fmt), DLOG_NARGS(__VA_ARGS__), ##__VA_ARGS__);       \
+        }                                                                                   \
+    } while (0)
+
+#define DLOGE(tag, fmt, ...) DLOG_LEVEL(ESP_LOG_ERROR, tag, fmt, ##__VA_ARGS__)
+#define DLOGW(tag, fmt, ...) DLOG_LEVEL(ESP_LOG_WARN, tag, fmt, ##__VA_ARGS__)
+#define DLOGI(tag, fmt, ...) DLOG_LEVEL(ESP_LOG_INFO, tag, fmt, ##__VA_ARGS__)
+#define DLOGD(tag, fmt, ...) DLOG_LEVEL(ESP_LOG_DEBUG, tag, fmt, ##__VA_ARGS__)
+#define DLOGV(tag, fmt, ...) DLOG_LEVEL(ESP_LOG_VERBOSE, tag, fmt, ##__VA_ARGS__)
+
+#ifdef DLOG_REPLACE_ESP_LOG
+#undef ESP_LOGE
+#undef ESP_LOGW
+#undef ESP_LOGI
+#undef ESP_LOGD
+#undef ESP_LOGV
+#define ESP_LOGE DLOGE
+#define ESP_LOGW DLOGW
+#define ESP_LOGI DLOGI
+#define ESP_LOGD DLOGD
+#define ESP_LOGV DLOGV
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "trace_rec_hooks.h"
+
+/*
+scheduler trace recorder: the freertos trace macros (trace_rec_hooks.h) write binary events into a ram ring,
+the tasks being measured print nothing.
+
+- an event is 12 bytes: cpu cycle count, type, slot of the task running on the core, slot of the object
+(the previous task for a switch) and a 32 bit arg. tasks get a slot and their name copied the first time
+they are switched in, a deleted task keeps its slot so a new task in the same memory gets a new one.
+queues and event groups are only recorded once named with trace_rec_name_object.
+- every core has its own ring and writes it with its interrupts masked, the ring keeps the newest
+TRACE_REC_RING_LEN events.
+- a switch is only written when another task comes in. the event carries the cycle count of the switch out,
+so the old task ends exactly there.
+- the tick is recorded too, so the host can extend the 32 bit cycle counter (it wraps every ~27 s at 160 MHz).
+- the cycles spent inside the hooks are counted, the dump prints them against the recorded time.
+- per task counters: cycles run on each core and migrations between cores. the running task is accounted each
+time the scheduler runs on its core (every tick with time slicing), so a read lags by at most that much.
+trace_rec_count_start keeps only these, for a monitor that has no use for the ring.
+- trace_rec_dump stops recording and prints the rings as "TRACE_REC ..." lines. tools/trace_rec.py turns a
+capture holding them into chrome trace json (chrome://tracing, ui.perfetto.dev). it sleeps a tick every few
+lines, the dump task of trace_rec_init wakes at the top priority to stop on time and prints at priority 1.
+*/
+
+#ifndef TRACE_REC_RING_LEN
+#define TRACE_REC_RING_LEN      2048    //events per core, power of 2
+#endif
+#define TRACE_REC_TASK_MAX      32
+#define TRACE_REC_OBJ_MAX       16
+#define TRACE_REC_NAME_LEN      16
+#define TRACE_REC_NO_SLOT       0xff
+#define TRACE_REC_CORE_MAX      2
+
+typedef struct {
+    uint32_t cycles;
+    uint8_t type;               //TRACE_REC_EV_x, TRACE_REC_FROM_ISR or'ed in
+    uint8_t task;
+    uint8_t obj;
+    uint8_t pad;
+    uint32_t arg;
+} trace_rec_ev_t;
+
+#define TRACE_REC_FROM_ISR      0x80
+
+typedef struct {
+    void *handle;               //NULL once the task is deleted
+    char name[TRACE_REC_NAME_LEN];
+    uint32_t run_cycles[TRACE_REC_CORE_MAX];    //cpu cycles run on each core, wraps (~27 s at 160 MHz)
+    uint32_t migrations;        //switched in on another core than the last time
+    int8_t last_core;           //-1 until it ran
+} trace_rec_task_stat_t;
+
+/* start recording, when dump_after_ms is not 0 a task dumps the rings that long after */
+void trace_rec_init(uint32_t dump_after_ms);
+
+/* record the calls on a queue, semaphore or event group under name (a constant string) */
+void trace_rec_name_object(void *obj, const char *name);
+
+/* keep only the per task counters, without filling the ring, trace_rec_init does both */
+void trace_rec_count_start(void);
+
+/* copy of the per task counters of up to max slots, returns how many */
+int trace_rec_task_stats(trace_rec_task_stat_t *out, int max);
+
+/* stops the ring, the counters go on */
+void trace_rec_stop(void);
+
+/* stop and print everything recorded, about 24 uart bytes per event */
+void trace_rec_dump(void);
@@ -0,0 +1,63 @@
+#pragma once
+
+/*
+freertos trace macros of the trace_rec recorder.
+
+- this header is force included (-include) into every source of the project by the project CMakeLists, so it
+is seen by tasks.c, queue.c and event_groups.c before FreeRTOS.h sets the empty defaults. it must not include
+anything itself, FreeRTOS.h would come in before these macros.
+- the queue macros read pxQueue->uxMessagesWaiting, they are only expanded inside queue.c where Queue_t is known.
+- only queues and event groups named with trace_rec_name_object are recorded. semaphores and mutexes are queues
+too, without the filter every printf lock would land in the ring.
+*/
+
+#ifndef __ASSEMBLER__
+
+#include <stdint.h>
+
+void trace_rec_switched_out(void);
+void trace_rec_switched_in(void);
+void trace_rec_tick(uint32_t tick);
+void trace_rec_task_deleted(void *task);
+void trace_rec_obj(uint8_t type, void *obj, uint32_t arg);
+void trace_rec_obj_isr(uint8_t type, void *obj, uint32_t arg);
+
+#define TRACE_REC_EV_SWITCH             1   //task: now running, obj: the task before it
+#define TRACE_REC_EV_TICK               2   //arg: tick count
+#define TRACE_REC_EV_Q_SEND             3   //arg: items in the queue before the call
+#define TRACE_REC_EV_Q_SEND_FAIL        4
+#define TRACE_REC_EV_Q_SEND_BLOCK       5
+#define TRACE_REC_EV_Q_RECV             6
+#define TRACE_REC_EV_Q_RECV_FAIL        7
+#define TRACE_REC_EV_Q_RECV_BLOCK       8
+#define TRACE_REC_EV_EG_SET             9   //arg: bits
+#define TRACE_REC_EV_EG_CLEAR           10
+#define TRACE_REC_EV_EG_WAIT_BLOCK      11
+#define TRACE_REC_EV_EG_WAIT_END        12
+#define TRACE_REC_EV_EG_WAIT_TIMEOUT    13
+
+#define traceTASK_SWITCHED_OUT()                        trace_rec_switched_out()
+#define traceTASK_SWITCHED_IN()                         trace_rec_switched_in()
+#define traceTASK_INCREMENT_TICK(xTickCount)            trace_rec_tick(xTickCount)
+#define traceTASK_DELETE(pxTaskToDelete)                trace_rec_task_deleted(pxTaskToDelete)
+
+#define traceQUEUE_SEND(pxQueue)                        trace_rec_obj(TRACE_REC_EV_Q_SEND, (pxQueue), (pxQueue)->uxMessagesWaiting)
+#define traceQUEUE_SEND_FAILED(pxQueue)                 trace_rec_obj(TRACE_REC_EV_Q_SEND_FAIL, (pxQueue), (pxQueue)->uxMessagesWaiting)
+#define traceBLOCKING_ON_QUEUE_SEND(pxQueue)            trace_rec_obj(TRACE_REC_EV_Q_SEND_BLOCK, (pxQueue), (pxQueue)->uxMessagesWaiting)
+#define traceQUEUE_RECEIVE(pxQueue)                     trace_rec_obj(TRACE_REC_EV_Q_RECV, (pxQueue), (pxQueue)->uxMessagesWaiting)
+#define traceQUEUE_RECEIVE_FAILED(pxQueue)              trace_rec_obj(TRACE_REC_EV_Q_RECV_FAIL, (pxQueue), (pxQueue)->uxMessagesWaiting)
+#define traceBLOCKING_ON_QUEUE_RECEIVE(pxQueue)         trace_rec_obj(TRACE_REC_EV_Q_RECV_BLOCK, (pxQueue), (pxQueue)->uxMessagesWaiting)
+#define traceQUEUE_SEND_FROM_ISR(pxQueue)               trace_rec_obj_isr(TRACE_REC_EV_Q_SEND, (pxQueue), (pxQueue)->uxMessagesWaiting)
+#define traceQUEUE_SEND_FROM_ISR_FAILED(pxQueue)        trace_rec_obj_isr(TRACE_REC_EV_Q_SEND_FAIL, (pxQueue), (pxQueue)->uxMessagesWaiting)
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue)            trace_rec_obj_isr(TRACE_REC_EV_Q_RECV, (pxQueue), (pxQueue)->uxMessagesWaiting)
+#define traceQUEUE_RECEIVE_FROM_ISR_FAILED(pxQueue)     trace_rec_obj_isr(TRACE_REC_EV_Q_RECV_FAIL, (pxQueue), (pxQueue)->uxMessagesWaiting)
+
+#define traceEVENT_GROUP_SET_BITS(xEventGroup, uxBitsToSet)                 trace_rec_obj(TRACE_REC_EV_EG_SET, (xEventGroup), (uxBitsToSet))
+#define traceEVENT_GROUP_SET_BITS_FROM_ISR(xEventGroup, uxBitsToSet)        trace_rec_obj_isr(TRACE_REC_EV_EG_SET, (xEventGroup), (uxBitsToSet))
+#define traceEVENT_GROUP_CLEAR_BITS(xEventGroup, uxBitsToClear)             trace_rec_obj(TRACE_REC_EV_EG_CLEAR, (xEventGroup), (uxBitsToClear))
+#define traceEVENT_GROUP_CLEAR_BITS_FROM_ISR(xEventGroup, uxBitsToClear)    trace_rec_obj_isr(TRACE_REC_EV_EG_CLEAR, (xEventGroup), (uxBitsToClear))
+#define traceEVENT_GROUP_WAIT_BITS_BLOCK(xEventGroup, uxBitsToWaitFor)      trace_rec_obj(TRACE_REC_EV_EG_WAIT_BLOCK, (xEventGroup), (uxBitsToWaitFor))
+#define traceEVENT_GROUP_WAIT_BITS_END(xEventGroup, uxBitsToWaitFor, xTimeoutOccurred) \
+        trace_rec_obj((xTimeoutOccurred) ? TRACE_REC_EV_EG_WAIT_TIMEOUT : TRACE_REC_EV_EG_WAIT_END, (xEventGroup), (uxBitsToWaitFor))
+
+#endif
@@ -0,0 +1,322 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "hal/cpu_hal.h"
+#include "sdkconfig.h"
+#include "trace_rec.h"
+
+#define RING_MASK               (TRACE_REC_RING_LEN - 1)
+#define DUMP_WAKE_PRIO          (configMAX_PRIORITIES - 1)  //stops the recording on time
+#define DUMP_PRIO               1       //prints below the tasks that were measured
+#define DUMP_STACK              3072
+#define DUMP_EVS_PER_LINE       4       //48 bytes, 64 base64 chars
+#define DUMP_LINES_PER_YIELD    16      //~1.3 KB, ~110 ms at 115200 baud
+#define TASK_GONE               ((void *)1)
+
+_Static_assert((TRACE_REC_RING_LEN & RING_MASK) == 0, "TRACE_REC_RING_LEN must be a power of 2");
+_Static_assert(sizeof(trace_rec_ev_t) == 12, "trace_rec_ev_t is dumped as is");
+_Static_assert(portNUM_PROCESSORS <= TRACE_REC_CORE_MAX, "trace_rec_task_stat_t has a counter per core");
+
+static const char *TAG = "TRACE_REC";
+
+typedef struct {
+    uint32_t head;              //events written, the ring holds the last TRACE_REC_RING_LEN
+    uint32_t out_cycles;        //cycle count of the last switch out
+    uint32_t in_cycles;         //since when cur is counted
+    uint8_t cur;                //slot of the task running on the core
+    uint64_t spent;             //cycles spent inside the hooks
+    trace_rec_ev_t evs[TRACE_REC_RING_LEN];
+} ring_t;
+
+typedef struct {
+    void *handle;
+    const char *name;
+} obj_slot_t;
+
+static ring_t rings[portNUM_PROCESSORS];
+static trace_rec_task_stat_t task_slots[TRACE_REC_TASK_MAX];
+static void *_Atomic task_owners[TRACE_REC_TASK_MAX];   //claims the slot, TASK_GONE once deleted
+static _Atomic uint32_t task_cnt;                       //slots claimed, they are claimed in order
+static obj_slot_t obj_slots[TRACE_REC_OBJ_MAX];
+static _Atomic uint32_t obj_cnt;
+static volatile bool recording;
+static volatile bool counting;
+static int64_t start_us;
+static int64_t stop_us;
+
+static const char b64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*================= HOOKS =================*/
+//all of this runs inside the scheduler and with the flash cache possibly off, it stays in iram and calls nothing
+//outside freertos
+
+static inline __attribute__((always_inline)) void put(ring_t *r, uint32_t cycles, uint8_t type, uint8_t task,
+                                                      uint8_t obj, uint32_t arg) {
+    trace_rec_ev_t *ev = &r->evs[r->head & RING_MASK];
+    ev->cycles = cycles;
+    ev->type = type;
+    ev->task = task;
+    ev->obj = obj;
+    ev->pad = 0;
+    ev->arg = arg;
+    r->head++;
+}
+
+//both cores can switch the same new task in at once (a task unblocked by an isr on one core, picked by the
+//other), the slot goes to whoever swaps the handle in first and the loser finds it there
+static IRAM_ATTR uint8_t task_add(void *handle) {
+    for (uint32_t i = 0; i < TRACE_REC_TASK_MAX; i++) {
+        void *owner = NULL;
+        if (!atomic_compare_exchange_strong_explicit(&task_owners[i], &owner, handle, memory_order_relaxed,
+                                                     memory_order_relaxed)) {
+            if (owner == handle) return i;
+            continue;
+        }
+
+        trace_rec_task_stat_t *s = &task_slots[i];
+        const char *name = pcTaskGetName(handle);
+        int k = 0;
+        for (; k < TRACE_REC_NAME_LEN - 1 && name[k] != '\0'; k++) s->name[k] = name[k];
+        s->name[k] = '\0';
+        s->last_core = -1;
+        s->handle = handle;
+        uint32_t n = atomic_load_explicit(&task_cnt, memory_order_relaxed);
+        while (n < i + 1 && !atomic_compare_exchange_weak_explicit(&task_cnt, &n, i + 1, memory_order_relaxed,
+                                                                   memory_order_relaxed)) {
+        }
+        return i;
+    }
+    return TRACE_REC_NO_SLOT;
+}
+
+static inline __attribute__((always_inline)) uint8_t task_slot(void *handle) {
+    uint32_t n = atomic_load_explicit(&task_cnt, memory_order_relaxed);
+    for (uint32_t i = 0; i < n; i++) {
+        if (atomic_load_explicit(&task_owners[i], memory_order_relaxed) == handle) return i;
+    }
+    return task_add(handle);
+}
+
+static inline __attribute__((always_inline)) uint8_t obj_slot(void *handle) {
+    uint32_t n = atomic_load_explicit(&obj_cnt, memory_order_relaxed);
+    for (uint32_t i = 0; i < n; i++) {
+        if (obj_slots[i].handle == handle) return i;
+    }
+    return TRACE_REC_NO_SLOT;
+}
+
+void IRAM_ATTR trace_rec_switched_out(void) {
+    if (!recording && !counting) return;
+    rings[xPortGetCoreID()].out_cycles = cpu_hal_get_cycle_count();
+}
+
+//cycles of the outgoing task on this core, a migration when the incoming one last ran on the other core
+static inline __attribute__((always_inline)) void count_switch(ring_t *r, int core, uint8_t slot) {
+    if (r->cur != TRACE_REC_NO_SLOT) task_slots[r->cur].run_cycles[core] += r->out_cycles - r->in_cycles;
+    r->in_cycles = r->out_cycles;
+    if (slot == TRACE_REC_NO_SLOT || slot == r->cur) return;
+
+    trace_rec_task_stat_t *s = &task_slots[slot];
+    if (s->last_core >= 0 && s->last_core != core) s->migrations++;
+    s->last_core = core;
+}
+
+void IRAM_ATTR trace_rec_switched_in(void) {
+    if (!recording && !counting) return;
+    uint32_t t0 = cpu_hal_get_cycle_count();
+    UBaseType_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+    int core = xPortGetCoreID();
+    ring_t *r = &rings[core];
+
+    //the scheduler runs every tick, only a different task is a switch
+    uint8_t slot = task_slot(xTaskGetCurrentTaskHandle());
+    if (counting) count_switch(r, core, slot);
+    if (slot != r->cur) {
+        if (recording) put(r, r->out_cycles, TRACE_REC_EV_SWITCH, slot, r->cur, 0);
+        r->cur = slot;
+    }
+    r->spent += cpu_hal_get_cycle_count() - t0;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+}
+
+void IRAM_ATTR trace_rec_tick(uint32_t tick) {
+    if (!recording) return;
+    uint32_t t0 = cpu_hal_get_cycle_count();
+    UBaseType_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+    ring_t *r = &rings[xPortGetCoreID()];
+    put(r, t0, TRACE_REC_EV_TICK, r->cur, TRACE_REC_NO_SLOT, tick);
+    r->spent += cpu_hal_get_cycle_count() - t0;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+}
+
+void IRAM_ATTR trace_rec_task_deleted(void *task) {
+    uint32_t n = atomic_load_explicit(&task_cnt, memory_order_relaxed);
+    for (uint32_t i = 0; i < n; i++) {
+        if (atomic_load_explicit(&task_owners[i], memory_order_relaxed) != task) continue;
+        //not NULL, a new task in the same memory takes a new slot
+        atomic_store_explicit(&task_owners[i], TASK_GONE, memory_order_relaxed);
+        task_slots[i].handle = NULL;
+    }
+}
+
+static inline __attribute__((always_inline)) void obj_event(uint8_t type, void *obj, uint32_t arg) {
+    if (!recording) return;
+    uint32_t t0 = cpu_hal_get_cycle_count();
+    UBaseType_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+    ring_t *r = &rings[xPortGetCoreID()];
+    uint8_t slot = obj_slot(obj);
+    if (slot != TRACE_REC_NO_SLOT) put(r, t0, type, r->cur, slot, arg);
+    r->spent += cpu_hal_get_cycle_count() - t0;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+}
+
+void IRAM_ATTR trace_rec_obj(uint8_t type, void *obj, uint32_t arg) {
+    obj_event(type, obj, arg);
+}
+
+void IRAM_ATTR trace_rec_obj_isr(uint8_t type, void *obj, uint32_t arg) {
+    obj_event(type | TRACE_REC_FROM_ISR, obj, arg);
+}
+
+/*================= CONTROL =================*/
+void trace_rec_name_object(void *obj, const char *name) {
+    uint32_t n = atomic_load_explicit(&obj_cnt, memory_order_relaxed);
+    do {
+        if (n >= TRACE_REC_OBJ_MAX) {
+            ESP_LOGW(TAG, "no object slot left for %s", name);
+            return;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&obj_cnt, &n, n + 1, memory_order_relaxed,
+                                                    memory_order_relaxed));
+    obj_slots[n].name = name;
+    obj_slots[n].handle = obj;
+}
+
+int trace_rec_task_stats(trace_rec_task_stat_t *out, int max) {
+    int n = atomic_load_explicit(&task_cnt, memory_order_relaxed);
+    if (n > TRACE_REC_TASK_MAX) n = TRACE_REC_TASK_MAX;
+    if (n > max) n = max;
+    //plain copy, the switch hooks may be halfway through one slot, that only moves a few cycles to the next read
+    memcpy(out, task_slots, n * sizeof(*out));
+    return n;
+}
+
+void trace_rec_stop(void) {
+    if (!recording) return;
+    recording = false;
+    stop_us = esp_timer_get_time();
+}
+
+/*================= DUMP =================*/
+static int put_base64(char *out, const uint8_t *in, int len) {
+    int n = 0;
+    for (int i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < len) v |= (uint32_t)in[i + 1] << 8;
+        if (i + 2 < len) v |= in[i + 2];
+        out[n++] = b64_chars[(v >> 18) & 0x3f];
+        out[n++] = b64_chars[(v >> 12) & 0x3f];
+        out[n++] = (i + 1 < len) ? b64_chars[(v >> 6) & 0x3f] : '=';
+        out[n++] = (i + 2 < len) ? b64_chars[v & 0x3f] : '=';
+    }
+    return n;
+}
+
+//a line is ~80 uart bytes the console driver waits on, the tasks below the caller get the cpu now and then
+static void dump_line_done(int *lines) {
+    if (++*lines % DUMP_LINES_PER_YIELD == 0) vTaskDelay(1);
+}
+
+void trace_rec_dump(void) {
+    trace_rec_stop();
+    int lines = 0;
+    uint32_t tasks = atomic_load(&task_cnt);
+    uint32_t objs = atomic_load(&obj_cnt);
+    int64_t us = stop_us - start_us;
+
+    //header: format version, cores, cpu MHz, tick rate, recorded us
+    printf("TRACE_REC begin 1 %d %d %d %lld\n", portNUM_PROCESSORS, CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ,
+           configTICK_RATE_HZ, (long long)us);
+    for (uint32_t i = 0; i < tasks && i < TRACE_REC_TASK_MAX; i++) {
+        printf("TRACE_REC task %u %s\n", (unsigned int)i, task_slots[i].name);
+    }
+    for (uint32_t i = 0; i < objs && i < TRACE_REC_OBJ_MAX; i++) {
+        printf("TRACE_REC obj %u %s\n", (unsigned int)i, obj_slots[i].name);
+    }
+
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        ring_t *r = &rings[core];
+        uint32_t cnt = r->head < TRACE_REC_RING_LEN ? r->head : TRACE_REC_RING_LEN;
+        //core, events that follow, events overwritten, cycles spent in the hooks
+        printf("TRACE_REC core %d %u %u %llu\n", core, (unsigned int)cnt, (unsigned int)(r->head - cnt),
+               (unsigned long long)r->spent);
+
+        char line[DUMP_EVS_PER_LINE * sizeof(trace_rec_ev_t) / 3 * 4 + 1];
+        for (uint32_t i = r->head - cnt; i != r->head; ) {
+            trace_rec_ev_t evs[DUMP_EVS_PER_LINE];
+            int k = 0;
+            for (; k < DUMP_EVS_PER_LINE && i != r->head; k++, i++) evs[k] = r->evs[i & RING_MASK];
+            int n = put_base64(line, (const uint8_t *)evs, k * sizeof(trace_rec_ev_t));
+            line[n] = '\0';
+            printf("TRACE_REC ev %d %s\n", core, line);
+            dump_line_done(&lines);
+        }
+
+        //hundredths of a percent of the recorded cpu time
+        uint64_t total = (uint64_t)us * CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ;
+        uint32_t bp = total ? (uint32_t)(r->spent * 10000 / total) : 0;
+        ESP_LOGI(TAG, "core %d: %u events (%u overwritten), hooks took %u.%02u%% of the cpu", core,
+                 (unsigned int)cnt, (unsigned int)(r->head - cnt), (unsigned int)(bp / 100), (unsigned int)(bp % 100));
+    }
+    printf("TRACE_REC end\n");
+}
+
+static void trace_rec_dump_task(void *pvParameters) {
+    vTaskDelay(pdMS_TO_TICKS((uintptr_t)pvParameters));
+    trace_rec_stop();
+    vTaskPrioritySet(NULL, DUMP_PRIO);
+    trace_rec_dump();
+
+    vTaskDelete(NULL);
+}
+
+//the caller is running here, the other cores are known from their first switch on
+static void start_core(void) {
+    UBaseType_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+    ring_t *r = &rings[xPortGetCoreID()];
+    r->cur = task_slot(xTaskGetCurrentTaskHandle());
+    r->in_cycles = r->out_cycles = cpu_hal_get_cycle_count();
+    if (r->cur != TRACE_REC_NO_SLOT) task_slots[r->cur].last_core = xPortGetCoreID();
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+}
+
+static void reset_cores(void) {
+    static bool done;
+    if (done) return;
+    done = true;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) rings[core].cur = TRACE_REC_NO_SLOT;
+    start_core();
+}
+
+void trace_rec_count_start(void) {
+    reset_cores();
+    counting = true;
+}
+
+void trace_rec_init(uint32_t dump_after_ms) {
+    reset_cores();
+    start_us = esp_timer_get_time();
+    recording = true;
+
+    if (dump_after_ms != 0) {
+        if (xTaskCreate(&trace_rec_dump_task, "trace_rec_dump", DUMP_STACK, (void *)(uintptr_t)dump_after_ms,
+                        DUMP_WAKE_PRIO, NULL) == pdPASS) {
+            ESP_LOGI(TAG, "trace_rec_dump created success, dump in %u ms", (unsigned int)dump_after_ms);
+        }
+    }
+}
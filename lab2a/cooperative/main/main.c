@@ -3,6 +3,7 @@
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "driver/gpio.h"
+#include "trace_rec.h"
 
 /*
 code description:
@@ -20,8 +21,15 @@ sdkconfig:
 - run only on first core
     + turn off FreeRTOS optimization
 - support legacy FreeRTOS API
+
+tracing:
+- trace_rec records every task switch and tick from the freertos trace macros, TRACE_DUMP_AFTER_MS after boot
+it prints the recording (once vTask3 yields, nothing preempts it). tools/trace_rec.py chrome screenlog.0 -o trace.json
+gives the timeline.
 */
 
+#define TRACE_DUMP_AFTER_MS     3000
+
 const char *LOG_TAG_MAIN = "MAIN";
 const char *LOG_TAG_VTASK1 = "VTASK1";
 const char *LOG_TAG_VTASK2 = "VTASK2";
@@ -72,7 +80,8 @@ void app_main(void)
     //set priority for app_main to be highest among other tasks to avoid others task block app_main after initializaion
     //after that kill app_main fr not blocking othe tasks
     vTaskPrioritySet(NULL, 15);
-    
+    trace_rec_init(TRACE_DUMP_AFTER_MS);
+
     if (xTaskCreate(&vTask1, "vTask1", 2048, NULL, 10, NULL) == pdPASS) ESP_LOGI(LOG_TAG_MAIN, "vTask1 created successfully");
     if (xTaskCreate(&vTask2, "vTask2", 2048, NULL, 9, NULL) == pdPASS) ESP_LOGI(LOG_TAG_MAIN, "vTask2 created successfully");
     if (xTaskCreate(&vTask3, "vTask3", 2048, NULL, 8, NULL) == pdPASS) ESP_LOGI(LOG_TAG_MAIN, "vTask3 created successfully");
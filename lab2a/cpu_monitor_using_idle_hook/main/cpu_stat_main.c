@@ -1,53 +1,300 @@
 /*
-CPU stat collect by idle hook. Print to screen the collected stat for every 2 seconds by print_cpu_stat task.
+CPU stat collected per window. The cpu_sampler task snapshots the run time counters of all tasks every
+CPU_STAT_WINDOW_MS, the print_cpu_stat task prints the latest window every 2 seconds.
 
 Example:
-Collected at: 64802 (ticks)
+Collected at: 64802 (ticks), window 1000 ms, sample took 182 us (0.02%)
+core 0: 1% busy, core 1: 0% busy
+Task------------core----run time (us)---% of a core---on core 0/1 (%)----migrations
+IDLE            0       990213          99%             99/0                0
+IDLE            1       999870          99%             0/99                0
+print_cpu_stat  -       1301            <1%             0/0                 1
+cpu_sampler     -       182             <1%             0/0                 0
+ipc0            0       0               <1%             0/0                 0
+esp_timer       0       0               <1%             0/0                 0
+ipc1            1       0               <1%             0/0                 0
+CPUREC 64802 1000 10,0 IDLE:0:990,0:0 IDLE:1:0,999:0 print_cpu_stat:-:1,0:1 cpu_sampler:-:0,0:0 ...
 
-Task----------absolute time (us)----% time
-IDLE            648009966               99%
-IDLE            645660772               99%
-print_cpu_stat  2343335         <1%
-ipc0            27192           <1%
-esp_timer       30              <1%
-ipc1            32222           <1%
+CPU time each task spent running during the last window, not since boot. core is the task affinity, - for
+tasks that may run on both cores. a core is busy for the part of the window its IDLE task did not run.
+on core 0/1 splits the time of a task over the cores it really ran on, migrations counts how many times it was
+switched in on the other core than the last time, both during the window.
 
-Total CPU time spending for certain tasks (in running state).
+CPUREC is the same window on one line to grep from a long capture while moving tasks between cores (httpd,
+app tasks): tick, window ms, busy permille per core, then name:affinity:permille per core:migrations per task.
+CPU_STAT_PRINT_TABLE 0 prints only this line.
+
+engine:
+- the idle hook used to call vTaskGetRunTimeStats on every idle loop: a walk over all tasks and a sprintf of the
+whole table each time, so the idle time was mostly spent making the stats, and the table was cumulative.
+- now uxTaskGetSystemState runs once per window into one of two snapshot arrays, the window is the difference
+with the other one. the sampler only computes numbers, the formatting happens in print_cpu_stat.
+- a window is published into one of two result buffers guarded by a sequence counter (odd while written), the
+reader copies the latest one and retries when the counter moved, nobody takes a lock.
+- app_main times one vTaskGetRunTimeStats call against one sample at start, the sample time of every window is
+printed in the header line.
+- the run time counters only give the total of a task, the per core split and the migrations come from the
+trace_rec counters (../components/trace_rec, counting only, no ring), read next to every snapshot and matched
+by task handle. a task above TRACE_REC_TASK_MAX shows 0/0.
 
 menuconfig:
 - enable FreeRTOS legacy hook
 - Enable FreeRTOS to collect run time stats
+- Enable display of xCoreID in vTaskList (TaskStatus_t.xCoreID)
 */
 
 #include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_timer.h"
 #include "driver/gpio.h"
+#include "trace_rec.h"
+
+#if !CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+#error "cpu_stat needs TaskStatus_t.xCoreID, enable CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID"
+#endif
 
+#define CPU_STAT_WINDOW_MS      1000
+#define CPU_STAT_PRINT_MS       2000
+#define CPU_STAT_TASK_MAX       24
 #define CPU_STAT_BUFFER_SIZE    1000
-char cpu_stat[CPU_STAT_BUFFER_SIZE];
+#define SAMPLER_PRIO            (configMAX_PRIORITIES - 2)
+#define CPU_STAT_PRINT_TABLE    1
+
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    BaseType_t core;            //affinity, tskNO_AFFINITY when the task can run on both cores
+    uint32_t run_us;            //running time during the window
+    uint16_t permille;          //of one core
+    uint16_t core_permille[portNUM_PROCESSORS];     //of each core, where it actually ran
+    uint16_t migrations;
+} task_window_t;
+
+typedef struct {
+    _Atomic uint32_t seq;       //odd while the sampler writes the buffer
+    TickType_t tick;
+    uint32_t window_us;
+    uint32_t sample_us;         //time the sample of this window took
+    uint16_t core_busy[portNUM_PROCESSORS];     //permille
+    uint16_t task_cnt;
+    task_window_t tasks[CPU_STAT_TASK_MAX];
+} cpu_window_t;
+
+static TaskStatus_t snaps[2][CPU_STAT_TASK_MAX];
+static UBaseType_t snap_cnt[2];
+static uint32_t snap_total[2];
+static trace_rec_task_stat_t rec_snaps[2][TRACE_REC_TASK_MAX];
+static int rec_cnt[2];
+
+static cpu_window_t windows[2];
+static _Atomic int latest = -1;     //index of the last complete window
+
+/*================= SAMPLER =================*/
+static const TaskStatus_t *find_task(const TaskStatus_t *snap, UBaseType_t cnt, UBaseType_t number) {
+    for (UBaseType_t i = 0; i < cnt; i++) {
+        if (snap[i].xTaskNumber == number) return &snap[i];
+    }
+    return NULL;
+}
+
+static const trace_rec_task_stat_t *find_rec(const trace_rec_task_stat_t *snap, int cnt, void *handle) {
+    for (int i = 0; i < cnt; i++) {
+        if (snap[i].handle == handle) return &snap[i];
+    }
+    return NULL;
+}
+
+static uint16_t permille_of(uint32_t part, uint32_t whole) {
+    if (whole == 0) return 0;
+    uint64_t p = (uint64_t)part * 1000 / whole;
+    return p > 1000 ? 1000 : p;
+}
+
+//difference of two snapshots into the result buffer w
+static void publish(int w, int prev, int cur, uint32_t sample_us) {
+    cpu_window_t *win = &windows[w];
+    uint32_t window_us = snap_total[cur] - snap_total[prev];
+
+    atomic_fetch_add_explicit(&win->seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    win->tick = xTaskGetTickCount();
+    win->window_us = window_us;
+    win->sample_us = sample_us;
+    win->task_cnt = 0;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) win->core_busy[core] = 1000;
+
+    for (UBaseType_t i = 0; i < snap_cnt[cur] && i < CPU_STAT_TASK_MAX; i++) {
+        const TaskStatus_t *t = &snaps[cur][i];
+        const TaskStatus_t *before = find_task(snaps[prev], snap_cnt[prev], t->xTaskNumber);
+        //a task created during the window counts from 0, the counters wrap after ~71 minutes
+        uint32_t run_us = t->ulRunTimeCounter - (before ? before->ulRunTimeCounter : 0);
+
+        task_window_t *tw = &win->tasks[win->task_cnt++];
+        strlcpy(tw->name, t->pcTaskName, sizeof(tw->name));
+        tw->core = t->xCoreID;
+        tw->run_us = run_us;
+        tw->permille = permille_of(run_us, window_us);
+
+        const trace_rec_task_stat_t *rec = find_rec(rec_snaps[cur], rec_cnt[cur], t->xHandle);
+        const trace_rec_task_stat_t *rec_before = rec ? find_rec(rec_snaps[prev], rec_cnt[prev], t->xHandle) : NULL;
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            uint32_t cycles = rec ? rec->run_cycles[core] - (rec_before ? rec_before->run_cycles[core] : 0) : 0;
+            tw->core_permille[core] = permille_of(cycles / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ, window_us);
+        }
+        tw->migrations = rec ? rec->migrations - (rec_before ? rec_before->migrations : 0) : 0;
+
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            if (t->xHandle == xTaskGetIdleTaskHandleForCPU(core)) win->core_busy[core] = 1000 - tw->permille;
+        }
+    }
+
+    atomic_thread_fence(memory_order_release);
+    atomic_fetch_add_explicit(&win->seq, 1, memory_order_relaxed);
+    atomic_store_explicit(&latest, w, memory_order_release);
+}
+
+static void cpu_sampler(void *pvParameters) {
+    int cur = 0;
+    int w = 0;
+    uint32_t sample_us = 0;
+
+    snap_cnt[cur] = uxTaskGetSystemState(snaps[cur], CPU_STAT_TASK_MAX, &snap_total[cur]);
+    rec_cnt[cur] = trace_rec_task_stats(rec_snaps[cur], TRACE_REC_TASK_MAX);
+    TickType_t last_wake = xTaskGetTickCount();
+    for (;;) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(CPU_STAT_WINDOW_MS));
 
+        int64_t start = esp_timer_get_time();
+        int next = cur ^ 1;
+        //0 when there are more tasks than CPU_STAT_TASK_MAX, that window is skipped
+        snap_cnt[next] = uxTaskGetSystemState(snaps[next], CPU_STAT_TASK_MAX, &snap_total[next]);
+        if (snap_cnt[next] == 0) {
+            printf("cpu_sampler: more than %d tasks, window skipped\n", CPU_STAT_TASK_MAX);
+            continue;
+        }
+        rec_cnt[next] = trace_rec_task_stats(rec_snaps[next], TRACE_REC_TASK_MAX);
+        if (snap_cnt[cur] != 0) {
+            publish(w, cur, next, sample_us);
+            w ^= 1;
+        }
+        cur = next;
+        sample_us = esp_timer_get_time() - start;
+    }
+
+    vTaskDelete(NULL);
+}
+
+//copy of the latest window, false when there is none yet
+static bool read_window(cpu_window_t *out) {
+    for (;;) {
+        int w = atomic_load_explicit(&latest, memory_order_acquire);
+        if (w < 0) return false;
+
+        cpu_window_t *win = &windows[w];
+        uint32_t seq = atomic_load_explicit(&win->seq, memory_order_acquire);
+        if (seq & 1) continue;
+        memcpy((char *)out + sizeof(out->seq), (char *)win + sizeof(win->seq), sizeof(*win) - sizeof(win->seq));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&win->seq, memory_order_relaxed) == seq) return true;
+    }
+}
+
+/*================= PRINT =================*/
 void vApplicationIdleHook(void) {
-    vTaskGetRunTimeStats(cpu_stat);
+    //still needed while the legacy hooks are enabled, the stats no longer come from here
+}
+
+static void print_table(const cpu_window_t *win) {
+    uint32_t bp = win->window_us ? (uint32_t)((uint64_t)win->sample_us * 10000 / win->window_us) : 0;
+    printf("Collected at: %d (ticks), window %u ms, sample took %u us (%u.%02u%%)\n", win->tick,
+           (unsigned int)(win->window_us / 1000), (unsigned int)win->sample_us, (unsigned int)(bp / 100),
+           (unsigned int)(bp % 100));
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        printf("%score %d: %d%% busy", core ? ", " : "", core, win->core_busy[core] / 10);
+    }
+    printf("\nTask------------core----run time (us)---%% of a core---on core 0/1 (%%)----migrations\n");
+    for (int i = 0; i < win->task_cnt; i++) {
+        const task_window_t *t = &win->tasks[i];
+        char core[4] = "-";
+        char pct[8] = "<1%";
+        char split[16];
+        if (t->core != tskNO_AFFINITY) snprintf(core, sizeof(core), "%d", (int)t->core);
+        if (t->permille >= 10) snprintf(pct, sizeof(pct), "%u%%", (unsigned int)(t->permille / 10));
+        int len = 0;
+        for (int c = 0; c < portNUM_PROCESSORS; c++) {
+            len += snprintf(split + len, sizeof(split) - len, "%s%u", c ? "/" : "", (unsigned int)(t->core_permille[c] / 10));
+        }
+        printf("%-16s%-8s%-16u%-16s%-20s%u\n", t->name, core, (unsigned int)t->run_us, pct, split,
+               (unsigned int)t->migrations);
+    }
+}
+
+//CPUREC <tick> <window ms> <busy core 0>[,<busy core 1>] name:affinity:<core 0>[,<core 1>]:migrations ...
+static void print_record(const cpu_window_t *win) {
+    printf("CPUREC %d %u", win->tick, (unsigned int)(win->window_us / 1000));
+    for (int core = 0; core < portNUM_PROCESSORS; core++) printf("%c%u", core ? ',' : ' ', win->core_busy[core]);
+    for (int i = 0; i < win->task_cnt; i++) {
+        const task_window_t *t = &win->tasks[i];
+        char name[configMAX_TASK_NAME_LEN];
+        //one field per task, a space in the name would split it
+        strlcpy(name, t->name, sizeof(name));
+        for (char *c = name; *c != '\0'; c++) {
+            if (*c == ' ') *c = '_';
+        }
+        if (t->core != tskNO_AFFINITY) printf(" %s:%d", name, (int)t->core);
+        else printf(" %s:-", name);
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            printf("%c%u", core ? ',' : ':', t->core_permille[core]);
+        }
+        printf(":%u", (unsigned int)t->migrations);
+    }
+    printf("\n");
 }
 
 void print_cpu_stat(void *pvParameters) {
+    static cpu_window_t win;
+
     for (;;) {
-        printf("Collected at: %d (ticks)\n", xTaskGetTickCount());
-        printf("%s\n", cpu_stat);
-        vTaskDelay(pdMS_TO_TICKS(2000));
+        vTaskDelay(pdMS_TO_TICKS(CPU_STAT_PRINT_MS));
+        if (!read_window(&win)) continue;
+
+#if CPU_STAT_PRINT_TABLE
+        print_table(&win);
+#endif
+        print_record(&win);
+        printf("\n");
     }
 
     vTaskDelete(NULL);
 }
 
+//one vTaskGetRunTimeStats call (what the idle hook did on every loop) against one snapshot of the sampler
+static void measure_overhead(void) {
+    static char cpu_stat[CPU_STAT_BUFFER_SIZE];
+    static TaskStatus_t snap[CPU_STAT_TASK_MAX];
+    uint32_t total;
+
+    int64_t t0 = esp_timer_get_time();
+    vTaskGetRunTimeStats(cpu_stat);
+    int64_t t1 = esp_timer_get_time();
+    uxTaskGetSystemState(snap, CPU_STAT_TASK_MAX, &total);
+    int64_t t2 = esp_timer_get_time();
+    printf("vTaskGetRunTimeStats took %d us, uxTaskGetSystemState took %d us\n", (int)(t1 - t0), (int)(t2 - t1));
+}
+
 void app_main(void)
 {
     //set priority for app_main to be highest among other tasks to avoid others task block app_main after initializaion
     //after that kill app_main fr not blocking othe tasks
     vTaskPrioritySet(NULL, 15);
-    
+    trace_rec_count_start();
+    measure_overhead();
+
+    if (xTaskCreate(&cpu_sampler, "cpu_sampler", 2048, NULL, SAMPLER_PRIO, NULL) == pdPASS) printf("cpu_sampler created successfully\n");
     if (xTaskCreate(&print_cpu_stat, "print_cpu_stat", 2048, NULL, 1, NULL) == pdPASS) printf("print_cpu_stat created successfully\n");
-    
+
     vTaskPrioritySet(NULL, 1);
 }
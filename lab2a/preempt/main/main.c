@@ -3,6 +3,8 @@
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "driver/gpio.h"
+#include "dlog.h"
+#include "trace_rec.h"
 
 /*
 sdkconfig:
@@ -26,8 +28,20 @@ FreeRTOSConfig.h:
 #define configUSE_PREEMPTION                            1
 #define configUSE_TIME_SLICING                          0
 #define configIDLE_SHOULD_YIELD                         0
+
+logging:
+- the tasks log through dlog, a log call only stores a record in a ring, the dlog_drain task prints them later.
+the drain runs at tskIDLE_PRIORITY like vTask2/vTask3 and takes its turn in the time slicing, so the tick and not
+the uart or the drain period decides how often vTask2/vTask3 get to run. the spinning tasks fill the ring far
+faster than it drains, the newest records are dropped and the drain prints how many.
+
+tracing:
+- trace_rec records every task switch and tick from the freertos trace macros, TRACE_DUMP_AFTER_MS after boot
+it prints the recording. tools/trace_rec.py chrome screenlog.0 -o trace.json gives the timeline.
 */
 
+#define TRACE_DUMP_AFTER_MS     3000
+
 const char *LOG_TAG_MAIN = "MAIN";
 const char *LOG_TAG_VTASK1 = "VTASK1";
 const char *LOG_TAG_VTASK2 = "VTASK2";
@@ -43,7 +57,7 @@ void vApplicationIdleHook(void) {
 
 void vTask1(void *pvParameters) {
     for (;;) {
-        printf("(%d) %s: running, (%d) %s: running\n", esp_log_early_timestamp(), LOG_TAG_VTASK1, idle_timestamp, LOG_TAG_IDLE);
+        DLOGI(LOG_TAG_VTASK1, "running, (%d) %s: running", idle_timestamp, LOG_TAG_IDLE);
         vTaskDelay(10);
     }
 
@@ -52,7 +66,7 @@ void vTask1(void *pvParameters) {
 
 void vTask2(void *pvParameters) {
     for (;;) {
-        printf("(%d) %s: running, (%d) %s: running\n", esp_log_early_timestamp(), LOG_TAG_VTASK2, idle_timestamp, LOG_TAG_IDLE);
+        DLOGI(LOG_TAG_VTASK2, "running, (%d) %s: running", idle_timestamp, LOG_TAG_IDLE);
     }
 
     vTaskDelete(NULL);
@@ -60,7 +74,7 @@ void vTask2(void *pvParameters) {
 
 void vTask3(void *pvParameters) {
     for (;;) {
-        printf("(%d) %s: running, (%d) %s: running\n", esp_log_early_timestamp(), LOG_TAG_VTASK3, idle_timestamp, LOG_TAG_IDLE);
+        DLOGI(LOG_TAG_VTASK3, "running, (%d) %s: running", idle_timestamp, LOG_TAG_IDLE);
     }
 
     vTaskDelete(NULL);
@@ -70,7 +84,9 @@ void app_main(void)
 {
     //set priority for app_main to be highest among other tasks to avoid others task block app_main after initializaion
     vTaskPrioritySet(NULL, 15);
-    
+    trace_rec_init(TRACE_DUMP_AFTER_MS);
+    dlog_init();
+
     if (xTaskCreatePinnedToCore(&vTask1, "vTask1", 2048, NULL, 10, NULL, 0) == pdPASS) ESP_LOGI(LOG_TAG_MAIN, "vTask1 created successfully");
     if (xTaskCreatePinnedToCore(&vTask2, "vTask2", 2048, NULL, tskIDLE_PRIORITY, NULL, 0) == pdPASS) ESP_LOGI(LOG_TAG_MAIN, "vTask2 created successfully");
     if (xTaskCreatePinnedToCore(&vTask3, "vTask3", 2048, NULL, tskIDLE_PRIORITY, NULL, 0) == pdPASS) ESP_LOGI(LOG_TAG_MAIN, "vTask3 created successfully");
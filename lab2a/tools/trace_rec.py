@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+"""
+host side of the trace_rec component (components/trace_rec).
+
+  trace_rec.py chrome screenlog.0 -o trace.json
+      turns the "TRACE_REC ..." lines of a capture into chrome trace json, open it in chrome://tracing
+      or ui.perfetto.dev. one track per core with a slice per task run, the ticks and the queue and
+      event group calls as instant events, queue fill levels as counters.
+  trace_rec.py summary screenlog.0
+      per core and task: runs, busy time, cpu share, mean run, and the time spent in the hooks.
+
+the dump is "TRACE_REC begin <version> <cores> <MHz> <tick hz> <recorded us>", then "task <slot> <name>",
+"obj <slot> <name>", per core "core <n> <events> <overwritten> <hook cycles>" followed by "ev <n> <base64>"
+lines of 12 byte events (<IBBBBI: cycles, type, task slot, object slot, pad, arg) and "end".
+other output of the capture is skipped, with several dumps the last complete one is used.
+"""
+import argparse
+import base64
+import json
+import struct
+import sys
+
+EV = struct.Struct('<IBBBBI')
+NO_SLOT = 0xff
+FROM_ISR = 0x80
+
+SWITCH, TICK = 1, 2
+EV_NAMES = {
+    3: 'send', 4: 'send failed', 5: 'send blocks', 6: 'receive', 7: 'receive failed', 8: 'receive blocks',
+    9: 'set bits', 10: 'clear bits', 11: 'wait bits blocks', 12: 'wait bits end', 13: 'wait bits timeout',
+}
+QUEUE_TYPES = range(3, 9)
+
+
+class Dump:
+    def __init__(self, cores, mhz, tick_hz, rec_us):
+        self.cores = cores
+        self.mhz = mhz
+        self.tick_hz = tick_hz
+        self.rec_us = rec_us
+        self.tasks = {}
+        self.objs = {}
+        self.core_info = {}
+        self.events = {c: [] for c in range(cores)}
+
+
+def read_dump(path):
+    done = None
+    cur = None
+    with open(path, 'rb') as f:
+        for raw in f:
+            line = raw.decode('utf-8', 'replace')
+            at = line.find('TRACE_REC ')
+            if at < 0:
+                continue
+            parts = line[at:].strip().split(' ')
+            kind = parts[1] if len(parts) > 1 else ''
+            try:
+                if kind == 'begin':
+                    cur = Dump(int(parts[3]), int(parts[4]), int(parts[5]), int(parts[6]))
+                elif cur is None:
+                    continue
+                elif kind == 'task':
+                    cur.tasks[int(parts[2])] = ' '.join(parts[3:])
+                elif kind == 'obj':
+                    cur.objs[int(parts[2])] = ' '.join(parts[3:])
+                elif kind == 'core':
+                    cur.core_info[int(parts[2])] = (int(parts[3]), int(parts[4]), int(parts[5]))
+                elif kind == 'ev':
+                    data = base64.b64decode(parts[3])
+                    cur.events[int(parts[2])].extend(EV.iter_unpack(data[:len(data) // EV.size * EV.size]))
+                elif kind == 'end':
+                    done = cur
+                    cur = None
+            except (IndexError, ValueError, KeyError) as e:
+                print('skipping bad line %r: %s' % (line.strip(), e), file=sys.stderr)
+    if done is None:
+        sys.exit('%s: no complete TRACE_REC dump' % path)
+    return done
+
+
+def timeline(dump, core):
+    """events of a core as (us, type, task, obj, arg), the 32 bit cycle counter extended"""
+    out = []
+    ext = None
+    last = 0
+    for cycles, typ, task, obj, _pad, arg in dump.events[core]:
+        if ext is None:
+            ext = cycles
+        else:
+            #signed step, a switch carries the switch out stamp which can sit a little before the tick
+            ext += ((cycles - last + (1 << 31)) & 0xffffffff) - (1 << 31)
+        last = cycles
+        out.append((ext / dump.mhz, typ, task, obj, arg))
+    return out
+
+
+def task_name(dump, slot):
+    if slot == NO_SLOT:
+        return '?'
+    return dump.tasks.get(slot, 'task%d' % slot)
+
+
+def runs_of(dump, events):
+    """(task slot, start us, end us) per run of a core, the first event tells who was running"""
+    runs = []
+    cur = None
+    start = None
+    for us, typ, task, _obj, _arg in events:
+        if cur is None:
+            cur, start = task, us
+        if typ == SWITCH:
+            if us > start:
+                runs.append((cur, start, us))
+            cur, start = task, us
+    if events and cur is not None and events[-1][0] > start:
+        runs.append((cur, start, events[-1][0]))
+    return runs
+
+
+def cmd_chrome(args):
+    dump = read_dump(args.capture)
+    tl = {c: timeline(dump, c) for c in range(dump.cores)}
+    t0 = min((ev[0][0] for ev in tl.values() if ev), default=0)
+    out = [{'name': 'process_name', 'ph': 'M', 'pid': 1, 'args': {'name': 'esp32 trace_rec'}}]
+    for c in range(dump.cores):
+        out.append({'name': 'thread_name', 'ph': 'M', 'pid': 1, 'tid': c, 'args': {'name': 'core %d' % c}})
+        events = tl[c]
+        for slot, start, end in runs_of(dump, events):
+            out.append({'name': task_name(dump, slot), 'cat': 'task', 'ph': 'X', 'pid': 1, 'tid': c,
+                        'ts': round(start - t0, 3), 'dur': round(end - start, 3)})
+        for us, typ, task, obj, arg in events:
+            ts = round(us - t0, 3)
+            base = typ & ~FROM_ISR
+            if base == TICK:
+                if not args.no_ticks:
+                    out.append({'name': 'tick', 'cat': 'tick', 'ph': 'i', 's': 't', 'pid': 1, 'tid': c, 'ts': ts,
+                                'args': {'tick': arg}})
+            elif base in EV_NAMES:
+                name = dump.objs.get(obj, 'obj%d' % obj)
+                by = 'isr' if typ & FROM_ISR else task_name(dump, task)
+                key = 'items' if base in QUEUE_TYPES else 'bits'
+                out.append({'name': '%s %s' % (name, EV_NAMES[base]), 'cat': 'object', 'ph': 'i', 's': 't',
+                            'pid': 1, 'tid': c, 'ts': ts, 'args': {'by': by, key: arg}})
+                if base in QUEUE_TYPES:
+                    out.append({'name': name, 'ph': 'C', 'pid': 1, 'ts': ts, 'args': {'items': arg}})
+    with open(args.output, 'w') as f:
+        json.dump({'traceEvents': out, 'displayTimeUnit': 'ms'}, f)
+    print('%s: %d trace events over %d cores' % (args.output, len(out), dump.cores))
+
+
+def cmd_summary(args):
+    dump = read_dump(args.capture)
+    print('recorded %.3f s, %d cores at %d MHz, tick %d Hz' % (dump.rec_us / 1e6, dump.cores, dump.mhz,
+                                                                dump.tick_hz))
+    for c in range(dump.cores):
+        cnt, lost, spent = dump.core_info.get(c, (0, 0, 0))
+        events = timeline(dump, c)
+        hook = spent * 100.0 / (dump.rec_us * dump.mhz) if dump.rec_us else 0.0
+        print('core %d: %d events, %d overwritten, hooks %.3f%% of the cpu' % (c, cnt, lost, hook))
+        runs = runs_of(dump, events)
+        if not runs:
+            continue
+        span = runs[-1][2] - runs[0][1]
+        per = {}
+        for slot, start, end in runs:
+            n, busy = per.get(slot, (0, 0.0))
+            per[slot] = (n + 1, busy + end - start)
+        print('  %-16s %8s %12s %7s %10s' % ('task', 'runs', 'busy_us', 'cpu%', 'mean_us'))
+        for slot, (n, busy) in sorted(per.items(), key=lambda kv: -kv[1][1]):
+            print('  %-16s %8d %12.1f %7.2f %10.1f' % (task_name(dump, slot), n, busy,
+                                                      busy * 100.0 / span if span else 0.0, busy / n))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = ap.add_subparsers(dest='cmd', required=True)
+    p = sub.add_parser('chrome')
+    p.add_argument('capture')
+    p.add_argument('-o', '--output', default='trace.json')
+    p.add_argument('--no-ticks', action='store_true', help='leave the tick instants out')
+    p.set_defaults(fn=cmd_chrome)
+    p = sub.add_parser('summary')
+    p.add_argument('capture')
+    p.set_defaults(fn=cmd_summary)
+    args = ap.parse_args()
+    args.fn(args)
+
+
+if __name__ == '__main__':
+    main()
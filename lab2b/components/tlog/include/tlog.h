@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_idf_version.h"
+#include "esp_log.h"
+#include "tlog_hash.h"
+
+/*
+tokenized log: TLOGx(tag, fmt, ...) takes the same arguments as ESP_LOGx, but the format string never ends up in
+the image and neither string goes out on the uart.
+
+- level, tag and format are hashed to a 32 bit token at compile time, tag must be a string literal (or a #define of
+one). tools/tlog.py db collects the same strings from the sources into the token database next to the elf.
+- a call writes one line "$<base64>": the token, the esp_log_timestamp() in ms and up to TLOG_ARG_MAX args,
+each a zigzag varint. only 32 bit integer args (%d %u %x %c), no strings, floats or 64 bit values.
+- like ESP_LOGx a call is filtered by LOG_LOCAL_LEVEL at compile time and by esp_log_level_get(tag) at run time, so
+esp_log_level_set() silences a tag here too. that keeps the tag literal in the image, once per tag (the linker
+merges equal strings). before esp-idf 4.4 there is no esp_log_level_get and only LOG_LOCAL_LEVEL applies.
+- tools/tlog.py detok turns a capture back into "I (ms) TAG: msg" lines, other output passes through untouched.
+- TLOG_ENABLE 0 compiles the calls as plain ESP_LOGx again.
+*/
+
+#ifndef TLOG_ENABLE
+#define TLOG_ENABLE             1
+#endif
+#define TLOG_ARG_MAX            6
+
+void tlog_write(uint32_t token, int arg_cnt, ...);
+
+/* never called, only lets the compiler check the args against the format like for ESP_LOGx */
+static inline void __attribute__((format(printf, 1, 2))) tlog_check_fmt(const char *fmt, ...) {}
+
+#define TLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, N, ...) N
+#define TLOG_NARGS(...) TLOG_NARGS_(_, ##__VA_ARGS__, 7, 6, 5, 4, 3, 2, 1, 0)
+
+#define TLOG_TOKEN(letter, tag, fmt) TLOG_HASH(letter "\x1f" tag "\x1f" fmt)
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 4, 0)
+#define TLOG_RUNTIME_LEVEL(tag) esp_log_level_get(tag)
+#else
+#define TLOG_RUNTIME_LEVEL(tag) ESP_LOG_VERBOSE
+#endif
+
+#define TLOG_LEVEL(level, letter, tag, fmt, ...) do {                                        \
+        _Static_assert(TLOG_NARGS(__VA_ARGS__) <= TLOG_ARG_MAX, "too many tlog args");       \
+        if (0) tlog_check_fmt(fmt, ##__VA_ARGS__);                                          \
+        if (LOG_LOCAL_LEVEL >= (level) && TLOG_RUNTIME_LEVEL(tag) >= (level)) {             \
+            tlog_write(TLOG_TOKEN(letter, tag, fmt), TLOG_NARGS(__VA_ARGS__), ##__VA_ARGS__); \
+        }                                                                                   \
+    } while (0)
+
+#if TLOG_ENABLE
+#define TLOGE(tag, fmt, ...) TLOG_LEVEL(ESP_LOG_ERROR, "E", tag, fmt, ##__VA_ARGS__)
+#define TLOGW(tag, fmt, ...) TLOG_LEVEL(ESP_LOG_WARN, "W", tag, fmt, ##__VA_ARGS__)
+#define TLOGI(tag, fmt, ...) TLOG_LEVEL(ESP_LOG_INFO, "I", tag, fmt, ##__VA_ARGS__)
+#define TLOGD(tag, fmt, ...) TLOG_LEVEL(ESP_LOG_DEBUG, "D", tag, fmt, ##__VA_ARGS__)
+#define TLOGV(tag, fmt, ...) TLOG_LEVEL(ESP_LOG_VERBOSE, "V", tag, fmt, ##__VA_ARGS__)
+#else
+#define TLOGE(tag, fmt, ...) ESP_LOGE(tag, fmt, ##__VA_ARGS__)
+#define TLOGW(tag, fmt, ...) ESP_LOGW(tag, fmt, ##__VA_ARGS__)
+#define TLOGI(tag, fmt, ...) ESP_LOGI(tag, fmt, ##__VA_ARGS__)
+#define TLOGD(tag, fmt, ...) ESP_LOGD(tag, fmt, ##__VA_ARGS__)
+#define TLOGV(tag, fmt, ...) ESP_LOGV(tag, fmt, ##__VA_ARGS__)
+#endif
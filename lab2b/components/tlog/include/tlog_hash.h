@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdint.h>
+
+/* generated by tools/tlog.py hash-header, do not edit */
+
+#define TLOG_HASH_LEN           80
+
+#define TLOG_HASH_C(s, i) ((i) < sizeof(s) - 1 ? (uint32_t)(uint8_t)(s)[(i) < sizeof(s) ? (i) : 0] : 0u)
+
+/* 65599 hash of a string literal, folded to a constant by the compiler */
+#define TLOG_HASH(s) ((uint32_t)(sizeof(s) - 1) + \
+    TLOG_HASH_C(s, 0) * 0x0001003fu + \
+    TLOG_HASH_C(s, 1) * 0x007e0f81u + \
+    TLOG_HASH_C(s, 2) * 0x2e86d0bfu + \
+    TLOG_HASH_C(s, 3) * 0x43ec5f01u + \
+    TLOG_HASH_C(s, 4) * 0x162c613fu + \
+    TLOG_HASH_C(s, 5) * 0xd62aee81u + \
+    TLOG_HASH_C(s, 6) * 0xa311b1bfu + \
+    TLOG_HASH_C(s, 7) * 0xd319be01u + \
+    TLOG_HASH_C(s, 8) * 0xb156c23fu + \
+    TLOG_HASH_C(s, 9) * 0x6698cd81u + \
+    TLOG_HASH_C(s, 10) * 0x0d1b92bfu + \
+    TLOG_HASH_C(s, 11) * 0xcc881d01u + \
+    TLOG_HASH_C(s, 12) * 0x7280233fu + \
+    TLOG_HASH_C(s, 13) * 0x50c7ac81u + \
+    TLOG_HASH_C(s, 14) * 0x8da473bfu + \
+    TLOG_HASH_C(s, 15) * 0x4f377c01u + \
+    TLOG_HASH_C(s, 16) * 0xfaa8843fu + \
+    TLOG_HASH_C(s, 17) * 0x33b78b81u + \
+    TLOG_HASH_C(s, 18) * 0x45ac54bfu + \
+    TLOG_HASH_C(s, 19) * 0x7a27db01u + \
+    TLOG_HASH_C(s, 20) * 0xeacfe53fu + \
+    TLOG_HASH_C(s, 21) * 0xae686a81u + \
+    TLOG_HASH_C(s, 22) * 0x563335bfu + \
+    TLOG_HASH_C(s, 23) * 0x6c593a01u + \
+    TLOG_HASH_C(s, 24) * 0xe3f6463fu + \
+    TLOG_HASH_C(s, 25) * 0x5fda4981u + \
+    TLOG_HASH_C(s, 26) * 0xe03916bfu + \
+    TLOG_HASH_C(s, 27) * 0x44cb9901u + \
+    TLOG_HASH_C(s, 28) * 0x871ba73fu + \
+    TLOG_HASH_C(s, 29) * 0xe70d2881u + \
+    TLOG_HASH_C(s, 30) * 0x04bdf7bfu + \
+    TLOG_HASH_C(s, 31) * 0x227ef801u + \
+    TLOG_HASH_C(s, 32) * 0x7540083fu + \
+    TLOG_HASH_C(s, 33) * 0xe3010781u + \
+    TLOG_HASH_C(s, 34) * 0xe4c1d8bfu + \
+    TLOG_HASH_C(s, 35) * 0x24735701u + \
+    TLOG_HASH_C(s, 36) * 0x4f63693fu + \
+    TLOG_HASH_C(s, 37) * 0xf2b5e681u + \
+    TLOG_HASH_C(s, 38) * 0xa144b9bfu + \
+    TLOG_HASH_C(s, 39) * 0x69a8b601u + \
+    TLOG_HASH_C(s, 40) * 0xb685ca3fu + \
+    TLOG_HASH_C(s, 41) * 0xb52bc581u + \
+    TLOG_HASH_C(s, 42) * 0x5b469abfu + \
+    TLOG_HASH_C(s, 43) * 0x111f1501u + \
+    TLOG_HASH_C(s, 44) * 0x4ba72b3fu + \
+    TLOG_HASH_C(s, 45) * 0xc962a481u + \
+    TLOG_HASH_C(s, 46) * 0x33c77bbfu + \
+    TLOG_HASH_C(s, 47) * 0x39d67401u + \
+    TLOG_HASH_C(s, 48) * 0xafc78c3fu + \
+    TLOG_HASH_C(s, 49) * 0xce5a8381u + \
+    TLOG_HASH_C(s, 50) * 0x4bc75cbfu + \
+    TLOG_HASH_C(s, 51) * 0x02ced301u + \
+    TLOG_HASH_C(s, 52) * 0x83e6ed3fu + \
+    TLOG_HASH_C(s, 53) * 0x63136281u + \
+    TLOG_HASH_C(s, 54) * 0xc4463dbfu + \
+    TLOG_HASH_C(s, 55) * 0x8b083201u + \
+    TLOG_HASH_C(s, 56) * 0x69054e3fu + \
+    TLOG_HASH_C(s, 57) * 0x268d4181u + \
+    TLOG_HASH_C(s, 58) * 0xbe441ebfu + \
+    TLOG_HASH_C(s, 59) * 0xf1829101u + \
+    TLOG_HASH_C(s, 60) * 0x0022af3fu + \
+    TLOG_HASH_C(s, 61) * 0xb7c82081u + \
+    TLOG_HASH_C(s, 62) * 0x5ac0ffbfu + \
+    TLOG_HASH_C(s, 63) * 0x553df001u + \
+    TLOG_HASH_C(s, 64) * 0xea3f103fu + \
+    TLOG_HASH_C(s, 65) * 0xb5c3ff81u + \
+    TLOG_HASH_C(s, 66) * 0xbabce0bfu + \
+    TLOG_HASH_C(s, 67) * 0xd53a4f01u + \
+    TLOG_HASH_C(s, 68) * 0xc85a713fu + \
+    TLOG_HASH_C(s, 69) * 0xbf80de81u + \
+    TLOG_HASH_C(s, 70) * 0xff37c1bfu + \
+    TLOG_HASH_C(s, 71) * 0x9077ae01u + \
+    TLOG_HASH_C(s, 72) * 0x3b74d23fu + \
+    TLOG_HASH_C(s, 73) * 0x73febd81u + \
+    TLOG_HASH_C(s, 74) * 0x4931a2bfu + \
+    TLOG_HASH_C(s, 75) * 0xa5f60d01u + \
+    TLOG_HASH_C(s, 76) * 0xe48e333fu + \
+    TLOG_HASH_C(s, 77) * 0x723d9c81u + \
+    TLOG_HASH_C(s, 78) * 0xb9aa83bfu + \
+    TLOG_HASH_C(s, 79) * 0x34b56c01u)
@@ -0,0 +1,60 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include "esp_log.h"
+#include "tlog.h"
+
+#define VARINT_MAX              5
+#define REC_MAX                 (4 + VARINT_MAX * (1 + TLOG_ARG_MAX))
+#define LINE_MAX                (1 + (REC_MAX + 2) / 3 * 4 + 1)
+
+static const char b64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int put_varint(uint8_t *p, int32_t v) {
+    //zigzag, small negative values stay short too
+    uint32_t u = ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+    int n = 0;
+    while (u >= 0x80) {
+        p[n++] = (uint8_t)u | 0x80;
+        u >>= 7;
+    }
+    p[n++] = (uint8_t)u;
+    return n;
+}
+
+static int put_base64(char *out, const uint8_t *in, int len) {
+    int n = 0;
+    for (int i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < len) v |= (uint32_t)in[i + 1] << 8;
+        if (i + 2 < len) v |= in[i + 2];
+        out[n++] = b64_chars[(v >> 18) & 0x3f];
+        out[n++] = b64_chars[(v >> 12) & 0x3f];
+        out[n++] = (i + 1 < len) ? b64_chars[(v >> 6) & 0x3f] : '=';
+        out[n++] = (i + 2 < len) ? b64_chars[v & 0x3f] : '=';
+    }
+    return n;
+}
+
+void tlog_write(uint32_t token, int arg_cnt, ...) {
+    uint8_t rec[REC_MAX];
+    char line[LINE_MAX];
+    int len = 0;
+
+    rec[len++] = token;
+    rec[len++] = token >> 8;
+    rec[len++] = token >> 16;
+    rec[len++] = token >> 24;
+    len += put_varint(&rec[len], (int32_t)esp_log_timestamp());
+
+    va_list ap;
+    va_start(ap, arg_cnt);
+    for (int i = 0; i < arg_cnt; i++) len += put_varint(&rec[len], va_arg(ap, int32_t));
+    va_end(ap);
+
+    //the console adds the \r, one write per line, so lines of different tasks never interleave
+    int n = 0;
+    line[n++] = '$';
+    n += put_base64(&line[n], rec, len);
+    line[n++] = '\n';
+    fwrite(line, 1, n, stdout);
+}
@@ -6,6 +6,7 @@
 #include "driver/gpio.h"
 //#include "esp_random.h"
 #include "esp_log.h"
+#include "tlog.h"
 
 /*
 a counter-intuiative approach LOL is about to described...
@@ -27,12 +28,13 @@ it will raise a bit saying "you guys can continue"
 #define CAMERA_RESET_PEEKED_BIT    BIT2
 #define ALL_TASKS_CONTINUE         BIT3
 
-const char *LOG_TAG_MAIN = "MAIN";
-const char *LOG_TAG_CMD_RECEPTION = "CMD_RECEPTION_HANLDER";
-const char *LOG_TAG_QUALITY = "CAMERA_QUALITY_HANDLER";
-const char *LOG_TAG_RESET = "CAMERA_RESET_HANDLER";
-const char *LOG_TAG_FLASH = "CAMERA_FLASH_HANDLER";
-const char *LOG_TAG_GARBAGE_COLLECTOR = "GARBAGE_COLLECTOR";
+//tags are literals, tlog hashes them together with the format string at compile time
+#define LOG_TAG_MAIN                  "MAIN"
+#define LOG_TAG_CMD_RECEPTION         "CMD_RECEPTION_HANLDER"
+#define LOG_TAG_QUALITY               "CAMERA_QUALITY_HANDLER"
+#define LOG_TAG_RESET                 "CAMERA_RESET_HANDLER"
+#define LOG_TAG_FLASH                 "CAMERA_FLASH_HANDLER"
+#define LOG_TAG_GARBAGE_COLLECTOR     "GARBAGE_COLLECTOR"
 
 const uint8_t camera_quality_handler_ID =   0;
 const uint8_t camera_flash_handler_ID =     1;
@@ -44,15 +46,15 @@ typedef struct {
 } cmd_t;
 
 inline void change_camera_quality(void) {
-    ESP_LOGI(LOG_TAG_QUALITY, "change quality");
+    TLOGI(LOG_TAG_QUALITY, "change quality");
 }
 
 inline void toggle_camera_flash(void) {
-    ESP_LOGI(LOG_TAG_FLASH, "toggle flash");
+    TLOGI(LOG_TAG_FLASH, "toggle flash");
 }
 
 inline void reset_camera(void) {
-    ESP_LOGI(LOG_TAG_RESET, "reset");
+    TLOGI(LOG_TAG_RESET, "reset");
 }
 
 /* IMPLEMENTATION */
@@ -85,7 +87,7 @@ void cmd_reception_handler(void *pvParameters) {
         if (cmd_q == 0) continue;
 
         if (xQueueSendToBack(cmd_q, (void *)&recv_cmd_pkt, (TickType_t)10) == pdPASS) { //if send successfully
-            ESP_LOGI(LOG_TAG_CMD_RECEPTION, "q_length: %d/%d, sent cmd {id:%d,cmd:%x} successfully",
+            TLOGI(LOG_TAG_CMD_RECEPTION, "q_length: %d/%d, sent cmd {id:%d,cmd:%x} successfully",
                     (int)uxQueueMessagesWaiting(cmd_q), 
                     (int)CMD_QUEUE_MAX_LENGTH,
                     recv_cmd_pkt.id, 
@@ -94,7 +96,7 @@ void cmd_reception_handler(void *pvParameters) {
         }
 
         else {
-            ESP_LOGI(LOG_TAG_CMD_RECEPTION, "q_length: %d/%d, sent cmd {id:%d,cmd:%x} failed",
+            TLOGI(LOG_TAG_CMD_RECEPTION, "q_length: %d/%d, sent cmd {id:%d,cmd:%x} failed",
                 (int)uxQueueMessagesWaiting(cmd_q), 
                 (int)CMD_QUEUE_MAX_LENGTH,
                 recv_cmd_pkt.id, 
@@ -118,7 +120,7 @@ void camera_quality_handler(void *pvParameters) {
         //peek to see if the pkt is for this task, not removed from the queue yet
         if (xQueuePeek(cmd_q, (void *)&recv_cmd_pkt, portMAX_DELAY) != pdPASS) continue;
 
-        ESP_LOGI(LOG_TAG_QUALITY, "q_length: %d/%d, peek cmd {id:%d,cmd:%x}",
+        TLOGI(LOG_TAG_QUALITY, "q_length: %d/%d, peek cmd {id:%d,cmd:%x}",
             (int)uxQueueMessagesWaiting(cmd_q), 
             (int)CMD_QUEUE_MAX_LENGTH,
             recv_cmd_pkt.id, 
@@ -135,7 +137,7 @@ void camera_quality_handler(void *pvParameters) {
         }
 
         //do sth
-        ESP_LOGI(LOG_TAG_QUALITY, "q_length: %d/%d, recv cmd {id:%d,cmd:%x} successfully",
+        TLOGI(LOG_TAG_QUALITY, "q_length: %d/%d, recv cmd {id:%d,cmd:%x} successfully",
             (int)uxQueueMessagesWaiting(cmd_q), 
             (int)CMD_QUEUE_MAX_LENGTH,
             recv_cmd_pkt.id, 
@@ -157,7 +159,7 @@ void camera_flash_handler(void *pvParameters) {
         //peek to see if the pkt is for this task, not removed from the queue yet
         if (xQueuePeek(cmd_q, (void *)&recv_cmd_pkt, portMAX_DELAY) != pdPASS) continue;
         
-        ESP_LOGI(LOG_TAG_FLASH, "q_length: %d/%d, peek cmd {id:%d,cmd:%x}",
+        TLOGI(LOG_TAG_FLASH, "q_length: %d/%d, peek cmd {id:%d,cmd:%x}",
             (int)uxQueueMessagesWaiting(cmd_q), 
             (int)CMD_QUEUE_MAX_LENGTH,
             recv_cmd_pkt.id, 
@@ -174,7 +176,7 @@ void camera_flash_handler(void *pvParameters) {
         }
 
         //do sth
-        ESP_LOGI(LOG_TAG_FLASH, "q_length: %d/%d, recv cmd {id:%d,cmd:%x} successfully",
+        TLOGI(LOG_TAG_FLASH, "q_length: %d/%d, recv cmd {id:%d,cmd:%x} successfully",
             (int)uxQueueMessagesWaiting(cmd_q), 
             (int)CMD_QUEUE_MAX_LENGTH,
             recv_cmd_pkt.id, 
@@ -196,7 +198,7 @@ void camera_reset_handler(void *pvParameters) {
         //peek to see if the pkt is for this task, not removed from the queue yet
         if (xQueuePeek(cmd_q, (void *)&recv_cmd_pkt, portMAX_DELAY) != pdPASS) continue;
         
-        ESP_LOGI(LOG_TAG_RESET, "q_length: %d/%d, peek cmd {id:%d,cmd:%x}",
+        TLOGI(LOG_TAG_RESET, "q_length: %d/%d, peek cmd {id:%d,cmd:%x}",
             (int)uxQueueMessagesWaiting(cmd_q), 
             (int)CMD_QUEUE_MAX_LENGTH,
             recv_cmd_pkt.id, 
@@ -213,7 +215,7 @@ void camera_reset_handler(void *pvParameters) {
         }
 
         //do sth
-        ESP_LOGI(LOG_TAG_RESET, "q_length: %d/%d, recv cmd {id:%d,cmd:%x} successfully",
+        TLOGI(LOG_TAG_RESET, "q_length: %d/%d, recv cmd {id:%d,cmd:%x} successfully",
             (int)uxQueueMessagesWaiting(cmd_q), 
             (int)CMD_QUEUE_MAX_LENGTH,
             recv_cmd_pkt.id, 
@@ -233,7 +235,7 @@ void q_garbage_collector(void *pvParameters) {
         xEventGroupWaitBits(tasks_event_group, CAMERA_QUALITY_PEEKED_BIT | CAMERA_FLASH_PEEKED_BIT | CAMERA_RESET_PEEKED_BIT, pdTRUE, pdTRUE, portMAX_DELAY);
 
         if (xQueueReceive(cmd_q, (void *)&recv_cmd_pkt, portMAX_DELAY) != pdPASS) continue;
-        ESP_LOGI(LOG_TAG_GARBAGE_COLLECTOR, "q_length: %d/%d, garbage cmd {id:%d,cmd:%x} collected",
+        TLOGI(LOG_TAG_GARBAGE_COLLECTOR, "q_length: %d/%d, garbage cmd {id:%d,cmd:%x} collected",
             (int)uxQueueMessagesWaiting(cmd_q), 
             (int)CMD_QUEUE_MAX_LENGTH,
             recv_cmd_pkt.id, 
@@ -258,43 +260,43 @@ void app_main(void)
     //createQueue
     cmd_q = xQueueCreate(CMD_QUEUE_MAX_LENGTH, sizeof(cmd_t));
     if (cmd_q == 0) {
-        ESP_LOGI(LOG_TAG_MAIN, "cmd_q created failed!");
+        TLOGI(LOG_TAG_MAIN, "cmd_q created failed!");
         return;
     }
 
     xQueueReset(cmd_q);
-    ESP_LOGI(LOG_TAG_MAIN, "cmd_q created successfully!");
+    TLOGI(LOG_TAG_MAIN, "cmd_q created successfully!");
 
     //createTask
     if (xTaskCreate(&cmd_reception_handler, "cmd_reception_handler", 1024 * 2, NULL, 1, NULL) != pdPASS) {
-        ESP_LOGI(LOG_TAG_MAIN, "cmd_reception_handler created failed!");
+        TLOGI(LOG_TAG_MAIN, "cmd_reception_handler created failed!");
         return;
     }
-    ESP_LOGI(LOG_TAG_MAIN, "cmd_reception_handler created successfully!");
+    TLOGI(LOG_TAG_MAIN, "cmd_reception_handler created successfully!");
 
     if (xTaskCreate(&camera_quality_handler, "camera_quality_handler", 1024 * 2, NULL, 0, NULL) != pdPASS){
-        ESP_LOGI(LOG_TAG_MAIN, "camera_quality_handler created failed!");
+        TLOGI(LOG_TAG_MAIN, "camera_quality_handler created failed!");
         return;
     }
-    ESP_LOGI(LOG_TAG_MAIN, "camera_quality_handler created successfully!");
+    TLOGI(LOG_TAG_MAIN, "camera_quality_handler created successfully!");
 
     if (xTaskCreate(&camera_flash_handler, "camera_flash_handler", 1024 * 2, NULL, 0, NULL) != pdPASS) {
-        ESP_LOGI(LOG_TAG_MAIN, "camera_flash_handler created failed!");
+        TLOGI(LOG_TAG_MAIN, "camera_flash_handler created failed!");
         return;
     }
-    ESP_LOGI(LOG_TAG_MAIN, "camera_flash_handler created successfully!");
+    TLOGI(LOG_TAG_MAIN, "camera_flash_handler created successfully!");
 
     if (xTaskCreate(&camera_reset_handler, "camera_reset_handler", 1024 * 2, NULL, 0, NULL) != pdPASS) {
-        ESP_LOGI(LOG_TAG_MAIN, "camera_reset_handler created failed!");
+        TLOGI(LOG_TAG_MAIN, "camera_reset_handler created failed!");
         return;
     }
-    ESP_LOGI(LOG_TAG_MAIN, "camera_reset_handle created successfully!");
+    TLOGI(LOG_TAG_MAIN, "camera_reset_handle created successfully!");
 
     if (xTaskCreate(&q_garbage_collector, "q_garbage_collector", 1024 * 2, NULL, 0, NULL) != pdPASS) {
-        ESP_LOGI(LOG_TAG_MAIN, "q_garbage_collector created failed!");
+        TLOGI(LOG_TAG_MAIN, "q_garbage_collector created failed!");
         return;
     }
-    ESP_LOGI(LOG_TAG_MAIN, "q_garbage_collector created successfully!");
+    TLOGI(LOG_TAG_MAIN, "q_garbage_collector created successfully!");
 
     vTaskPrioritySet(NULL, 1);
 }
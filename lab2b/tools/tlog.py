@@ -0,0 +1,222 @@
+#!/usr/bin/env python3
+"""
+tokenized log tool for the tlog component.
+
+  tlog.py hash-header -o components/tlog/include/tlog_hash.h
+      writes the C macro that hashes a string literal at compile time.
+  tlog.py db -o build/tlog_db.csv main/main.c ...
+      collects every TLOGx(tag, "fmt", ...) call of the sources into the token database.
+  tlog.py detok build/tlog_db.csv screenlog.0 [...]
+      prints the captures with every "$<base64>" line replaced by the log line it encodes,
+      other lines (boot messages, plain ESP_LOGx) are passed through.
+  tlog.py stats build/tlog_db.csv screenlog.0
+      compares the uart bytes of the tokenized lines with the text they decode to.
+
+a token is the 65599 hash of "<level>\\x1f<tag>\\x1f<fmt>" over the first HASH_LEN chars and the length,
+the same function as TLOG_HASH in tlog_hash.h. a record is the token (4 bytes little endian),
+the timestamp in ms and the args, each a zigzag varint.
+"""
+import argparse
+import base64
+import csv
+import re
+import sys
+
+HASH_K = 65599
+HASH_LEN = 80
+SEP = '\x1f'
+
+LEVELS = 'EWIDV'
+C_STR = r'"(?:[^"\\\n]|\\.)*"'
+CALL_RE = re.compile(r'\bTLOG([EWIDV])\s*\(\s*([A-Za-z_]\w*|' + C_STR + r')\s*,\s*((?:' + C_STR + r'\s*)+)')
+DEFINE_RE = re.compile(r'^\s*#\s*define\s+([A-Za-z_]\w*)\s+((?:' + C_STR + r'\s*)+)$', re.M)
+COMMENT_RE = re.compile(r'//[^\n]*|/\*.*?\*/', re.S)
+CONV_RE = re.compile(r'%([-+ #0]*)(\d*)(?:\.(\d+))?(hh|h|ll|l|z|j|t)?([diouxXcs%])')
+ESCAPES = {'n': '\n', 't': '\t', 'r': '\r', '\\': '\\', '"': '"', "'": "'", '0': '\0'}
+
+
+def token_hash(s):
+    data = s.encode('utf-8')
+    h = len(data)
+    coef = HASH_K
+    for c in data[:HASH_LEN]:
+        h = (h + coef * c) & 0xffffffff
+        coef = (coef * HASH_K) & 0xffffffff
+    return h
+
+
+def c_unquote(lits):
+    """concatenated C string literals to their value"""
+    out = []
+    for lit in re.findall(C_STR, lits):
+        body = lit[1:-1]
+        i = 0
+        while i < len(body):
+            if body[i] != '\\':
+                out.append(body[i])
+                i += 1
+            elif body[i + 1] == 'x':
+                m = re.match(r'[0-9a-fA-F]+', body[i + 2:])
+                out.append(chr(int(m.group(0), 16)))
+                i += 2 + len(m.group(0))
+            else:
+                out.append(ESCAPES.get(body[i + 1], body[i + 1]))
+                i += 2
+    return ''.join(out)
+
+
+def cmd_hash_header(args):
+    terms = []
+    coef = HASH_K
+    for i in range(HASH_LEN):
+        terms.append('TLOG_HASH_C(s, %d) * 0x%08xu' % (i, coef))
+        coef = (coef * HASH_K) & 0xffffffff
+    lines = [
+        '#pragma once',
+        '',
+        '#include <stdint.h>',
+        '',
+        '/* generated by tools/tlog.py hash-header, do not edit */',
+        '',
+        '#define TLOG_HASH_LEN           %d' % HASH_LEN,
+        '',
+        '#define TLOG_HASH_C(s, i) ((i) < sizeof(s) - 1 ? (uint32_t)(uint8_t)(s)[(i) < sizeof(s) ? (i) : 0] : 0u)',
+        '',
+        '/* 65599 hash of a string literal, folded to a constant by the compiler */',
+        '#define TLOG_HASH(s) ((uint32_t)(sizeof(s) - 1) + \\',
+    ]
+    for i, t in enumerate(terms):
+        lines.append('    ' + t + (' + \\' if i < len(terms) - 1 else ')'))
+    with open(args.output, 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+
+
+def cmd_db(args):
+    entries = {}
+    for path in args.sources:
+        with open(path) as f:
+            src = COMMENT_RE.sub('', f.read())
+        defines = {m.group(1): c_unquote(m.group(2)) for m in DEFINE_RE.finditer(src)}
+        for m in CALL_RE.finditer(src):
+            level, tag, fmt = m.group(1), m.group(2), c_unquote(m.group(3))
+            tag = c_unquote(tag) if tag.startswith('"') else defines.get(tag)
+            if tag is None:
+                sys.exit('%s: tag %s of a TLOG%s call is not a string literal #define' % (path, m.group(2), level))
+            token = token_hash(level + SEP + tag + SEP + fmt)
+            if entries.get(token, (level, tag, fmt)) != (level, tag, fmt):
+                sys.exit('%s: token %08x collides, change one of the strings' % (path, token))
+            entries[token] = (level, tag, fmt)
+
+    with open(args.output, 'w', newline='') as f:
+        w = csv.writer(f)
+        w.writerow(['token', 'level', 'tag', 'format'])
+        for token in sorted(entries):
+            w.writerow(['%08x' % token] + list(entries[token]))
+
+
+def load_db(path):
+    with open(path, newline='') as f:
+        return {int(row['token'], 16): (row['level'], row['tag'], row['format']) for row in csv.DictReader(f)}
+
+
+def varints(data, pos):
+    while pos < len(data):
+        v = shift = 0
+        while True:
+            b = data[pos]
+            pos += 1
+            v |= (b & 0x7f) << shift
+            shift += 7
+            if not b & 0x80:
+                break
+        yield (v >> 1) ^ -(v & 1)
+
+
+def format_c(fmt, vals):
+    """printf of 32 bit integer args, %s is not tokenized and prints its raw value"""
+    vals = iter(vals)
+
+    def conv(m):
+        flags, width, prec, _, spec = m.groups()
+        if spec == '%':
+            return '%'
+        v = next(vals, 0)
+        if spec in 'ouxX':
+            v &= 0xffffffff
+        elif spec == 'c':
+            v = chr(v & 0xff)
+        elif spec == 's':
+            spec, v = 'x', v & 0xffffffff
+        return ('%' + flags + width + ('.' + prec if prec else '') + spec) % v
+    return CONV_RE.sub(conv, fmt)
+
+
+def decode(db, text):
+    """the log line of one "$<base64>" record, None when it is not one"""
+    try:
+        data = base64.b64decode(text, validate=True)
+    except ValueError:
+        return None
+    if len(data) < 5:
+        return None
+    token = int.from_bytes(data[:4], 'little')
+    vals = list(varints(data, 4))
+    if token not in db or not vals:
+        return '$%s (unknown token %08x)' % (text, token)
+    level, tag, fmt = db[token]
+    return '%s (%d) %s: %s' % (level, vals[0], tag, format_c(fmt, vals[1:]))
+
+
+def tokenized_lines(path):
+    with open(path, 'rb') as f:
+        for raw in f:
+            line = raw.decode('utf-8', 'replace').rstrip('\r\n')
+            yield raw, line, line[1:] if line.startswith('$') else None
+
+
+def cmd_detok(args):
+    db = load_db(args.db)
+    for path in args.logs:
+        for _, line, b64 in tokenized_lines(path):
+            text = decode(db, b64) if b64 is not None else None
+            print(line if text is None else text)
+
+
+def cmd_stats(args):
+    db = load_db(args.db)
+    tok_bytes = text_bytes = n = 0
+    for path in args.logs:
+        for raw, _, b64 in tokenized_lines(path):
+            text = decode(db, b64) if b64 is not None else None
+            if text is None:
+                continue
+            n += 1
+            tok_bytes += len(raw)
+            text_bytes += len(text) + 2
+    if n == 0:
+        sys.exit('no tokenized lines')
+    print('%d records: %d uart bytes tokenized, %d as text (%.1fx), %.1f vs %.1f bytes per record' %
+          (n, tok_bytes, text_bytes, text_bytes / tok_bytes, tok_bytes / n, text_bytes / n))
+
+
+def main():
+    p = argparse.ArgumentParser(description='tokenized log tool')
+    sub = p.add_subparsers(dest='cmd', required=True)
+    s = sub.add_parser('hash-header')
+    s.add_argument('-o', '--output', required=True)
+    s.set_defaults(fn=cmd_hash_header)
+    s = sub.add_parser('db')
+    s.add_argument('-o', '--output', required=True)
+    s.add_argument('sources', nargs='+')
+    s.set_defaults(fn=cmd_db)
+    for name, fn in (('detok', cmd_detok), ('stats', cmd_stats)):
+        s = sub.add_parser(name)
+        s.add_argument('db')
+        s.add_argument('logs', nargs='+')
+        s.set_defaults(fn=fn)
+    args = p.parse_args()
+    args.fn(args)
+
+
+if __name__ == '__main__':
+    main()
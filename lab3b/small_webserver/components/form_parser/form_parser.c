@@ -0,0 +1,116 @@
+#include "form_parser.h"
+
+static int hex_val(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static void reset_pair(form_parser_t *parser) {
+    parser->key_len = 0;
+    parser->value_len = 0;
+    parser->in_value = 0;
+    parser->pct_digits = 0;
+    parser->pct_byte = 0;
+}
+
+/* append one decoded byte to the current key or value, always leave room for the NUL */
+static esp_err_t put_byte(form_parser_t *parser, char c) {
+    if (parser->in_value) {
+        if (parser->value_len + 1 >= parser->value_size) return ESP_ERR_INVALID_SIZE;
+        parser->value[parser->value_len++] = c;
+    } else {
+        if (parser->key_len + 1 >= parser->key_size) return ESP_ERR_INVALID_SIZE;
+        parser->key[parser->key_len++] = c;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t emit_pair(form_parser_t *parser) {
+    esp_err_t err = ESP_OK;
+
+    //a '%' without its 2 hex digits at the end of a pair
+    if (parser->pct_digits != 0) return ESP_ERR_INVALID_ARG;
+
+    //skip empty pairs like "a=1&&b=2"
+    if (parser->key_len > 0 || parser->in_value) {
+        parser->key[parser->key_len] = '\0';
+        parser->value[parser->value_len] = '\0';
+        err = parser->cb(parser->key, parser->key_len, parser->value, parser->value_len, parser->ctx);
+    }
+
+    reset_pair(parser);
+    return err;
+}
+
+void form_parser_init(form_parser_t *parser, char *key, size_t key_size, char *value, size_t value_size,
+                      form_parser_pair_cb_t cb, void *ctx) {
+    form_parser_set_storage(parser, key, key_size, value, value_size);
+    parser->cb = cb;
+    parser->ctx = ctx;
+    parser->err = (key_size == 0 || value_size == 0 || cb == NULL) ? ESP_ERR_INVALID_ARG : ESP_OK;
+    reset_pair(parser);
+}
+
+void form_parser_set_storage(form_parser_t *parser, char *key, size_t key_size, char *value, size_t value_size) {
+    parser->key = key;
+    parser->key_size = key_size;
+    parser->value = value;
+    parser->value_size = value_size;
+}
+
+esp_err_t form_parser_feed(form_parser_t *parser, const char *buf, size_t len) {
+    esp_err_t err = parser->err;
+
+    for (size_t i = 0; i < len && err == ESP_OK; i++) {
+        char c = buf[i];
+
+        //inside a %XX escape, the digits may arrive in different chunks
+        if (parser->pct_digits != 0) {
+            int v = hex_val(c);
+            if (v < 0) {
+                err = ESP_ERR_INVALID_ARG;
+                break;
+            }
+            parser->pct_byte = (uint8_t)((parser->pct_byte << 4) | v);
+            if (++parser->pct_digits == 3) {
+                parser->pct_digits = 0;
+                err = put_byte(parser, (char)parser->pct_byte);
+            }
+            continue;
+        }
+
+        switch (c) {
+        case '&':
+        case '\n':
+            err = emit_pair(parser);
+            break;
+        case '\r':
+            break;
+        case '=':
+            //only the first '=' splits key and value, later ones belong to the value
+            if (!parser->in_value) parser->in_value = 1;
+            else err = put_byte(parser, c);
+            break;
+        case '%':
+            parser->pct_digits = 1;
+            parser->pct_byte = 0;
+            break;
+        case '+':
+            err = put_byte(parser, ' ');
+            break;
+        default:
+            err = put_byte(parser, c);
+            break;
+        }
+    }
+
+    parser->err = err;
+    return err;
+}
+
+esp_err_t form_parser_finish(form_parser_t *parser) {
+    if (parser->err == ESP_OK) parser->err = emit_pair(parser);
+    return parser->err;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+streaming application/x-www-form-urlencoded parser.
+
+- body is fed chunk by chunk as it comes out of httpd_req_recv, a pair may span several chunks.
+- %XX and '+' are decoded while scanning, straight into the caller's key/value storage (no intermediate copy).
+- key/value storage is bounds checked, an oversize pair makes the parser fail with ESP_ERR_INVALID_SIZE.
+- every complete pair is handed to the callback as NUL terminated strings, storage is reused for the next pair.
+- pairs are separated by '&' or by a newline, so newline delimited records ("toggle=1\nstr=hi\n") work too.
+a raw newline can never be part of urlencoded data, '\r' is ignored.
+*/
+
+/* called once per decoded pair, returning anything but ESP_OK stops the parser with that error */
+typedef esp_err_t (*form_parser_pair_cb_t)(const char *key, size_t key_len, const char *value, size_t value_len, void *ctx);
+
+typedef struct {
+    char *key;
+    size_t key_size;
+    size_t key_len;
+    char *value;
+    size_t value_size;
+    size_t value_len;
+    uint8_t in_value;       //0 while scanning key, 1 after '='
+    uint8_t pct_digits;     //number of hex digits seen after '%' (0 when not escaping)
+    uint8_t pct_byte;
+    esp_err_t err;          //sticky error, once set every call returns it
+    form_parser_pair_cb_t cb;
+    void *ctx;
+} form_parser_t;
+
+/* key_size/value_size include the NUL terminator */
+void form_parser_init(form_parser_t *parser, char *key, size_t key_size, char *value, size_t value_size,
+                      form_parser_pair_cb_t cb, void *ctx);
+
+/* point the parser at new key/value storage, allowed from inside the callback (takes effect for the next pair) */
+void form_parser_set_storage(form_parser_t *parser, char *key, size_t key_size, char *value, size_t value_size);
+
+/* consume the next body chunk */
+esp_err_t form_parser_feed(form_parser_t *parser, const char *buf, size_t len);
+
+/* end of body, flush the last pair */
+esp_err_t form_parser_finish(form_parser_t *parser);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+compact encoding of small flat objects ({"on":true}, {"ticket":12}) as JSON or CBOR (RFC 8949).
+
+- the writer formats straight into the caller's buffer, no allocation and no intermediate copy.
+- overflow is sticky, obj_writer_finish reports it once at the end instead of every call being checked.
+- CBOR maps are definite length, the field count is given to obj_begin.
+- the reader looks a key up in a flat object body (no nesting), values are decoded into the caller's storage.
+*/
+
+typedef enum {
+    OBJ_FMT_JSON = 0,
+    OBJ_FMT_CBOR,
+} obj_fmt_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    obj_fmt_t fmt;
+    uint8_t fields;         //fields written so far, JSON needs it for the separators
+    esp_err_t err;          //sticky error, ESP_ERR_INVALID_SIZE once the buffer is full
+} obj_writer_t;
+
+void obj_writer_init(obj_writer_t *w, obj_fmt_t fmt, void *buf, size_t size);
+
+void obj_begin(obj_writer_t *w, uint8_t field_cnt);
+void obj_bool(obj_writer_t *w, const char *key, bool value);
+void obj_uint(obj_writer_t *w, const char *key, uint32_t value);
+void obj_str(obj_writer_t *w, const char *key, const char *value, size_t len);
+void obj_end(obj_writer_t *w);
+
+/* length of the encoded object, ESP_ERR_INVALID_SIZE if it did not fit */
+esp_err_t obj_writer_finish(obj_writer_t *w, size_t *len);
+
+/*
+find key in a flat JSON or CBOR object.
+ESP_ERR_NOT_FOUND if the key is missing, ESP_ERR_INVALID_ARG if the body is malformed or the value has another type,
+ESP_ERR_INVALID_SIZE if a string value does not fit value_size (NUL included).
+*/
+esp_err_t obj_read_bool(obj_fmt_t fmt, const void *body, size_t len, const char *key, bool *value);
+esp_err_t obj_read_str(obj_fmt_t fmt, const void *body, size_t len, const char *key, char *value, size_t value_size);
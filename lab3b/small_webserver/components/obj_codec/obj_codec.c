@@ -0,0 +1,431 @@
+#include <string.h>
+#include "obj_codec.h"
+
+#define CBOR_MAJOR_UINT         0
+#define CBOR_MAJOR_BYTES        2
+#define CBOR_MAJOR_TEXT         3
+#define CBOR_MAJOR_MAP          5
+#define CBOR_MAJOR_SIMPLE       7
+#define CBOR_FALSE              0xf4
+#define CBOR_TRUE               0xf5
+
+#define OBJ_KEY_MAX             32  //longer keys in a request body can never match ours
+
+/*================= WRITER =================*/
+static void put(obj_writer_t *w, const void *data, size_t n) {
+    if (w->err != ESP_OK) return;
+    if (w->len + n > w->size) {
+        w->err = ESP_ERR_INVALID_SIZE;
+        return;
+    }
+    memcpy(w->buf + w->len, data, n);
+    w->len += n;
+}
+
+static void put_byte(obj_writer_t *w, uint8_t b) {
+    put(w, &b, 1);
+}
+
+/* major type in the top 3 bits, the argument inline below 24 or in the 1/2/4 bytes that follow */
+static void cbor_head(obj_writer_t *w, uint8_t major, uint32_t arg) {
+    uint8_t head[5];
+    size_t n;
+
+    if (arg < 24) {
+        head[0] = (major << 5) | arg;
+        n = 1;
+    } else if (arg <= 0xff) {
+        head[0] = (major << 5) | 24;
+        head[1] = arg;
+        n = 2;
+    } else if (arg <= 0xffff) {
+        head[0] = (major << 5) | 25;
+        head[1] = arg >> 8;
+        head[2] = arg;
+        n = 3;
+    } else {
+        head[0] = (major << 5) | 26;
+        head[1] = arg >> 24;
+        head[2] = arg >> 16;
+        head[3] = arg >> 8;
+        head[4] = arg;
+        n = 5;
+    }
+    put(w, head, n);
+}
+
+static void json_str(obj_writer_t *w, const char *s, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+
+    put_byte(w, '"');
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = (uint8_t)s[i];
+        if (c == '"' || c == '\\') {
+            put_byte(w, '\\');
+            put_byte(w, c);
+        } else if (c < 0x20) {
+            char esc[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+            put(w, esc, sizeof(esc));
+        } else {
+            put_byte(w, c);
+        }
+    }
+    put_byte(w, '"');
+}
+
+static void obj_key(obj_writer_t *w, const char *key) {
+    size_t len = strlen(key);
+
+    if (w->fmt == OBJ_FMT_CBOR) {
+        cbor_head(w, CBOR_MAJOR_TEXT, len);
+        put(w, key, len);
+    } else {
+        if (w->fields > 0) put_byte(w, ',');
+        json_str(w, key, len);
+        put_byte(w, ':');
+    }
+    w->fields++;
+}
+
+void obj_writer_init(obj_writer_t *w, obj_fmt_t fmt, void *buf, size_t size) {
+    w->buf = (uint8_t *)buf;
+    w->size = size;
+    w->len = 0;
+    w->fmt = fmt;
+    w->fields = 0;
+    w->err = ESP_OK;
+}
+
+void obj_begin(obj_writer_t *w, uint8_t field_cnt) {
+    if (w->fmt == OBJ_FMT_CBOR) {
+        cbor_head(w, CBOR_MAJOR_MAP, field_cnt);
+    } else {
+        put_byte(w, '{');
+    }
+}
+
+void obj_bool(obj_writer_t *w, const char *key, bool value) {
+    obj_key(w, key);
+    if (w->fmt == OBJ_FMT_CBOR) {
+        put_byte(w, value ? CBOR_TRUE : CBOR_FALSE);
+    } else if (value) {
+        put(w, "true", 4);
+    } else {
+        put(w, "false", 5);
+    }
+}
+
+void obj_uint(obj_writer_t *w, const char *key, uint32_t value) {
+    obj_key(w, key);
+    if (w->fmt == OBJ_FMT_CBOR) {
+        cbor_head(w, CBOR_MAJOR_UINT, value);
+        return;
+    }
+
+    //digits come out backwards
+    char digits[10];
+    size_t n = 0;
+    do {
+        digits[sizeof(digits) - 1 - n++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    put(w, digits + sizeof(digits) - n, n);
+}
+
+void obj_str(obj_writer_t *w, const char *key, const char *value, size_t len) {
+    obj_key(w, key);
+    if (w->fmt == OBJ_FMT_CBOR) {
+        cbor_head(w, CBOR_MAJOR_TEXT, len);
+        put(w, value, len);
+    } else {
+        json_str(w, value, len);
+    }
+}
+
+void obj_end(obj_writer_t *w) {
+    if (w->fmt == OBJ_FMT_JSON) put_byte(w, '}');
+}
+
+esp_err_t obj_writer_finish(obj_writer_t *w, size_t *len) {
+    *len = (w->err == ESP_OK) ? w->len : 0;
+    return w->err;
+}
+
+/*================= READER =================*/
+typedef enum {
+    VAL_BOOL = 0,
+    VAL_STR,
+} val_type_t;
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} cursor_t;
+
+//where a found value goes, str is NULL when looking for a bool
+typedef struct {
+    val_type_t type;
+    bool *b;
+    char *str;
+    size_t str_size;
+} val_out_t;
+
+/* JSON */
+static void json_ws(cursor_t *c) {
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\r' || *c->p == '\n')) c->p++;
+}
+
+static int hex_val(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/*
+decode a string at the cursor into out (NUL terminated, out may be NULL to skip it).
+*truncated is set when it did not fit, the string is still consumed so the scan can go on.
+*/
+static esp_err_t json_parse_str(cursor_t *c, char *out, size_t out_size, bool *truncated) {
+    size_t len = 0;
+    *truncated = false;
+
+    if (c->p >= c->end || *c->p != '"') return ESP_ERR_INVALID_ARG;
+    c->p++;
+
+    while (c->p < c->end && *c->p != '"') {
+        uint8_t utf8[3];
+        size_t n = 1;
+        uint8_t ch = *c->p++;
+
+        if (ch < 0x20) return ESP_ERR_INVALID_ARG;
+        utf8[0] = ch;
+        if (ch == '\\') {
+            if (c->p >= c->end) return ESP_ERR_INVALID_ARG;
+            switch (*c->p++) {
+            case '"': utf8[0] = '"'; break;
+            case '\\': utf8[0] = '\\'; break;
+            case '/': utf8[0] = '/'; break;
+            case 'b': utf8[0] = '\b'; break;
+            case 'f': utf8[0] = '\f'; break;
+            case 'n': utf8[0] = '\n'; break;
+            case 'r': utf8[0] = '\r'; break;
+            case 't': utf8[0] = '\t'; break;
+            case 'u': {
+                uint32_t cp = 0;
+                if (c->end - c->p < 4) return ESP_ERR_INVALID_ARG;
+                for (int i = 0; i < 4; i++) {
+                    int v = hex_val(*c->p++);
+                    if (v < 0) return ESP_ERR_INVALID_ARG;
+                    cp = (cp << 4) | v;
+                }
+                //surrogate pairs are not needed for any value we accept
+                if (cp >= 0xd800 && cp <= 0xdfff) return ESP_ERR_INVALID_ARG;
+                if (cp < 0x80) {
+                    utf8[0] = cp;
+                } else if (cp < 0x800) {
+                    utf8[0] = 0xc0 | (cp >> 6);
+                    utf8[1] = 0x80 | (cp & 0x3f);
+                    n = 2;
+                } else {
+                    utf8[0] = 0xe0 | (cp >> 12);
+                    utf8[1] = 0x80 | ((cp >> 6) & 0x3f);
+                    utf8[2] = 0x80 | (cp & 0x3f);
+                    n = 3;
+                }
+                break;
+            }
+            default:
+                return ESP_ERR_INVALID_ARG;
+            }
+        }
+
+        if (out == NULL) continue;
+        if (len + n >= out_size) {
+            *truncated = true;
+            continue;
+        }
+        memcpy(out + len, utf8, n);
+        len += n;
+    }
+
+    if (c->p >= c->end) return ESP_ERR_INVALID_ARG;
+    c->p++;     //closing quote
+    if (out != NULL) out[len] = '\0';
+    return ESP_OK;
+}
+
+static bool json_literal(cursor_t *c, const char *lit) {
+    size_t n = strlen(lit);
+    if ((size_t)(c->end - c->p) < n || memcmp(c->p, lit, n) != 0) return false;
+    c->p += n;
+    return true;
+}
+
+/* skip a scalar value, nested objects and arrays are not part of our api */
+static esp_err_t json_skip_val(cursor_t *c) {
+    bool truncated;
+
+    if (c->p >= c->end) return ESP_ERR_INVALID_ARG;
+    if (*c->p == '"') return json_parse_str(c, NULL, 0, &truncated);
+    if (json_literal(c, "true") || json_literal(c, "false") || json_literal(c, "null")) return ESP_OK;
+
+    const uint8_t *start = c->p;
+    while (c->p < c->end && ((*c->p >= '0' && *c->p <= '9') || *c->p == '-' || *c->p == '+' ||
+                             *c->p == '.' || *c->p == 'e' || *c->p == 'E')) {
+        c->p++;
+    }
+    return (c->p > start) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t json_read_val(cursor_t *c, const val_out_t *out) {
+    if (out->type == VAL_BOOL) {
+        if (json_literal(c, "true")) {
+            *out->b = true;
+        } else if (json_literal(c, "false")) {
+            *out->b = false;
+        } else {
+            return ESP_ERR_INVALID_ARG;
+        }
+        return ESP_OK;
+    }
+
+    bool truncated;
+    esp_err_t err = json_parse_str(c, out->str, out->str_size, &truncated);
+    if (err != ESP_OK) return err;
+    return truncated ? ESP_ERR_INVALID_SIZE : ESP_OK;
+}
+
+static esp_err_t json_find(cursor_t *c, const char *key, const val_out_t *out) {
+    json_ws(c);
+    if (c->p >= c->end || *c->p++ != '{') return ESP_ERR_INVALID_ARG;
+    json_ws(c);
+    if (c->p < c->end && *c->p == '}') return ESP_ERR_NOT_FOUND;
+
+    for (;;) {
+        char k[OBJ_KEY_MAX];
+        bool truncated;
+
+        json_ws(c);
+        esp_err_t err = json_parse_str(c, k, sizeof(k), &truncated);
+        if (err != ESP_OK) return err;
+        json_ws(c);
+        if (c->p >= c->end || *c->p++ != ':') return ESP_ERR_INVALID_ARG;
+        json_ws(c);
+
+        if (!truncated && strcmp(k, key) == 0) return json_read_val(c, out);
+        err = json_skip_val(c);
+        if (err != ESP_OK) return err;
+
+        json_ws(c);
+        if (c->p >= c->end) return ESP_ERR_INVALID_ARG;
+        if (*c->p == '}') return ESP_ERR_NOT_FOUND;
+        if (*c->p++ != ',') return ESP_ERR_INVALID_ARG;
+    }
+}
+
+/* CBOR */
+static esp_err_t cbor_parse_head(cursor_t *c, uint8_t *major, uint32_t *arg) {
+    if (c->p >= c->end) return ESP_ERR_INVALID_ARG;
+    uint8_t ib = *c->p++;
+    uint8_t info = ib & 0x1f;
+    size_t n;
+
+    *major = ib >> 5;
+    if (info < 24) {
+        *arg = info;
+        return ESP_OK;
+    }
+    //8 byte arguments and indefinite lengths are never needed for a few short fields
+    if (info == 24) n = 1;
+    else if (info == 25) n = 2;
+    else if (info == 26) n = 4;
+    else return ESP_ERR_INVALID_ARG;
+
+    if ((size_t)(c->end - c->p) < n) return ESP_ERR_INVALID_ARG;
+    *arg = 0;
+    for (size_t i = 0; i < n; i++) *arg = (*arg << 8) | *c->p++;
+    return ESP_OK;
+}
+
+static esp_err_t cbor_skip_val(cursor_t *c) {
+    uint8_t major;
+    uint32_t arg;
+    esp_err_t err = cbor_parse_head(c, &major, &arg);
+    if (err != ESP_OK) return err;
+
+    switch (major) {
+    case CBOR_MAJOR_BYTES:
+    case CBOR_MAJOR_TEXT:
+        if ((size_t)(c->end - c->p) < arg) return ESP_ERR_INVALID_ARG;
+        c->p += arg;
+        return ESP_OK;
+    case CBOR_MAJOR_UINT:
+    case 1:                     //negative int
+    case CBOR_MAJOR_SIMPLE:     //simple values and floats are fully consumed by the head
+        return ESP_OK;
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+}
+
+static esp_err_t cbor_read_val(cursor_t *c, const val_out_t *out) {
+    if (out->type == VAL_BOOL) {
+        if (c->p >= c->end) return ESP_ERR_INVALID_ARG;
+        if (*c->p != CBOR_TRUE && *c->p != CBOR_FALSE) return ESP_ERR_INVALID_ARG;
+        *out->b = (*c->p++ == CBOR_TRUE);
+        return ESP_OK;
+    }
+
+    uint8_t major;
+    uint32_t len;
+    esp_err_t err = cbor_parse_head(c, &major, &len);
+    if (err != ESP_OK) return err;
+    if (major != CBOR_MAJOR_TEXT || (size_t)(c->end - c->p) < len) return ESP_ERR_INVALID_ARG;
+    if (len >= out->str_size) return ESP_ERR_INVALID_SIZE;
+    memcpy(out->str, c->p, len);
+    out->str[len] = '\0';
+    c->p += len;
+    return ESP_OK;
+}
+
+static esp_err_t cbor_find(cursor_t *c, const char *key, const val_out_t *out) {
+    uint8_t major;
+    uint32_t pairs;
+    size_t key_len = strlen(key);
+
+    esp_err_t err = cbor_parse_head(c, &major, &pairs);
+    if (err != ESP_OK) return err;
+    if (major != CBOR_MAJOR_MAP) return ESP_ERR_INVALID_ARG;
+
+    for (uint32_t i = 0; i < pairs; i++) {
+        uint32_t len;
+        err = cbor_parse_head(c, &major, &len);
+        if (err != ESP_OK) return err;
+        if (major != CBOR_MAJOR_TEXT || (size_t)(c->end - c->p) < len) return ESP_ERR_INVALID_ARG;
+
+        bool match = (len == key_len && memcmp(c->p, key, len) == 0);
+        c->p += len;
+        if (match) return cbor_read_val(c, out);
+
+        err = cbor_skip_val(c);
+        if (err != ESP_OK) return err;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+static esp_err_t obj_find(obj_fmt_t fmt, const void *body, size_t len, const char *key, const val_out_t *out) {
+    cursor_t c = { .p = (const uint8_t *)body, .end = (const uint8_t *)body + len };
+    return (fmt == OBJ_FMT_CBOR) ? cbor_find(&c, key, out) : json_find(&c, key, out);
+}
+
+esp_err_t obj_read_bool(obj_fmt_t fmt, const void *body, size_t len, const char *key, bool *value) {
+    val_out_t out = { .type = VAL_BOOL, .b = value };
+    return obj_find(fmt, body, len, key, &out);
+}
+
+esp_err_t obj_read_str(obj_fmt_t fmt, const void *body, size_t len, const char *key, char *value, size_t value_size) {
+    if (value_size == 0) return ESP_ERR_INVALID_SIZE;
+    val_out_t out = { .type = VAL_STR, .str = value, .str_size = value_size };
+    return obj_find(fmt, body, len, key, &out);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+URI router: a trie of path segments built once from a constant route table, looked up once per request.
+
+- a route is a method and a path like "/api/led" or "/status/{ticket}", its id is its index in the table.
+- a "{name}" segment matches any single segment, the matched text is returned as a parameter.
+- literal segments win over parameters, with backtracking when the literal branch does not lead to a route.
+- the query string is ignored, empty segments ("//", trailing '/') are skipped.
+- nodes live in the trie struct (no allocation), the lookup only reads it and can run from any task.
+*/
+
+#ifndef ROUTE_TRIE_MAX_NODES
+#define ROUTE_TRIE_MAX_NODES    32
+#endif
+#ifndef ROUTE_TRIE_MAX_ROUTES
+#define ROUTE_TRIE_MAX_ROUTES   24
+#endif
+#define ROUTE_MAX_PARAMS        2
+
+#define ROUTE_NOT_FOUND         -1
+#define ROUTE_METHOD_NOT_ALLOWED -2 //the path exists but not for this method
+
+typedef struct {
+    int method;         //http_method value (HTTP_GET, ...)
+    const char *path;   //must stay valid, nodes point into it
+} route_def_t;
+
+typedef struct {
+    const char *seg;    //literal segment text, NULL for a parameter node
+    uint8_t seg_len;
+    int16_t child;      //first literal child
+    int16_t sibling;
+    int16_t param;      //parameter child
+    int16_t route;      //first route ending here, the others follow through route_next
+} route_node_t;
+
+typedef struct {
+    route_node_t nodes[ROUTE_TRIE_MAX_NODES];
+    int16_t route_next[ROUTE_TRIE_MAX_ROUTES];
+    const route_def_t *defs;
+    int node_cnt;
+} route_trie_t;
+
+typedef struct {
+    const char *start;  //points into the looked up uri, not NUL terminated
+    size_t len;
+} route_param_t;
+
+typedef struct {
+    route_param_t params[ROUTE_MAX_PARAMS];
+    int param_cnt;
+} route_match_t;
+
+/* ESP_ERR_NO_MEM when the table does not fit, ESP_ERR_INVALID_STATE on a duplicate method + path */
+esp_err_t route_trie_build(route_trie_t *trie, const route_def_t *defs, int cnt);
+
+/* route id, or ROUTE_NOT_FOUND / ROUTE_METHOD_NOT_ALLOWED. match may be NULL when the parameters are not needed */
+int route_trie_lookup(const route_trie_t *trie, int method, const char *uri, route_match_t *match);
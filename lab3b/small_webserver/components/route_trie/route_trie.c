@@ -0,0 +1,139 @@
+#include <stdbool.h>
+#include <string.h>
+#include "route_trie.h"
+
+#define NO_NODE                 -1
+#define ROOT_NODE               0
+
+static bool path_end(char c) {
+    return c == '\0' || c == '?' || c == '#';
+}
+
+/* next non empty segment at *p, false at the end of the path */
+static bool next_seg(const char **p, const char **seg, size_t *len) {
+    const char *s = *p;
+    while (*s == '/') s++;
+    if (path_end(*s)) {
+        *p = s;
+        return false;
+    }
+
+    const char *e = s;
+    while (*e != '/' && !path_end(*e)) e++;
+    *seg = s;
+    *len = e - s;
+    *p = e;
+    return true;
+}
+
+static int new_node(route_trie_t *trie, const char *seg, size_t len) {
+    if (trie->node_cnt >= ROUTE_TRIE_MAX_NODES) return NO_NODE;
+
+    route_node_t *node = &trie->nodes[trie->node_cnt];
+    node->seg = seg;
+    node->seg_len = len;
+    node->child = NO_NODE;
+    node->sibling = NO_NODE;
+    node->param = NO_NODE;
+    node->route = NO_NODE;
+    return trie->node_cnt++;
+}
+
+/* literal child of n matching seg, created at the end of the child list (keeps table order) if missing */
+static int literal_child(route_trie_t *trie, int n, const char *seg, size_t len) {
+    int16_t *link = &trie->nodes[n].child;
+    while (*link != NO_NODE) {
+        route_node_t *c = &trie->nodes[*link];
+        if (c->seg_len == len && memcmp(c->seg, seg, len) == 0) return *link;
+        link = &c->sibling;
+    }
+
+    int c = new_node(trie, seg, len);
+    if (c != NO_NODE) *link = c;
+    return c;
+}
+
+esp_err_t route_trie_build(route_trie_t *trie, const route_def_t *defs, int cnt) {
+    if (cnt > ROUTE_TRIE_MAX_ROUTES) return ESP_ERR_NO_MEM;
+
+    trie->defs = defs;
+    trie->node_cnt = 0;
+    new_node(trie, NULL, 0);
+
+    for (int i = 0; i < cnt; i++) {
+        const char *p = defs[i].path;
+        const char *seg;
+        size_t len;
+        int n = ROOT_NODE;
+
+        while (next_seg(&p, &seg, &len)) {
+            if (len > UINT8_MAX) return ESP_ERR_INVALID_ARG;
+            if (seg[0] == '{') {
+                //parameter names only document the table, all parameters of a node share one child
+                if (trie->nodes[n].param == NO_NODE) {
+                    int c = new_node(trie, NULL, 0);
+                    if (c == NO_NODE) return ESP_ERR_NO_MEM;
+                    trie->nodes[n].param = c;
+                }
+                n = trie->nodes[n].param;
+            } else {
+                n = literal_child(trie, n, seg, len);
+                if (n == NO_NODE) return ESP_ERR_NO_MEM;
+            }
+        }
+
+        int16_t *link = &trie->nodes[n].route;
+        while (*link != NO_NODE) {
+            if (defs[*link].method == defs[i].method) return ESP_ERR_INVALID_STATE;
+            link = &trie->route_next[*link];
+        }
+        *link = i;
+        trie->route_next[i] = NO_NODE;
+    }
+    return ESP_OK;
+}
+
+static int match_node(const route_trie_t *trie, int n, int method, const char *p, route_match_t *match,
+                      bool *path_found) {
+    const route_node_t *node = &trie->nodes[n];
+    const char *seg;
+    size_t len;
+
+    if (!next_seg(&p, &seg, &len)) {
+        for (int r = node->route; r != NO_NODE; r = trie->route_next[r]) {
+            if (trie->defs[r].method == method) return r;
+        }
+        if (node->route != NO_NODE) *path_found = true;
+        return ROUTE_NOT_FOUND;
+    }
+
+    for (int c = node->child; c != NO_NODE; c = trie->nodes[c].sibling) {
+        if (trie->nodes[c].seg_len == len && memcmp(trie->nodes[c].seg, seg, len) == 0) {
+            int r = match_node(trie, c, method, p, match, path_found);
+            if (r >= 0) return r;
+            break;  //literals are unique among siblings
+        }
+    }
+
+    if (node->param != NO_NODE && match->param_cnt < ROUTE_MAX_PARAMS) {
+        int k = match->param_cnt++;
+        match->params[k].start = seg;
+        match->params[k].len = len;
+        int r = match_node(trie, node->param, method, p, match, path_found);
+        if (r >= 0) return r;
+        match->param_cnt = k;
+    }
+    return ROUTE_NOT_FOUND;
+}
+
+int route_trie_lookup(const route_trie_t *trie, int method, const char *uri, route_match_t *match) {
+    route_match_t unused;
+    bool path_found = false;
+
+    if (match == NULL) match = &unused;
+    match->param_cnt = 0;
+
+    int r = match_node(trie, ROOT_NODE, method, uri, match, &path_found);
+    if (r < 0 && path_found) return ROUTE_METHOD_NOT_ALLOWED;
+    return r;
+}
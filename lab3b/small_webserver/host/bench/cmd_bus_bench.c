@@ -0,0 +1,218 @@
+/*
+cmd_bus_bench: messages/s and publish-to-handler latency of the cmd bus against the peek/sync/GC queue protocol
+it replaced, with a led and a print handler task that only take the cmd.
+
+- legacy: one queue of key/value pkts, both handlers xQueuePeek it and meet on an event group barrier, the
+garbage_collector task dequeues once both peeked. the task bodies are the pre cmd_bus main.c without the logging.
+- bus: main/cmd_bus.c as the firmware uses it, cmd_bus_alloc/publish from the producer, take/release in the handlers.
+- the producer alternates toggle and str cmds and waits when the queue or the message pool is full, so every cmd is
+delivered in both runs. latency is from the publish call until the handler owning the cmd has it.
+- runs on the host port (pthreads), the numbers compare the protocols, not the esp32.
+
+usage: cmd_bus_bench [-n cmds]
+*/
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+#include "cmd_bus.h"
+
+#define DEFAULT_CMDS            200000
+#define LEGACY_QUEUE_LEN        5       //QUEUE_MAX_LEN of the old main.c
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/*================= RESULTS =================*/
+typedef struct {
+    uint32_t *lat_ns;           //one entry per delivered cmd
+    atomic_uint done;
+    atomic_uint ready;          //handler tasks set up, the producer may start
+} run_t;
+
+static run_t run;
+
+static void run_reset(int cmds) {
+    free(run.lat_ns);
+    run.lat_ns = calloc(cmds, sizeof(uint32_t));
+    atomic_store(&run.done, 0);
+    atomic_store(&run.ready, 0);
+}
+
+static void run_record(uint64_t stamp) {
+    unsigned int i = atomic_fetch_add(&run.done, 1);
+    run.lat_ns[i] = (uint32_t)(now_ns() - stamp);
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void run_report(const char *name, int cmds, uint64_t elapsed_ns) {
+    qsort(run.lat_ns, cmds, sizeof(uint32_t), cmp_u32);
+    printf("%-8s %10.0f cmds/s  latency us: p50 %7.1f  p99 %7.1f  max %8.1f\n", name,
+           cmds * 1e9 / elapsed_ns, run.lat_ns[cmds / 2] / 1e3, run.lat_ns[(int)(cmds * 0.99)] / 1e3,
+           run.lat_ns[cmds - 1] / 1e3);
+}
+
+static void wait_ready(unsigned int tasks) {
+    while (atomic_load(&run.ready) < tasks) sched_yield();
+}
+
+static void wait_done(int cmds) {
+    while (atomic_load(&run.done) < (unsigned int)cmds) sched_yield();
+}
+
+/*================= LEGACY =================*/
+#define PEEK_LED_TASK_BIT       BIT0
+#define PEEK_PRINT_TASK_BIT     BIT1
+#define ALL_TASKS_CONTINUE      BIT2
+
+typedef struct {
+    char key[KEY_BUF_SIZE];
+    char value[VAL_BUF_SIZE];   //the producer's timestamp
+} key_value_t;
+
+static QueueHandle_t q;
+static EventGroupHandle_t tasks_event_group;
+
+static void legacy_handler(const char *key, EventBits_t peek_bit) {
+    key_value_t recv_pkt;
+    atomic_fetch_add(&run.ready, 1);
+
+    for (;;) {
+        if (xQueuePeek(q, (void *)&recv_pkt, portMAX_DELAY) != pdPASS) continue;
+
+        xEventGroupSync(tasks_event_group, peek_bit, ALL_TASKS_CONTINUE, portMAX_DELAY);
+        xEventGroupClearBits(tasks_event_group, ALL_TASKS_CONTINUE);
+
+        if (strcmp(recv_pkt.key, key) != 0) continue;
+
+        uint64_t stamp;
+        memcpy(&stamp, recv_pkt.value, sizeof(stamp));
+        run_record(stamp);
+    }
+}
+
+static void legacy_led_handler(void *pvParameters) {
+    legacy_handler("toggle", PEEK_LED_TASK_BIT);
+}
+
+static void legacy_print_handler(void *pvParameters) {
+    legacy_handler("str", PEEK_PRINT_TASK_BIT);
+}
+
+static void legacy_garbage_collector(void *pvParameters) {
+    key_value_t recv_pkt;
+    atomic_fetch_add(&run.ready, 1);
+
+    for (;;) {
+        xEventGroupWaitBits(tasks_event_group, PEEK_LED_TASK_BIT | PEEK_PRINT_TASK_BIT, pdTRUE, pdTRUE, portMAX_DELAY);
+        xQueueReceive(q, (void *)&recv_pkt, portMAX_DELAY);
+        xEventGroupSetBits(tasks_event_group, ALL_TASKS_CONTINUE);
+    }
+}
+
+static uint64_t legacy_run(int cmds) {
+    q = xQueueCreate(LEGACY_QUEUE_LEN, sizeof(key_value_t));
+    tasks_event_group = xEventGroupCreate();
+    xTaskCreate(&legacy_led_handler, "led_handler", 2048, NULL, 0, NULL);
+    xTaskCreate(&legacy_print_handler, "print_handler", 2048, NULL, 0, NULL);
+    xTaskCreate(&legacy_garbage_collector, "garbage_collector", 2048, NULL, 0, NULL);
+    wait_ready(3);
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < cmds; i++) {
+        key_value_t pkt = { 0 };
+        strcpy(pkt.key, (i & 1) ? "str" : "toggle");
+        uint64_t stamp = now_ns();
+        memcpy(pkt.value, &stamp, sizeof(stamp));
+        xQueueSendToBack(q, (void *)&pkt, portMAX_DELAY);
+    }
+    wait_done(cmds);
+    return now_ns() - start;
+}
+
+/*================= BUS =================*/
+static cmd_sub_t led_sub;
+static cmd_sub_t print_sub;
+
+static void bus_handler(cmd_sub_t *sub, cmd_id_t id) {
+    cmd_bus_subscribe(sub, CMD_BIT(id));
+    atomic_fetch_add(&run.ready, 1);
+
+    for (;;) {
+        cmd_msg_t *msg = cmd_bus_take(sub, portMAX_DELAY);
+        if (msg == NULL) continue;
+
+        uint64_t stamp;
+        memcpy(&stamp, msg->value, sizeof(stamp));
+        run_record(stamp);
+        cmd_bus_release(msg);
+    }
+}
+
+static void bus_led_handler(void *pvParameters) {
+    bus_handler(&led_sub, CMD_ID_TOGGLE);
+}
+
+static void bus_print_handler(void *pvParameters) {
+    bus_handler(&print_sub, CMD_ID_STR);
+}
+
+static uint64_t bus_run(int cmds) {
+    cmd_bus_init();
+    xTaskCreate(&bus_led_handler, "led_handler", 2048, NULL, 0, NULL);
+    xTaskCreate(&bus_print_handler, "print_handler", 2048, NULL, 0, NULL);
+    wait_ready(2);
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < cmds; i++) {
+        cmd_msg_t *msg;
+        //a full pool is the bus' back pressure, the producer waits like on the full legacy queue
+        while ((msg = cmd_bus_alloc()) == NULL) sched_yield();
+        msg->id = (i & 1) ? CMD_ID_STR : CMD_ID_TOGGLE;
+        uint64_t stamp = now_ns();
+        memcpy(msg->value, &stamp, sizeof(stamp));
+        cmd_bus_publish(msg);
+    }
+    wait_done(cmds);
+    return now_ns() - start;
+}
+
+int main(int argc, char **argv) {
+    int cmds = DEFAULT_CMDS;
+    int c;
+    while ((c = getopt(argc, argv, "n:")) != -1) {
+        switch (c) {
+        case 'n': cmds = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n cmds]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (cmds < 2) cmds = 2;
+
+    printf("%d cmds, half toggle half str, %ld cpus\n", cmds, sysconf(_SC_NPROCESSORS_ONLN));
+
+    run_reset(cmds);
+    uint64_t elapsed = legacy_run(cmds);
+    run_report("legacy", cmds, elapsed);
+
+    run_reset(cmds);
+    elapsed = bus_run(cmds);
+    run_report("cmd_bus", cmds, elapsed);
+    return 0;
+}
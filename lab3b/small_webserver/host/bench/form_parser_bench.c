@@ -0,0 +1,180 @@
+/*
+form_parser_bench: MB/s of form bodies through components/form_parser against the extract_content() it replaced.
+
+- bodies are key=value pairs like the web page and the load tools post them: short toggle cmds, str cmds with '+'
+and %XX escapes, and a mix. every body is about 64 KB so the timing is not dominated by setup.
+- form_parser is fed the body in IO_BUF_SIZE (512 byte) chunks like recv_cmds does, and whole as the upper bound.
+the callback only counts the pairs.
+- extract_content only knows one pair per body, it is run on every pair on its own, already split out, which is
+the best case for it (the split is not timed). it is the pre form_parser main.c code, unchanged.
+- best of N passes, MB/s counts body bytes.
+
+usage: form_parser_bench [-p passes]
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "form_parser.h"
+
+#define BODY_SIZE               (64 * 1024)
+#define IO_BUF_SIZE             512     //the io block of main.c
+#define KEY_BUF_SIZE            50      //cmd_bus.h
+#define VAL_BUF_SIZE            50
+#define MAX_PAIRS               (BODY_SIZE / 2)
+#define DEFAULT_PASSES          20
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/*================= BODIES =================*/
+typedef struct {
+    const char *name;
+    const char *const *pairs;   //repeated until the body is full
+    char body[BODY_SIZE];
+    size_t len;
+    size_t pair_off[MAX_PAIRS]; //start of every pair, for extract_content
+    size_t pair_len[MAX_PAIRS];
+    int pair_cnt;
+} body_t;
+
+static const char *const toggle_pairs[] = { "toggle=1", NULL };
+static const char *const str_pairs[] = { "str=hello+world%21", "str=led+is+%3Con%3E", "str=50%25+done", NULL };
+static const char *const mix_pairs[] = { "toggle=1", "str=hello+world", "led=0", "str=a%2Bb%3Dc", NULL };
+
+static body_t bodies[] = {
+    { .name = "toggle", .pairs = toggle_pairs },
+    { .name = "str", .pairs = str_pairs },
+    { .name = "mix", .pairs = mix_pairs },
+};
+
+static void body_build(body_t *b) {
+    b->len = 0;
+    b->pair_cnt = 0;
+    for (int i = 0;; i++) {
+        if (b->pairs[i] == NULL) i = 0;
+        const char *pair = b->pairs[i];
+        size_t n = strlen(pair);
+        if (b->len + n + 1 > BODY_SIZE) break;
+
+        if (b->len > 0) b->body[b->len++] = '&';
+        b->pair_off[b->pair_cnt] = b->len;
+        b->pair_len[b->pair_cnt++] = n;
+        memcpy(b->body + b->len, pair, n);
+        b->len += n;
+    }
+}
+
+/*================= EXTRACT_CONTENT =================*/
+typedef struct {
+    char key[KEY_BUF_SIZE];
+    char value[VAL_BUF_SIZE];
+} key_value_t;
+
+key_value_t extract_content(char *buf, int buf_len) {
+    key_value_t ret;
+
+    //extract key
+    int i;
+    for (i = 0; buf[i] != '='; i++) {
+        ret.key[i] = buf[i];
+    }
+    ret.key[i] = '\0';
+    i++; //skip =
+
+    //extract value
+    int key_len = i;
+    for (; i < buf_len; i++) {
+        if (buf[i] == '+') ret.value[i - key_len] = ' ';
+        else ret.value[i - key_len] = buf[i];
+    }
+    ret.value[i - key_len] = '\0';
+
+    return ret;
+}
+
+static int run_extract(body_t *b) {
+    volatile int sink = 0;
+    for (int i = 0; i < b->pair_cnt; i++) {
+        key_value_t kv = extract_content(b->body + b->pair_off[i], (int)b->pair_len[i]);
+        sink += kv.value[0];
+    }
+    (void)sink;
+    return b->pair_cnt;
+}
+
+/*================= FORM_PARSER =================*/
+static esp_err_t count_pair(const char *key, size_t key_len, const char *value, size_t value_len, void *ctx) {
+    (*(int *)ctx)++;
+    return ESP_OK;
+}
+
+static int run_form_parser(body_t *b, size_t chunk) {
+    char key[KEY_BUF_SIZE], value[VAL_BUF_SIZE];
+    form_parser_t parser;
+    int pairs = 0;
+
+    form_parser_init(&parser, key, sizeof(key), value, sizeof(value), count_pair, &pairs);
+    for (size_t off = 0; off < b->len; off += chunk) {
+        size_t n = b->len - off < chunk ? b->len - off : chunk;
+        if (form_parser_feed(&parser, b->body + off, n) != ESP_OK) return -1;
+    }
+    if (form_parser_finish(&parser) != ESP_OK) return -1;
+    return pairs;
+}
+
+/*================= MAIN =================*/
+typedef enum { RUN_EXTRACT, RUN_PARSER_IO, RUN_PARSER_WHOLE } run_kind_t;
+
+static void bench(body_t *b, run_kind_t kind, int passes) {
+    static const char *const names[] = { "extract_content", "form_parser 512B", "form_parser whole" };
+    uint64_t best = UINT64_MAX;
+    int pairs = 0;
+
+    for (int p = 0; p < passes; p++) {
+        uint64_t start = now_ns();
+        switch (kind) {
+        case RUN_EXTRACT: pairs = run_extract(b); break;
+        case RUN_PARSER_IO: pairs = run_form_parser(b, IO_BUF_SIZE); break;
+        case RUN_PARSER_WHOLE: pairs = run_form_parser(b, b->len); break;
+        }
+        uint64_t t = now_ns() - start;
+        if (t < best) best = t;
+    }
+
+    if (pairs != b->pair_cnt) {
+        fprintf(stderr, "%s on %s: %d pairs, expected %d\n", names[kind], b->name, pairs, b->pair_cnt);
+        exit(1);
+    }
+    printf("%-7s %-18s %8.1f MB/s  %6.1f Mpairs/s\n", b->name, names[kind], b->len / (best / 1e9) / 1e6,
+           pairs / (best / 1e9) / 1e6);
+}
+
+int main(int argc, char **argv) {
+    int passes = DEFAULT_PASSES;
+    int c;
+    while ((c = getopt(argc, argv, "p:")) != -1) {
+        switch (c) {
+        case 'p': passes = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-p passes]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (passes < 1) passes = 1;
+
+    for (size_t i = 0; i < sizeof(bodies) / sizeof(bodies[0]); i++) {
+        body_t *b = &bodies[i];
+        body_build(b);
+        printf("%s: %zu bytes, %d pairs\n", b->name, b->len, b->pair_cnt);
+        bench(b, RUN_EXTRACT, passes);
+        bench(b, RUN_PARSER_IO, passes);
+        bench(b, RUN_PARSER_WHOLE, passes);
+    }
+    return 0;
+}
@@ -0,0 +1,159 @@
+/*
+index_page_bench: render time per request and stack use of the index page, the strcat chain of gen_index_page
+against the page variants main.c keeps in flash since the index page cache.
+
+- strcat: the pre cache index_get_handler body, a zeroed RESP_BUF_SIZE buffer on the stack filled by
+gen_index_page (legacy_index_page.c).
+- cached: one atomic load of the current variant, like send_index_page. the two variants are rendered once at
+start with gen_index_page, so both runs send the same bytes.
+- both hand the page to the same send stub, which copies it out like lwip copies into its send buffer. the led
+flips on every request.
+- every run is a task of the host port, whose stacks are painted: stack used is the deepest byte touched, the
+"none" run (the loop and the send stub without a page) is the floor the two others are compared to. the host
+numbers are x86-64 frames, the difference between the runs is what carries over to the esp32.
+- ns per request, best of N passes.
+
+usage: index_page_bench [-n requests] [-p passes]
+*/
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "legacy_index_page.h"
+
+#define DEFAULT_REQS            1000000
+#define DEFAULT_PASSES          5
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/*================= PAGES =================*/
+typedef struct {
+    const char *body;
+    size_t len;
+} index_page_t;
+
+static char page_bufs[2][RESP_BUF_SIZE];
+static index_page_t index_pages[2];
+static const index_page_t *_Atomic index_page_cur;
+
+static void index_pages_init(void) {
+    for (int st = 0; st < 2; st++) {
+        led_st = st;
+        index_pages[st].len = gen_index_page(page_bufs[st]);
+        index_pages[st].body = page_bufs[st];
+    }
+    led_st = 1;
+    atomic_store(&index_page_cur, &index_pages[led_st]);
+}
+
+static void toggle_led(void) {
+    led_st = !led_st;
+    atomic_store_explicit(&index_page_cur, &index_pages[led_st], memory_order_release);
+}
+
+/*================= SEND =================*/
+static char tx_buf[RESP_BUF_SIZE];
+static volatile size_t tx_len;
+
+__attribute__((noinline)) static void resp_send(const char *buf, size_t len) {
+    memcpy(tx_buf, buf, len);
+    tx_len = len;
+}
+
+/*================= REQUESTS =================*/
+__attribute__((noinline)) static void req_none(void) {
+    resp_send("", 0);
+}
+
+__attribute__((noinline)) static void req_strcat(void) {
+    char resp_buf[RESP_BUF_SIZE] = "";
+    int resp_buf_len = gen_index_page(resp_buf);
+    resp_send(resp_buf, resp_buf_len);
+}
+
+__attribute__((noinline)) static void req_cached(void) {
+    const index_page_t *page = atomic_load_explicit(&index_page_cur, memory_order_acquire);
+    resp_send(page->body, page->len);
+}
+
+/*================= RUNS =================*/
+typedef struct {
+    const char *name;
+    void (*req)(void);
+    int reqs;
+    int passes;
+    uint64_t best_ns;
+    UBaseType_t stack_used;
+    atomic_int done;
+} run_t;
+
+static void run_task(void *pvParameters) {
+    run_t *run = pvParameters;
+    run->best_ns = UINT64_MAX;
+
+    for (int p = 0; p < run->passes; p++) {
+        uint64_t start = now_ns();
+        for (int i = 0; i < run->reqs; i++) {
+            toggle_led();
+            run->req();
+        }
+        uint64_t t = now_ns() - start;
+        if (t < run->best_ns) run->best_ns = t;
+    }
+
+    run->stack_used = port_task_stack_size() - uxTaskGetStackHighWaterMark(NULL);
+    atomic_store(&run->done, 1);
+    vTaskDelete(NULL);
+}
+
+/* every run on a fresh task, so its stack high-water is its own */
+static void run(run_t *r) {
+    if (xTaskCreate(run_task, r->name, 4096, r, 5, NULL) != pdPASS) {
+        fprintf(stderr, "cannot create the %s task\n", r->name);
+        exit(1);
+    }
+    while (!atomic_load(&r->done)) sched_yield();
+}
+
+int main(int argc, char **argv) {
+    int reqs = DEFAULT_REQS, passes = DEFAULT_PASSES;
+    int c;
+    while ((c = getopt(argc, argv, "n:p:")) != -1) {
+        switch (c) {
+        case 'n': reqs = atoi(optarg); break;
+        case 'p': passes = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n requests] [-p passes]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (reqs < 1) reqs = 1;
+    if (passes < 1) passes = 1;
+
+    index_pages_init();
+    printf("page %zu/%zu bytes, %d requests, best of %d\n", index_pages[0].len, index_pages[1].len, reqs, passes);
+
+    run_t runs[] = {
+        { .name = "none", .req = req_none },
+        { .name = "strcat", .req = req_strcat },
+        { .name = "cached", .req = req_cached },
+    };
+    for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); i++) {
+        run_t *r = &runs[i];
+        r->reqs = reqs;
+        r->passes = passes;
+        run(r);
+        printf("%-7s %8.1f ns/req  stack used %5u bytes (+%u over none)\n", r->name, (double)r->best_ns / reqs,
+               (unsigned int)r->stack_used, (unsigned int)(r->stack_used - runs[0].stack_used));
+    }
+    return 0;
+}
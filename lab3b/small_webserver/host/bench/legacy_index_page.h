@@ -0,0 +1,8 @@
+#pragma once
+
+#define RESP_BUF_SIZE           500     //the stack buffer index_get_handler rendered into
+
+extern int led_st;
+
+/* buf must be zeroed, returns the page length */
+int gen_index_page(char *buf);
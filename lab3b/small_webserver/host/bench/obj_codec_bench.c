@@ -0,0 +1,131 @@
+/*
+obj_codec_bench: serialization cost and response size of the /api objects against rendering the index page,
+which is what every form POST and GET / answered with before the api existed.
+
+- gen_index_page is the pre cache main.c renderer (legacy_index_page.c), into a zeroed RESP_BUF_SIZE buffer like
+index_get_handler did.
+- the objects are the ones the api handlers write, encoded with components/obj_codec into an API_RESP_SIZE buffer,
+as JSON and as CBOR. the ticket changes every call so the number width varies like on a running server.
+- ns per response, best of N passes of a fixed number of calls. the host numbers compare the encoders, not the esp32.
+
+usage: obj_codec_bench [-n calls] [-p passes]
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "obj_codec.h"
+#include "legacy_index_page.h"
+
+#define API_RESP_SIZE           32      //main.c
+#define DEFAULT_CALLS           1000000
+#define DEFAULT_PASSES          5
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static volatile size_t sink;
+
+/*================= RESPONSES =================*/
+typedef size_t (*resp_fn_t)(obj_fmt_t fmt, uint32_t n);
+
+static size_t resp_index_page(obj_fmt_t fmt, uint32_t n) {
+    char resp_buf[RESP_BUF_SIZE] = "";
+    led_st = n & 1;
+    int len = gen_index_page(resp_buf);
+    sink = resp_buf[len - 1];
+    return len;
+}
+
+static size_t finish(obj_writer_t *w, const uint8_t *buf) {
+    size_t len = 0;
+    if (obj_writer_finish(w, &len) != ESP_OK) {
+        fprintf(stderr, "object does not fit API_RESP_SIZE\n");
+        exit(1);
+    }
+    sink = buf[len - 1];
+    return len;
+}
+
+/* GET /api/led */
+static size_t resp_led_get(obj_fmt_t fmt, uint32_t n) {
+    uint8_t resp_buf[API_RESP_SIZE];
+    obj_writer_t w;
+    obj_writer_init(&w, fmt, resp_buf, sizeof(resp_buf));
+    obj_begin(&w, 1);
+    obj_bool(&w, "on", n & 1);
+    obj_end(&w);
+    return finish(&w, resp_buf);
+}
+
+/* PUT /api/led */
+static size_t resp_led_put(obj_fmt_t fmt, uint32_t n) {
+    uint8_t resp_buf[API_RESP_SIZE];
+    obj_writer_t w;
+    obj_writer_init(&w, fmt, resp_buf, sizeof(resp_buf));
+    obj_begin(&w, 2);
+    obj_bool(&w, "on", n & 1);
+    obj_uint(&w, "ticket", n);
+    obj_end(&w);
+    return finish(&w, resp_buf);
+}
+
+/* POST /api/print */
+static size_t resp_print(obj_fmt_t fmt, uint32_t n) {
+    uint8_t resp_buf[API_RESP_SIZE];
+    obj_writer_t w;
+    obj_writer_init(&w, fmt, resp_buf, sizeof(resp_buf));
+    obj_begin(&w, 1);
+    obj_uint(&w, "ticket", n);
+    obj_end(&w);
+    return finish(&w, resp_buf);
+}
+
+/*================= MAIN =================*/
+static void bench(const char *name, const char *fmt_name, resp_fn_t fn, obj_fmt_t fmt, int calls, int passes) {
+    uint64_t best = UINT64_MAX;
+    size_t min_len = SIZE_MAX, max_len = 0;
+
+    for (int p = 0; p < passes; p++) {
+        uint64_t start = now_ns();
+        for (int i = 0; i < calls; i++) {
+            //tickets from 1 to 31 bits wide, the server issues them up to 2^31
+            size_t len = fn(fmt, (uint32_t)i * 2654435761u >> ((i & 31) | 1));
+            if (len < min_len) min_len = len;
+            if (len > max_len) max_len = len;
+        }
+        uint64_t t = now_ns() - start;
+        if (t < best) best = t;
+    }
+    printf("%-16s %-5s %8.1f ns  %4zu..%-4zu bytes\n", name, fmt_name, (double)best / calls, min_len, max_len);
+}
+
+int main(int argc, char **argv) {
+    int calls = DEFAULT_CALLS, passes = DEFAULT_PASSES;
+    int c;
+    while ((c = getopt(argc, argv, "n:p:")) != -1) {
+        switch (c) {
+        case 'n': calls = atoi(optarg); break;
+        case 'p': passes = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n calls] [-p passes]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (calls < 1) calls = 1;
+    if (passes < 1) passes = 1;
+
+    bench("gen_index_page", "html", resp_index_page, OBJ_FMT_JSON, calls, passes);
+    bench("GET /api/led", "json", resp_led_get, OBJ_FMT_JSON, calls, passes);
+    bench("GET /api/led", "cbor", resp_led_get, OBJ_FMT_CBOR, calls, passes);
+    bench("PUT /api/led", "json", resp_led_put, OBJ_FMT_JSON, calls, passes);
+    bench("PUT /api/led", "cbor", resp_led_put, OBJ_FMT_CBOR, calls, passes);
+    bench("POST /api/print", "json", resp_print, OBJ_FMT_JSON, calls, passes);
+    bench("POST /api/print", "cbor", resp_print, OBJ_FMT_CBOR, calls, passes);
+    return 0;
+}
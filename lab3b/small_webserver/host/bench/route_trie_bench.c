@@ -0,0 +1,175 @@
+/*
+route_trie_bench: route lookup cost with 100+ routes, components/route_trie against a linear scan of the table.
+
+- the table is 16 groups of 8 resources, "/api/v1/group<g>/item<i>", every fourth with a "/{id}" parameter and
+every eighth with a POST next to its GET: 144 routes. the firmware's table is far smaller, the bench build raises
+ROUTE_TRIE_MAX_ROUTES and ROUTE_TRIE_MAX_NODES on the command line (see host/build.sh).
+- the linear scan is how httpd matches its uri handlers: every entry in turn, segment by segment, with the same
+"{name}" and query string rules as the trie and the same 404/405 answer.
+- the lookups cycle through every route in a scrambled order, plus a query string on some and misses: a path that
+does not exist (404) and a method the path does not have (405). both lookups must agree on every request.
+- ns per lookup, best of N passes.
+
+usage: route_trie_bench [-n rounds] [-p passes]
+*/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "route_trie.h"
+
+#define GROUPS                  16
+#define ITEMS                   8
+#define PATHS                   (GROUPS * ITEMS)
+#define ROUTES                  (PATHS + PATHS / 8)
+#define REQS                    (ROUTES + 2 * GROUPS)
+#define PATH_SIZE               48
+#define METHOD_GET              1       //http_method values
+#define METHOD_POST             3
+#define METHOD_DELETE           0
+#define DEFAULT_ROUNDS          2000
+#define DEFAULT_PASSES          5
+
+_Static_assert(ROUTES <= ROUTE_TRIE_MAX_ROUTES, "build with -DROUTE_TRIE_MAX_ROUTES=160");
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/*================= TABLE =================*/
+typedef struct {
+    int method;
+    char uri[PATH_SIZE];
+    int expect;         //route id, ROUTE_NOT_FOUND or ROUTE_METHOD_NOT_ALLOWED
+} req_t;
+
+static char paths[PATHS][PATH_SIZE];
+static route_def_t defs[ROUTES];
+static req_t reqs[REQS];
+
+static void table_build(void) {
+    int r = 0;
+    for (int i = 0; i < PATHS; i++) {
+        snprintf(paths[i], PATH_SIZE, "/api/v1/group%d/item%d%s", i / ITEMS, i % ITEMS, (i % 4 == 0) ? "/{id}" : "");
+        defs[r++] = (route_def_t){ .method = METHOD_GET, .path = paths[i] };
+        if (i % 8 == 0) defs[r++] = (route_def_t){ .method = METHOD_POST, .path = paths[i] };
+    }
+
+    for (int i = 0; i < ROUTES; i++) {
+        //a multiplier coprime with ROUTES scrambles the order so no lookup follows its neighbour
+        int id = (int)(((unsigned int)i * 97u) % ROUTES);
+        const route_def_t *d = &defs[id];
+        req_t *q = &reqs[i];
+        q->method = d->method;
+        q->expect = id;
+
+        const char *param = strstr(d->path, "{id}");
+        int len = param ? (int)(param - d->path) : (int)strlen(d->path);
+        snprintf(q->uri, PATH_SIZE, "%.*s%s%s", len, d->path, param ? "42" : "", (i % 3 == 0) ? "?x=1" : "");
+    }
+    for (int g = 0; g < GROUPS; g++) {
+        req_t *q = &reqs[ROUTES + 2 * g];
+        q[0] = (req_t){ .method = METHOD_GET, .expect = ROUTE_NOT_FOUND };
+        snprintf(q[0].uri, PATH_SIZE, "/api/v1/group%d/item%d", g, ITEMS);
+        q[1] = (req_t){ .method = METHOD_DELETE, .expect = ROUTE_METHOD_NOT_ALLOWED };
+        snprintf(q[1].uri, PATH_SIZE, "/api/v1/group%d/item1", g);
+    }
+}
+
+/*================= LINEAR =================*/
+static bool path_end(char c) {
+    return c == '\0' || c == '?' || c == '#';
+}
+
+/* segment by segment, a "{name}" pattern segment takes any non empty uri segment */
+static bool linear_match(const char *pat, const char *uri, route_match_t *match) {
+    match->param_cnt = 0;
+    for (;;) {
+        while (*pat == '/') pat++;
+        while (*uri == '/') uri++;
+        if (*pat == '\0' || path_end(*uri)) return *pat == '\0' && path_end(*uri);
+
+        const char *u = uri;
+        while (*u != '/' && !path_end(*u)) u++;
+        if (*pat == '{') {
+            if (match->param_cnt == ROUTE_MAX_PARAMS) return false;
+            match->params[match->param_cnt++] = (route_param_t){ .start = uri, .len = u - uri };
+            while (*pat != '/' && *pat != '\0') pat++;
+        } else {
+            size_t len = u - uri;
+            if (strncmp(pat, uri, len) != 0 || (pat[len] != '/' && pat[len] != '\0')) return false;
+            pat += len;
+        }
+        uri = u;
+    }
+}
+
+static int linear_lookup(int method, const char *uri, route_match_t *match) {
+    bool path_found = false;
+    for (int i = 0; i < ROUTES; i++) {
+        if (!linear_match(defs[i].path, uri, match)) continue;
+        if (defs[i].method == method) return i;
+        path_found = true;
+    }
+    return path_found ? ROUTE_METHOD_NOT_ALLOWED : ROUTE_NOT_FOUND;
+}
+
+/*================= MAIN =================*/
+static route_trie_t trie;
+
+static void bench(const char *name, bool use_trie, int rounds, int passes) {
+    uint64_t best = UINT64_MAX;
+    route_match_t match;
+
+    for (int p = 0; p < passes; p++) {
+        uint64_t start = now_ns();
+        for (int k = 0; k < rounds; k++) {
+            for (int i = 0; i < REQS; i++) {
+                const req_t *q = &reqs[i];
+                int r = use_trie ? route_trie_lookup(&trie, q->method, q->uri, &match)
+                                 : linear_lookup(q->method, q->uri, &match);
+                if (r != q->expect) {
+                    fprintf(stderr, "%s: %d %s is %d, expected %d\n", name, q->method, q->uri, r, q->expect);
+                    exit(1);
+                }
+            }
+        }
+        uint64_t t = now_ns() - start;
+        if (t < best) best = t;
+    }
+    printf("%-8s %8.1f ns/lookup\n", name, (double)best / rounds / REQS);
+}
+
+int main(int argc, char **argv) {
+    int rounds = DEFAULT_ROUNDS, passes = DEFAULT_PASSES;
+    int c;
+    while ((c = getopt(argc, argv, "n:p:")) != -1) {
+        switch (c) {
+        case 'n': rounds = atoi(optarg); break;
+        case 'p': passes = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n rounds] [-p passes]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (rounds < 1) rounds = 1;
+    if (passes < 1) passes = 1;
+
+    table_build();
+    esp_err_t err = route_trie_build(&trie, defs, ROUTES);
+    if (err != ESP_OK) {
+        fprintf(stderr, "route_trie_build: %d, raise ROUTE_TRIE_MAX_NODES\n", err);
+        return 1;
+    }
+    printf("%d routes, %d trie nodes, %d lookups per round (%d misses)\n", ROUTES, trie.node_cnt, REQS,
+           REQS - ROUTES);
+
+    bench("trie", true, rounds, passes);
+    bench("linear", false, rounds, passes);
+    return 0;
+}
@@ -0,0 +1,43 @@
+# builds the server as a linux process plus the load tools into host/build, run from anywhere
+# the firmware formats size_t with %d (it is unsigned int on xtensa), -Wno-format keeps the 64 bit host build quiet
+set -e
+cd "$(dirname "$0")/.."
+out=host/build
+mkdir -p $out
+
+gzip -9 -n -c test.html > $out/test.html.gz
+(cd $out && ld -r -b binary -o test_html_gz.o test.html.gz)
+
+server() {
+    gcc -O2 -g -Wall -Wno-format -pthread \
+        -Ihost/port/include -Imain -Icomponents/form_parser/include -Icomponents/obj_codec/include \
+        -Icomponents/route_trie/include \
+        main/*.c components/*/*.c host/port/*.c $out/test_html_gz.o -Wl,-z,noexecstack -Wl,-z,now "$@"
+}
+server -o $out/small_webserver
+# admission control lifted, for measuring cmds/s of the server itself (loadgen -b)
+server -DADMIT_RATE=1000000 -DADMIT_BURST=1000000 -DADMIT_CLIENT_RATE=1000000 -DADMIT_CLIENT_BURST=1000000 \
+    -o $out/small_webserver_noadmit
+# every request on the httpd task, the baseline for loadgen -s
+server -DHTTP_WORKER_CNT=0 -o $out/small_webserver_noworkers
+gcc -O2 -Wall -pthread -o $out/loadgen host/loadgen.c
+gcc -O2 -Wall -o $out/udp_ctrl_client host/udp_ctrl_client.c
+
+# benches of single components against what they replaced, see the comment at the top of each file
+gcc -O2 -g -Wall -pthread -Ihost/port/include -Imain \
+    host/bench/cmd_bus_bench.c main/cmd_bus.c main/buf_pool.c host/port/port_freertos.c -o $out/cmd_bus_bench
+gcc -O2 -g -Wall -Icomponents/form_parser/include -Ihost/port/include \
+    host/bench/form_parser_bench.c components/form_parser/form_parser.c -o $out/form_parser_bench
+
+# fuzz targets, run without arguments for random bodies or with corpus/crash files, see the comment at the top
+gcc -O1 -g -Wall -fsanitize=address,undefined -fno-omit-frame-pointer -Icomponents/form_parser/include \
+    -Ihost/port/include host/fuzz/form_parser_fuzz.c components/form_parser/form_parser.c -o $out/form_parser_fuzz
+gcc -O2 -g -Wall -Icomponents/obj_codec/include -Ihost/port/include \
+    host/bench/obj_codec_bench.c host/bench/legacy_index_page.c components/obj_codec/obj_codec.c \
+    -o $out/obj_codec_bench
+# 144 routes, far more than the firmware's table
+gcc -O2 -g -Wall -DROUTE_TRIE_MAX_ROUTES=160 -DROUTE_TRIE_MAX_NODES=256 -Icomponents/route_trie/include \
+    -Ihost/port/include host/bench/route_trie_bench.c components/route_trie/route_trie.c -o $out/route_trie_bench
+gcc -O2 -g -Wall -pthread -Ihost/port/include \
+    host/bench/index_page_bench.c host/bench/legacy_index_page.c host/port/port_freertos.c -Wl,-z,now \
+    -o $out/index_page_bench
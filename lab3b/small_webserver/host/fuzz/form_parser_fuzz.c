@@ -0,0 +1,299 @@
+/*
+form_parser_fuzz: differential fuzz target of components/form_parser.
+
+- every input is parsed three times, fed whole, byte by byte and in chunks cut at random points, and once by a
+plain non streaming decoder of the same grammar. all four must emit the same pairs and end with the same error.
+- the first input byte picks the chunk cuts and after how many pairs the callback stops the parser with an error,
+the rest is the body.
+- key and value storage are small and the value storage changes size on every pair (set from the callback, like
+recv_cmds does), so oversize pairs and form_parser_set_storage are hit often.
+- the callback checks the strings are NUL terminated within their storage, asan checks every access.
+- LLVMFuzzerTestOneInput is the libFuzzer entry point, with -DFORM_PARSER_FUZZ_LIBFUZZER the main below is left out
+(clang -fsanitize=fuzzer). without it the main runs the files given as arguments (a corpus or a crash) or, with no
+files, -n random bodies built from the characters the grammar cares about.
+
+build: see host/build.sh (gcc -fsanitize=address,undefined)
+usage: form_parser_fuzz [-n iters] [-s seed] [files...]
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "form_parser.h"
+
+#define FUZZ_KEY_SIZE           12
+#define FUZZ_VALUE_SIZE_EVEN    6       //value storage of pair 0, 2, 4...
+#define FUZZ_VALUE_SIZE_ODD     20
+#define FUZZ_STOP_ERR           ESP_ERR_INVALID_STATE   //returned by the callback to stop the parser
+#define DEFAULT_ITERS           1000000
+#define MAX_BODY                256     //random bodies only, files may be longer
+
+static void fuzz_fail(const char *what) {
+    fprintf(stderr, "form_parser_fuzz: %s\n", what);
+    abort();
+}
+
+/*================= RECORD =================*/
+//everything a parse produced, pairs as (len, bytes) so keys and values with %00 in them compare too
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t size;
+    int pairs;
+    int stop_after;         //the callback fails on this pair, -1 never
+    esp_err_t err;
+} record_t;
+
+static void record_put(record_t *r, const void *p, size_t len) {
+    if (r->len + len > r->size) {
+        r->size = (r->len + len) * 2;
+        r->buf = realloc(r->buf, r->size);
+        if (r->buf == NULL) abort();
+    }
+    memcpy(r->buf + r->len, p, len);
+    r->len += len;
+}
+
+static void record_pair(record_t *r, const char *key, size_t key_len, const char *value, size_t value_len) {
+    uint32_t n = (uint32_t)key_len;
+    record_put(r, &n, sizeof(n));
+    record_put(r, key, key_len);
+    n = (uint32_t)value_len;
+    record_put(r, &n, sizeof(n));
+    record_put(r, value, value_len);
+}
+
+static void record_reset(record_t *r, int stop_after) {
+    r->len = 0;
+    r->pairs = 0;
+    r->stop_after = stop_after;
+    r->err = ESP_OK;
+}
+
+static size_t value_size_of(int pair) {
+    return (pair & 1) ? FUZZ_VALUE_SIZE_ODD : FUZZ_VALUE_SIZE_EVEN;
+}
+
+/*================= FORM_PARSER =================*/
+typedef struct {
+    form_parser_t parser;
+    record_t *rec;
+    char key[FUZZ_KEY_SIZE];
+    char value_even[FUZZ_VALUE_SIZE_EVEN];
+    char value_odd[FUZZ_VALUE_SIZE_ODD];
+} fuzz_ctx_t;
+
+static char *value_storage(fuzz_ctx_t *ctx, int pair) {
+    return (pair & 1) ? ctx->value_odd : ctx->value_even;
+}
+
+static esp_err_t fuzz_cb(const char *key, size_t key_len, const char *value, size_t value_len, void *arg) {
+    fuzz_ctx_t *ctx = (fuzz_ctx_t *)arg;
+    record_t *r = ctx->rec;
+
+    if (key != ctx->key || value != value_storage(ctx, r->pairs)) fuzz_fail("pair not in the current storage");
+    if (key_len >= FUZZ_KEY_SIZE || value_len >= value_size_of(r->pairs)) fuzz_fail("pair longer than its storage");
+    if (key[key_len] != '\0' || value[value_len] != '\0') fuzz_fail("pair not NUL terminated");
+
+    record_pair(r, key, key_len, value, value_len);
+    if (r->pairs++ == r->stop_after) return FUZZ_STOP_ERR;
+
+    //the next pair goes to storage of the other size
+    form_parser_set_storage(&ctx->parser, ctx->key, FUZZ_KEY_SIZE, value_storage(ctx, r->pairs),
+                            value_size_of(r->pairs));
+    return ESP_OK;
+}
+
+/* feed body in chunks of the given lengths (cuts NULL: the whole body at once) */
+static void parse_chunked(record_t *r, const uint8_t *body, size_t len, const size_t *cuts, int cut_cnt) {
+    fuzz_ctx_t ctx = { .rec = r };
+    form_parser_init(&ctx.parser, ctx.key, FUZZ_KEY_SIZE, value_storage(&ctx, 0), value_size_of(0), fuzz_cb, &ctx);
+
+    size_t off = 0;
+    esp_err_t err = ESP_OK;
+    for (int i = 0; i < cut_cnt && err == ESP_OK; i++) {
+        err = form_parser_feed(&ctx.parser, (const char *)body + off, cuts[i] - off);
+        off = cuts[i];
+    }
+    if (err == ESP_OK) err = form_parser_feed(&ctx.parser, (const char *)body + off, len - off);
+    //once failed every later call must keep returning the same error
+    esp_err_t fin = form_parser_finish(&ctx.parser);
+    if (err != ESP_OK && fin != err) fuzz_fail("error not sticky");
+    r->err = fin;
+}
+
+/*================= REFERENCE =================*/
+static int ref_hex(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* decode one pair (the bytes between two separators), ESP_OK and the pair recorded when it is well formed */
+static esp_err_t ref_pair(record_t *r, const uint8_t *p, size_t len) {
+    char key[FUZZ_KEY_SIZE], value[FUZZ_VALUE_SIZE_ODD];
+    size_t key_len = 0, value_len = 0;
+    size_t value_size = value_size_of(r->pairs);
+    int in_value = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = p[i];
+        if (c == '\r') continue;
+        if (c == '=' && !in_value) {
+            in_value = 1;
+            continue;
+        }
+        if (c == '%') {
+            //both digits must be in this pair, '\r' is not skipped inside an escape
+            if (i + 2 >= len) return ESP_ERR_INVALID_ARG;
+            int hi = ref_hex(p[i + 1]), lo = ref_hex(p[i + 2]);
+            if (hi < 0 || lo < 0) return ESP_ERR_INVALID_ARG;
+            c = (uint8_t)(hi << 4 | lo);
+            i += 2;
+        } else if (c == '+') {
+            c = ' ';
+        }
+
+        if (in_value) {
+            if (value_len + 1 >= value_size) return ESP_ERR_INVALID_SIZE;
+            value[value_len++] = (char)c;
+        } else {
+            if (key_len + 1 >= FUZZ_KEY_SIZE) return ESP_ERR_INVALID_SIZE;
+            key[key_len++] = (char)c;
+        }
+    }
+
+    //empty pairs ("a=1&&b=2") are skipped, "=" alone is an empty key with an empty value
+    if (key_len == 0 && !in_value) return ESP_OK;
+    record_pair(r, key, key_len, value, value_len);
+    if (r->pairs++ == r->stop_after) return FUZZ_STOP_ERR;
+    return ESP_OK;
+}
+
+static void parse_ref(record_t *r, const uint8_t *body, size_t len) {
+    size_t start = 0;
+    for (size_t i = 0; i <= len; i++) {
+        if (i < len && body[i] != '&' && body[i] != '\n') continue;
+        r->err = ref_pair(r, body + start, i - start);
+        if (r->err != ESP_OK) return;
+        start = i + 1;
+    }
+}
+
+/*================= TARGET =================*/
+static void expect_same(const record_t *a, const record_t *b, const char *what) {
+    if (a->err == b->err && a->pairs == b->pairs && a->len == b->len &&
+        (a->len == 0 || memcmp(a->buf, b->buf, a->len) == 0)) return;
+    fprintf(stderr, "form_parser_fuzz: %s differs: err %d/%d pairs %d/%d\n", what, a->err, b->err, a->pairs,
+            b->pairs);
+    abort();
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static record_t whole, bytes, chunks, ref;
+    if (size == 0) return 0;
+
+    //the control byte: low 3 bits stop after that pair (7 never), the rest seeds the cuts
+    uint8_t ctl = data[0];
+    int stop_after = (ctl & 7) == 7 ? -1 : (ctl & 7);
+    const uint8_t *body = data + 1;
+    size_t len = size - 1;
+
+    record_reset(&whole, stop_after);
+    parse_chunked(&whole, body, len, NULL, 0);
+
+    //a feed per byte, so every pair and every escape spans chunks
+    size_t *cuts = malloc((len + 1) * sizeof(size_t));
+    if (cuts == NULL) abort();
+    for (size_t i = 0; i < len; i++) cuts[i] = i;
+    record_reset(&bytes, stop_after);
+    parse_chunked(&bytes, body, len, cuts, (int)len);
+
+    //random cut points, a xorshift seeded by the control byte keeps a crash reproducible from its input alone
+    uint32_t x = 0x9e3779b9u ^ ctl;
+    int cut_cnt = 0;
+    for (size_t off = 0; off < len;) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        off += 1 + x % 9;
+        if (off < len) cuts[cut_cnt++] = off;
+    }
+    record_reset(&chunks, stop_after);
+    parse_chunked(&chunks, body, len, cuts, cut_cnt);
+    free(cuts);
+
+    record_reset(&ref, stop_after);
+    parse_ref(&ref, body, len);
+
+    expect_same(&whole, &ref, "whole feed vs reference");
+    expect_same(&whole, &bytes, "whole feed vs byte feeds");
+    expect_same(&whole, &chunks, "whole feed vs random chunks");
+    return 0;
+}
+
+#ifndef FORM_PARSER_FUZZ_LIBFUZZER
+static int run_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return 1;
+    }
+    uint8_t *data = NULL;
+    size_t len = 0, size = 0, n;
+    do {
+        if (len == size) {
+            size = size ? size * 2 : 4096;
+            data = realloc(data, size);
+            if (data == NULL) abort();
+        }
+        n = fread(data + len, 1, size - len, f);
+        len += n;
+    } while (n > 0);
+    fclose(f);
+
+    LLVMFuzzerTestOneInput(data, len);
+    free(data);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    //separators, escapes and plain bytes, weighted so most bodies are almost valid
+    static const char alphabet[] = "&&==%%++\r\n0aF9gZ kv";
+    long iters = DEFAULT_ITERS;
+    unsigned int seed = 1;
+    int c;
+    while ((c = getopt(argc, argv, "n:s:")) != -1) {
+        switch (c) {
+        case 'n': iters = atol(optarg); break;
+        case 's': seed = (unsigned int)atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n iters] [-s seed] [files...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind < argc) {
+        int failed = 0;
+        for (int i = optind; i < argc; i++) failed |= run_file(argv[i]);
+        printf("%d files ok\n", argc - optind);
+        return failed;
+    }
+
+    srand(seed);
+    uint8_t data[MAX_BODY + 1];
+    for (long it = 0; it < iters; it++) {
+        size_t len = 1 + rand() % (MAX_BODY + 1);
+        data[0] = (uint8_t)rand();
+        for (size_t i = 1; i < len; i++) {
+            //one byte in 16 is anything at all
+            data[i] = (rand() & 15) ? (uint8_t)alphabet[rand() % (sizeof(alphabet) - 1)] : (uint8_t)rand();
+        }
+        LLVMFuzzerTestOneInput(data, len);
+    }
+    printf("%ld random bodies ok, seed %u\n", iters, seed);
+    return 0;
+}
+#endif
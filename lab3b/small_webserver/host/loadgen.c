@@ -0,0 +1,652 @@
+/*
+http load generator for the server, reports requests/s, latency percentiles and memory per connection.
+
+build: host/build.sh (or gcc -O2 -Wall -pthread -o loadgen host/loadgen.c)
+usage: ./loadgen [-h host] [-p port] [-c conns] [-d seconds] [-m mix] [-b cmds] [-w cmds] [-s slow] [-q depth]
+                 [-r rate] [-P server_pid]
+
+- every connection is a keep-alive client on its own thread that sends one request, waits for the whole response,
+then sends the next (closed loop), so req/s is bounded by the server and not by a send rate.
+- mix weights the request kinds, default "get=4,toggle=1,str=1,api=2":
+get is GET /, toggle and str are form POSTs to /, api is GET /api/led.
+- with -b every toggle or str request is instead one POST /batch of cmds pairs, each drawn from the toggle:str
+weights. cmds/s counts the cmds the server accepted: one per 200 of a single POST, accepted= of a batch reply.
+admission control allows 20 cmds/s, measure against host/build/small_webserver_noadmit.
+- with -w every connection upgrades to /ws and sends cmds frames ('T', or 'S' and a string, drawn from the
+toggle:str weights) followed by a ping. the server handles a connection's frames in order, so its pong comes after
+the 'B' (busy) replies of those cmds: accepted is cmds minus the 'B's, a response is one such round. 'L' pushes
+after a toggle are read and ignored.
+- bytes sent and received on the sockets, http or websocket headers included, are reported per accepted cmd. run
+-m toggle=1,str=1 to compare POST /, POST /batch and /ws on the cmds alone.
+- with -P the server's VmRSS is read before connecting, once all connections are open and after the run,
+the per connection figure is the difference over -c. socket buffers live in the kernel and are not part of it,
+and like esp-idf the port allocates every session in httpd_start, so 0 means a connection costs no heap on top.
+- with -s the first slow connections are slow readers: each sends depth GET / requests at once (pipelined) and
+reads the responses at rate bytes/s through a small receive buffer, default 16 requests at 8192 B/s, so the
+server's socket buffer for them fills up like for a phone on weak wifi. fast and slow connections are reported
+apart, the fast figures are what the slow readers cost everyone else. latency of a slow response counts from
+the send of its burst.
+- a connection the server closes (lru purge, error response) is counted and reopened.
+- the default of 5 connections is WIFI_MAX_CONN, more than max_open_sockets (7) only measures purging.
+*/
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RESP_BUF_SIZE       4096
+#define STATUS_MAX          600
+#define MIX_MAX             4
+#define BATCH_MAX           64
+#define BODY_KEEP           128     //start of the response body kept to read the batch counts
+#define DEPTH_MAX           64
+#define SLOW_CHUNK          256     //a slow reader takes this much per recv
+#define SLOW_RCVBUF         2048    //the kernel doubles it and rounds up to its minimum
+#define WS_OP_TEXT          0x1
+#define WS_OP_PING          0x9
+#define WS_OP_PONG          0xA
+#define WS_CMD_MAX          40      //masked frame of one cmd
+
+typedef enum {
+    REQ_GET,
+    REQ_TOGGLE,
+    REQ_STR,
+    REQ_API,
+} req_kind_t;
+
+static const char *mix_names[MIX_MAX] = { "get", "toggle", "str", "api" };
+
+typedef struct {
+    const char *host;
+    int port;
+    int conns;
+    int seconds;
+    int mix[MIX_MAX];
+    int batch;          //cmds per POST /batch, 0 posts them one by one
+    int ws;             //cmds per websocket round, 0 for http
+    int slow;           //slow reader connections, the first ones
+    int depth;          //requests a slow reader pipelines
+    int rate;           //bytes/s a slow reader reads
+    int pid;
+} opts_t;
+
+typedef struct {
+    int id;
+    int fd;
+    bool slow;
+    bool upgraded;          //the connection talks websocket
+    uint64_t *lat_ns;
+    size_t lat_cnt;
+    size_t lat_cap;
+    uint64_t status[STATUS_MAX];
+    uint64_t errors;
+    uint64_t reconnects;
+    uint64_t cmds;          //accepted by the server
+    uint64_t cmds_dropped;  //refused because the bus was full
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;
+    char body[BODY_KEEP];
+    size_t body_len;
+    size_t buf_len;
+    char buf[RESP_BUF_SIZE];
+} conn_t;
+
+static opts_t opts;
+static struct sockaddr_in server_addr;
+static pthread_barrier_t connected;
+static pthread_barrier_t measured;
+static volatile bool running = true;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static long rss_kb(int pid) {
+    char path[64], line[128];
+    long kb = -1;
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) return -1;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (sscanf(line, "VmRSS: %ld kB", &kb) == 1) break;
+    }
+    fclose(f);
+    return kb;
+}
+
+static int parse_mix(const char *s, int *mix) {
+    memset(mix, 0, sizeof(int) * MIX_MAX);
+    char *copy = strdup(s), *save = NULL;
+    for (char *tok = strtok_r(copy, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+        char *eq = strchr(tok, '=');
+        int i;
+        if (eq == NULL) break;
+        *eq = '\0';
+        for (i = 0; i < MIX_MAX && strcmp(tok, mix_names[i]) != 0; i++) {}
+        if (i == MIX_MAX) {
+            free(copy);
+            return -1;
+        }
+        mix[i] = atoi(eq + 1);
+    }
+    free(copy);
+    int total = 0;
+    for (int i = 0; i < MIX_MAX; i++) total += mix[i];
+    return (total > 0) ? 0 : -1;
+}
+
+static int parse_opts(int argc, char **argv, opts_t *o) {
+    int c;
+    *o = (opts_t){ .host = "192.168.4.1", .port = 80, .conns = 5, .seconds = 10, .depth = 16, .rate = 8192,
+                   .pid = 0 };
+    parse_mix("get=4,toggle=1,str=1,api=2", o->mix);
+
+    while ((c = getopt(argc, argv, "h:p:c:d:m:b:w:s:q:r:P:")) != -1) {
+        switch (c) {
+        case 'h': o->host = optarg; break;
+        case 'p': o->port = atoi(optarg); break;
+        case 'c': o->conns = atoi(optarg); break;
+        case 'd': o->seconds = atoi(optarg); break;
+        case 'm': if (parse_mix(optarg, o->mix) != 0) return -1; break;
+        case 'b': o->batch = atoi(optarg); break;
+        case 'w': o->ws = atoi(optarg); break;
+        case 's': o->slow = atoi(optarg); break;
+        case 'q': o->depth = atoi(optarg); break;
+        case 'r': o->rate = atoi(optarg); break;
+        case 'P': o->pid = atoi(optarg); break;
+        default: return -1;
+        }
+    }
+    if (o->batch < 0 || o->batch > BATCH_MAX || o->ws < 0 || o->ws > BATCH_MAX) return -1;
+    if (o->batch > 0 && o->ws > 0) return -1;
+    //a batch or a websocket round draws its cmds from the toggle:str weights
+    if ((o->batch > 0 || o->ws > 0) && o->mix[REQ_TOGGLE] + o->mix[REQ_STR] == 0) return -1;
+    if (o->slow < 0 || o->slow > o->conns || o->depth < 1 || o->depth > DEPTH_MAX || o->rate <= 0) return -1;
+    return (o->conns > 0 && o->seconds > 0) ? 0 : -1;
+}
+
+/*================= CONNECTION =================*/
+static int conn_open(conn_t *c) {
+    c->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (c->fd < 0) return -1;
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct timeval tv = { .tv_sec = 5 };
+    setsockopt(c->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (c->slow) {
+        //before connect, the window is announced in the handshake
+        int rcvbuf = SLOW_RCVBUF;
+        setsockopt(c->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    if (connect(c->fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) != 0) {
+        close(c->fd);
+        c->fd = -1;
+        return -1;
+    }
+    c->buf_len = 0;
+    c->upgraded = false;
+    return 0;
+}
+
+static void conn_reopen(conn_t *c) {
+    if (c->fd >= 0) close(c->fd);
+    c->reconnects++;
+    while (running && conn_open(c) != 0) usleep(10000);
+}
+
+/* 0 once all of buf is out */
+static int conn_send(conn_t *c, const void *buf, int len) {
+    if (send(c->fd, buf, len, MSG_NOSIGNAL) != len) return -1;
+    c->tx_bytes += len;
+    return 0;
+}
+
+static int pair_fmt(char *buf, size_t size, req_kind_t kind, conn_t *c, uint64_t n) {
+    if (kind == REQ_TOGGLE) return snprintf(buf, size, "toggle=toggleled");
+    return snprintf(buf, size, "str=c%d+n%llu", c->id, (unsigned long long)n);
+}
+
+/* opts.batch pairs separated by '&', n numbers the str values */
+static int batch_fmt(char *buf, size_t size, conn_t *c, uint64_t n, unsigned int *seed) {
+    int toggle = opts.mix[REQ_TOGGLE], total = toggle + opts.mix[REQ_STR];
+    int len = 0;
+    for (int i = 0; i < opts.batch; i++) {
+        req_kind_t kind = ((int)(rand_r(seed) % total) < toggle) ? REQ_TOGGLE : REQ_STR;
+        if (i > 0) buf[len++] = '&';
+        len += pair_fmt(buf + len, size - len, kind, c, n * opts.batch + i);
+    }
+    return len;
+}
+
+static int req_fmt(char *buf, size_t size, req_kind_t kind, conn_t *c, uint64_t n, unsigned int *seed) {
+    char body[BATCH_MAX * 32];
+    int body_len;
+
+    switch (kind) {
+    case REQ_GET:
+        return snprintf(buf, size, "GET / HTTP/1.1\r\nHost: %s\r\n\r\n", opts.host);
+    case REQ_API:
+        return snprintf(buf, size, "GET /api/led HTTP/1.1\r\nHost: %s\r\n\r\n", opts.host);
+    default:
+        break;
+    }
+
+    if (opts.batch > 0) {
+        body_len = batch_fmt(body, sizeof(body), c, n, seed);
+        return snprintf(buf, size, "POST /batch HTTP/1.1\r\nHost: %s\r\n"
+                        "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: %d\r\n\r\n%s",
+                        opts.host, body_len, body);
+    }
+    body_len = pair_fmt(body, sizeof(body), kind, c, n);
+    return snprintf(buf, size, "POST / HTTP/1.1\r\nHost: %s\r\nContent-Type: application/x-www-form-urlencoded\r\n"
+                    "Content-Length: %d\r\n\r\n%s", opts.host, body_len, body);
+}
+
+/* reads until buf holds at least want bytes, 0 on close or error. a slow reader is paced to opts.rate */
+static int conn_fill(conn_t *c, size_t want) {
+    while (c->buf_len < want) {
+        if (c->buf_len == sizeof(c->buf)) return 0;
+        size_t room = sizeof(c->buf) - c->buf_len;
+        if (c->slow && room > SLOW_CHUNK) room = SLOW_CHUNK;
+        ssize_t ret = recv(c->fd, c->buf + c->buf_len, room, 0);
+        if (ret <= 0) return 0;
+        c->buf_len += ret;
+        c->rx_bytes += ret;
+        if (c->slow) usleep((useconds_t)(ret * 1000000LL / opts.rate));
+    }
+    return 1;
+}
+
+/* keep the first BODY_KEEP bytes of the body before they are consumed */
+static void body_keep(conn_t *c, size_t n) {
+    size_t keep = sizeof(c->body) - 1 - c->body_len;
+    if (n < keep) keep = n;
+    memcpy(c->body + c->body_len, c->buf, keep);
+    c->body_len += keep;
+    c->body[c->body_len] = '\0';
+}
+
+static void conn_consume(conn_t *c, size_t n) {
+    memmove(c->buf, c->buf + n, c->buf_len - n);
+    c->buf_len -= n;
+}
+
+/* one whole response, Content-Length or chunked. returns the status code, -1 when the connection broke */
+static int resp_read(conn_t *c) {
+    char *hdr_end;
+    while ((hdr_end = memmem(c->buf, c->buf_len, "\r\n\r\n", 4)) == NULL) {
+        if (!conn_fill(c, c->buf_len + 1)) return -1;
+    }
+    *hdr_end = '\0';
+
+    int status = 0;
+    long content_len = -1;
+    bool chunked = false;
+    sscanf(c->buf, "HTTP/1.%*d %d", &status);
+    for (char *line = strstr(c->buf, "\r\n"); line != NULL; line = strstr(line + 2, "\r\n")) {
+        if (strncasecmp(line + 2, "Content-Length:", 15) == 0) content_len = atol(line + 17);
+        if (strncasecmp(line + 2, "Transfer-Encoding: chunked", 26) == 0) chunked = true;
+    }
+    conn_consume(c, hdr_end + 4 - c->buf);
+    c->body_len = 0;
+    c->body[0] = '\0';
+
+    if (!chunked) {
+        //a body without length runs to the close, that is the end of this connection
+        if (content_len < 0) return -1;
+        while (content_len > 0) {
+            if (!conn_fill(c, 1)) return -1;
+            size_t n = ((size_t)content_len < c->buf_len) ? (size_t)content_len : c->buf_len;
+            body_keep(c, n);
+            conn_consume(c, n);
+            content_len -= n;
+        }
+        return status;
+    }
+
+    for (;;) {
+        char *eol;
+        while ((eol = memmem(c->buf, c->buf_len, "\r\n", 2)) == NULL) {
+            if (!conn_fill(c, c->buf_len + 1)) return -1;
+        }
+        long chunk = strtol(c->buf, NULL, 16);
+        conn_consume(c, eol + 2 - c->buf);
+        //chunk data and its trailing crlf
+        long left = chunk + 2;
+        while (left > 0) {
+            if (!conn_fill(c, 1)) return -1;
+            size_t n = ((size_t)left < c->buf_len) ? (size_t)left : c->buf_len;
+            //the crlf after the data is kept too, nothing reads past the batch counts
+            body_keep(c, n);
+            conn_consume(c, n);
+            left -= n;
+        }
+        if (chunk == 0) return status;
+    }
+}
+
+static void lat_add(conn_t *c, uint64_t ns) {
+    if (c->lat_cnt == c->lat_cap) {
+        c->lat_cap = c->lat_cap ? c->lat_cap * 2 : 4096;
+        c->lat_ns = realloc(c->lat_ns, c->lat_cap * sizeof(uint64_t));
+    }
+    c->lat_ns[c->lat_cnt++] = ns;
+}
+
+/* count the cmds a toggle/str request got through */
+static void cmds_count(conn_t *c, int status) {
+    int accepted, dropped;
+    if (opts.batch > 0) {
+        if (status == 200 && sscanf(c->body, "accepted=%d dropped=%d", &accepted, &dropped) == 2) {
+            c->cmds += accepted;
+            c->cmds_dropped += dropped;
+        } else if (status == 503) {
+            c->cmds_dropped += opts.batch;
+        }
+    } else if (status == 200) {
+        c->cmds++;
+    } else if (status == 503) {
+        c->cmds_dropped++;
+    }
+}
+
+/* depth pipelined GET / per burst, all responses read before the next burst */
+static void slow_loop(conn_t *c) {
+    char req[DEPTH_MAX * 64];
+    int len = 0;
+    for (int i = 0; i < opts.depth; i++) len += req_fmt(req + len, sizeof(req) - len, REQ_GET, c, 0, NULL);
+
+    while (running) {
+        uint64_t start = now_ns();
+        if (conn_send(c, req, len) != 0) {
+            c->errors++;
+            conn_reopen(c);
+            continue;
+        }
+        for (int i = 0; i < opts.depth; i++) {
+            int status = resp_read(c);
+            if (status < 0) {
+                c->errors++;
+                conn_reopen(c);
+                break;
+            }
+            lat_add(c, now_ns() - start);
+            c->status[(status > 0 && status < STATUS_MAX) ? status : 0]++;
+        }
+    }
+}
+
+/*================= WEBSOCKET =================*/
+/* GET /ws with the upgrade headers, 0 when the server switched protocols */
+static int ws_upgrade(conn_t *c) {
+    char req[256];
+    char *hdr_end;
+    int status = 0;
+
+    int len = snprintf(req, sizeof(req), "GET /ws HTTP/1.1\r\nHost: %s\r\nUpgrade: websocket\r\n"
+                       "Connection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                       "Sec-WebSocket-Version: 13\r\n\r\n", opts.host);
+    if (conn_send(c, req, len) != 0) return -1;
+    while ((hdr_end = memmem(c->buf, c->buf_len, "\r\n\r\n", 4)) == NULL) {
+        if (!conn_fill(c, c->buf_len + 1)) return -1;
+    }
+    sscanf(c->buf, "HTTP/1.%*d %d", &status);
+    conn_consume(c, hdr_end + 4 - c->buf);
+    c->upgraded = status == 101;
+    return c->upgraded ? 0 : -1;
+}
+
+/* a final client frame, masked as the protocol wants. payload shorter than 126 bytes */
+static int ws_frame_fmt(uint8_t *out, uint8_t op, const char *payload, size_t len) {
+    static const uint8_t mask[4] = { 0x5a, 0xc3, 0x17, 0x8e };
+    out[0] = 0x80 | op;
+    out[1] = 0x80 | (uint8_t)len;
+    memcpy(out + 2, mask, sizeof(mask));
+    for (size_t i = 0; i < len; i++) out[6 + i] = payload[i] ^ mask[i % 4];
+    return 6 + (int)len;
+}
+
+/* one server frame, returns its opcode and the first payload byte in first (0 if empty), -1 on error */
+static int ws_frame_read(conn_t *c, int *first) {
+    if (!conn_fill(c, 2)) return -1;
+    int op = c->buf[0] & 0x0f;
+    uint64_t len = c->buf[1] & 0x7f;
+    size_t hdr = 2;
+    if (len == 126) hdr = 4;
+    if (len == 127) hdr = 10;
+    if (!conn_fill(c, hdr)) return -1;
+    if (len >= 126) {
+        len = 0;
+        for (size_t i = 2; i < hdr; i++) len = len << 8 | (uint8_t)c->buf[i];
+    }
+    conn_consume(c, hdr);
+
+    *first = 0;
+    while (len > 0) {
+        if (!conn_fill(c, 1)) return -1;
+        size_t n = (len < c->buf_len) ? (size_t)len : c->buf_len;
+        if (*first == 0) *first = (uint8_t)c->buf[0];
+        conn_consume(c, n);
+        len -= n;
+    }
+    return op;
+}
+
+/* opts.ws cmd frames and a ping per round, the round ends with the pong */
+static void ws_loop(conn_t *c, unsigned int *seed) {
+    int toggle = opts.mix[REQ_TOGGLE], total = toggle + opts.mix[REQ_STR];
+    uint8_t out[(BATCH_MAX + 1) * WS_CMD_MAX];
+    char str[WS_CMD_MAX];
+
+    for (uint64_t n = 0; running; n++) {
+        if (!c->upgraded && ws_upgrade(c) != 0) {
+            c->errors++;
+            conn_reopen(c);
+            continue;
+        }
+
+        int len = 0;
+        for (int i = 0; i < opts.ws; i++) {
+            if ((int)(rand_r(seed) % total) < toggle) {
+                len += ws_frame_fmt(out + len, WS_OP_TEXT, "T", 1);
+            } else {
+                int str_len = snprintf(str, sizeof(str), "Sc%d n%llu", c->id, (unsigned long long)(n * opts.ws + i));
+                len += ws_frame_fmt(out + len, WS_OP_TEXT, str, str_len);
+            }
+        }
+        len += ws_frame_fmt(out + len, WS_OP_PING, NULL, 0);
+
+        uint64_t start = now_ns();
+        int op = -1, first, busy = 0;
+        if (conn_send(c, out, len) == 0) {
+            while ((op = ws_frame_read(c, &first)) >= 0 && op != WS_OP_PONG) {
+                if (op == WS_OP_TEXT && first == 'B') busy++;
+            }
+        }
+        if (op < 0) {
+            c->errors++;
+            conn_reopen(c);
+            continue;
+        }
+        lat_add(c, now_ns() - start);
+        c->cmds += opts.ws - busy;
+        c->cmds_dropped += busy;
+    }
+}
+
+static void *conn_thread(void *arg) {
+    conn_t *c = arg;
+    unsigned int seed = (unsigned int)now_ns() ^ (c->id * 2654435761u);
+    int total = 0;
+    char req[BATCH_MAX * 32 + 256];
+
+    for (int i = 0; i < MIX_MAX; i++) total += opts.mix[i];
+
+    if (conn_open(c) != 0) c->errors++;
+    pthread_barrier_wait(&connected);
+    pthread_barrier_wait(&measured);
+    if (c->fd < 0) conn_reopen(c);
+
+    if (c->slow) {
+        slow_loop(c);
+        close(c->fd);
+        return NULL;
+    }
+    if (opts.ws > 0) {
+        ws_loop(c, &seed);
+        close(c->fd);
+        return NULL;
+    }
+    for (uint64_t n = 0; running; n++) {
+        int r = rand_r(&seed) % total;
+        req_kind_t kind = REQ_GET;
+        while (r >= opts.mix[kind]) r -= opts.mix[kind++];
+
+        int len = req_fmt(req, sizeof(req), kind, c, n, &seed);
+        uint64_t start = now_ns();
+        if (conn_send(c, req, len) != 0) {
+            c->errors++;
+            conn_reopen(c);
+            continue;
+        }
+        int status = resp_read(c);
+        if (status < 0) {
+            c->errors++;
+            conn_reopen(c);
+            continue;
+        }
+        lat_add(c, now_ns() - start);
+        c->status[(status > 0 && status < STATUS_MAX) ? status : 0]++;
+        if (kind == REQ_TOGGLE || kind == REQ_STR) cmds_count(c, status);
+    }
+    close(c->fd);
+    return NULL;
+}
+
+/*================= REPORT =================*/
+static uint64_t pct(const uint64_t *v, size_t n, double p) {
+    if (n == 0) return 0;
+    size_t i = (size_t)(p * (n - 1));
+    return v[i];
+}
+
+/* conns [from, to) */
+static void report_group(const char *name, conn_t *conns, int from, int to, double secs) {
+    size_t n = 0;
+    uint64_t status[STATUS_MAX] = { 0 }, errors = 0, reconnects = 0, cmds = 0, cmds_dropped = 0;
+    uint64_t tx_bytes = 0, rx_bytes = 0;
+
+    for (int i = from; i < to; i++) {
+        n += conns[i].lat_cnt;
+        tx_bytes += conns[i].tx_bytes;
+        rx_bytes += conns[i].rx_bytes;
+        cmds += conns[i].cmds;
+        cmds_dropped += conns[i].cmds_dropped;
+        errors += conns[i].errors;
+        reconnects += conns[i].reconnects;
+        for (int s = 0; s < STATUS_MAX; s++) status[s] += conns[i].status[s];
+    }
+    uint64_t *all = malloc((n ? n : 1) * sizeof(uint64_t));
+    size_t k = 0;
+    for (int i = from; i < to; i++) {
+        memcpy(&all[k], conns[i].lat_ns, conns[i].lat_cnt * sizeof(uint64_t));
+        k += conns[i].lat_cnt;
+    }
+    qsort(all, n, sizeof(uint64_t), cmp_u64);
+
+    printf("%sconns %d, %.1f s, %zu responses, %.1f req/s\n", name, to - from, secs, n, n / secs);
+    printf("latency us: p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n", pct(all, n, 0.50) / 1e3,
+           pct(all, n, 0.90) / 1e3, pct(all, n, 0.99) / 1e3, (n ? all[n - 1] : 0) / 1e3);
+    printf("status:");
+    for (int s = 0; s < STATUS_MAX; s++) {
+        if (status[s] != 0) printf(" %d=%llu", s, (unsigned long long)status[s]);
+    }
+    printf("\nerrors %llu, reconnects %llu\n", (unsigned long long)errors, (unsigned long long)reconnects);
+    //slow readers only GET /
+    if (from >= opts.slow && opts.mix[REQ_TOGGLE] + opts.mix[REQ_STR] > 0) {
+        printf("cmds: %llu accepted, %.1f cmds/s, %llu dropped (bus full), %s\n", (unsigned long long)cmds,
+               cmds / secs, (unsigned long long)cmds_dropped,
+               opts.ws > 0 ? "websocket" : opts.batch > 0 ? "batched" : "one per POST");
+        if (cmds > 0) {
+            printf("bytes per accepted cmd: %.1f sent, %.1f received\n", (double)tx_bytes / cmds,
+                   (double)rx_bytes / cmds);
+        }
+    }
+    free(all);
+}
+
+static void report(conn_t *conns, double secs, long rss_base, long rss_conn, long rss_end) {
+    if (opts.slow == 0) {
+        report_group("", conns, 0, opts.conns, secs);
+    } else {
+        if (opts.slow < opts.conns) report_group("fast ", conns, opts.slow, opts.conns, secs);
+        report_group("slow ", conns, 0, opts.slow, secs);
+    }
+    if (rss_base > 0) {
+        printf("server rss: %ld kB idle, %ld kB connected, %ld kB after load, %.0f B per connection\n",
+               rss_base, rss_conn, rss_end, (rss_conn - rss_base) * 1024.0 / opts.conns);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (parse_opts(argc, argv, &opts) != 0) {
+        fprintf(stderr, "usage: %s [-h host] [-p port] [-c conns] [-d seconds] [-m get=4,toggle=1,str=1,api=2] "
+                "[-b cmds] [-w cmds] [-s slow] [-q depth] [-r bytes/s] [-P server_pid]\n", argv[0]);
+        return 1;
+    }
+
+    struct hostent *he = gethostbyname(opts.host);
+    if (he == NULL) {
+        fprintf(stderr, "unknown host %s\n", opts.host);
+        return 1;
+    }
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(opts.port);
+    memcpy(&server_addr.sin_addr, he->h_addr_list[0], sizeof(server_addr.sin_addr));
+
+    conn_t *conns = calloc(opts.conns, sizeof(conn_t));
+    pthread_t *threads = calloc(opts.conns, sizeof(pthread_t));
+    pthread_barrier_init(&connected, NULL, opts.conns + 1);
+    pthread_barrier_init(&measured, NULL, opts.conns + 1);
+
+    long rss_base = opts.pid ? rss_kb(opts.pid) : -1;
+    for (int i = 0; i < opts.conns; i++) {
+        conns[i].id = i;
+        conns[i].fd = -1;
+        conns[i].slow = i < opts.slow;
+        pthread_create(&threads[i], NULL, conn_thread, &conns[i]);
+    }
+
+    //all connections are open and idle here, give the server a moment to accept the last ones
+    pthread_barrier_wait(&connected);
+    usleep(200000);
+    long rss_conn = opts.pid ? rss_kb(opts.pid) : -1;
+    uint64_t start = now_ns();
+    pthread_barrier_wait(&measured);
+
+    sleep(opts.seconds);
+    running = false;
+    double secs = (now_ns() - start) / 1e9;
+    for (int i = 0; i < opts.conns; i++) pthread_join(threads[i], NULL);
+    long rss_end = opts.pid ? rss_kb(opts.pid) : -1;
+
+    report(conns, secs, rss_base, rss_conn, rss_end);
+    return 0;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+/* host port: logs go to stdout in the esp log format, debug logs are compiled out like with the default log level */
+
+void port_log(char level, const char *tag, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+#define ESP_LOGE(tag, fmt, ...) port_log('E', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) port_log('W', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) port_log('I', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) do { if (0) port_log('D', tag, fmt, ##__VA_ARGS__); } while (0)
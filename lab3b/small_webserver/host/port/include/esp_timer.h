@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+/* us since the process started, monotonic */
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+host port of the FreeRTOS subset the firmware uses, on pthreads.
+- a tick is 1 ms, priorities and core affinity are accepted and ignored (the host scheduler decides).
+- critical sections are a mutex per portMUX, so they only exclude each other, not the whole system.
+*/
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t EventBits_t;
+typedef void (*TaskFunction_t)(void *);
+
+typedef struct port_task *TaskHandle_t;
+typedef struct port_queue *QueueHandle_t;
+typedef struct port_event_group *EventGroupHandle_t;
+
+#define pdPASS                  1
+#define pdFAIL                  0
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define portMAX_DELAY           ((TickType_t)0xffffffff)
+#define configTICK_RATE_HZ      1000
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms) * configTICK_RATE_HZ / 1000)
+#define configMAX_PRIORITIES    25
+#define tskIDLE_PRIORITY        0
+#define tskNO_AFFINITY          0x7fffffff
+#define portNUM_PROCESSORS      2
+
+#define BIT0                    0x00000001
+#define BIT1                    0x00000002
+#define BIT2                    0x00000004
+#define BIT3                    0x00000008
+
+typedef struct {
+    pthread_mutex_t lock;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { PTHREAD_MUTEX_INITIALIZER }
+
+#define portENTER_CRITICAL(mux)     pthread_mutex_lock(&(mux)->lock)
+#define portEXIT_CRITICAL(mux)      pthread_mutex_unlock(&(mux)->lock)
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)  portEXIT_CRITICAL(mux)
+
+BaseType_t xPortGetCoreID(void);
+
+#include "freertos/task.h"
+#include "freertos/queue.h"
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+/* the host has no portable cycle counter, this counts nanoseconds instead */
+uint32_t cpu_hal_get_cycle_count(void);
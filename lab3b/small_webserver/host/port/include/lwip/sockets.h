@@ -0,0 +1,7 @@
+#pragma once
+
+/* host port: lwip's bsd socket api is the host's */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
@@ -0,0 +1,147 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "nvs_flash.h"
+#include "hal/cpu_hal.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+
+#define EVENT_HANDLER_MAX       4
+
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT";
+
+typedef struct {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t fn;
+    void *arg;
+} event_handler_t;
+
+static event_handler_t event_handlers[EVENT_HANDLER_MAX];
+static int event_handler_cnt;
+static uint32_t gpio_levels[GPIO_NUM_MAX];
+
+struct esp_netif_obj {
+    esp_netif_ip_info_t ip_info;
+};
+
+static struct esp_netif_obj ap_netif;
+
+/*================= TIME, LOG =================*/
+static uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static uint64_t boot_ns;
+
+__attribute__((constructor)) static void boot_time_init(void) {
+    boot_ns = mono_ns();
+}
+
+int64_t esp_timer_get_time(void) {
+    return (int64_t)((mono_ns() - boot_ns) / 1000u);
+}
+
+uint32_t cpu_hal_get_cycle_count(void) {
+    return (uint32_t)mono_ns();
+}
+
+/* same line format as the esp log, "I (ms) TAG: msg" */
+void port_log(char level, const char *tag, const char *fmt, ...) {
+    char line[256];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    printf("%c (%u) %s: %s\n", level, (unsigned int)(esp_timer_get_time() / 1000), tag, line);
+    fflush(stdout);
+}
+
+/*================= GPIO, NVS =================*/
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode) {
+    return (gpio_num < GPIO_NUM_MAX) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    if (gpio_num >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    gpio_levels[gpio_num] = level;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_init(void) {
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+    return ESP_OK;
+}
+
+/*================= EVENTS =================*/
+esp_err_t esp_event_loop_create_default(void) {
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t event_base, int32_t event_id,
+                                              esp_event_handler_t event_handler, void *event_handler_arg,
+                                              esp_event_handler_instance_t *instance) {
+    if (event_handler_cnt >= EVENT_HANDLER_MAX) return ESP_ERR_NO_MEM;
+    event_handlers[event_handler_cnt++] = (event_handler_t){ event_base, event_id, event_handler, event_handler_arg };
+    if (instance != NULL) *instance = &event_handlers[event_handler_cnt - 1];
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id, void *event_data, size_t event_data_size,
+                         uint32_t ticks_to_wait) {
+    for (int i = 0; i < event_handler_cnt; i++) {
+        event_handler_t *h = &event_handlers[i];
+        if (h->base == event_base && (h->id == ESP_EVENT_ANY_ID || h->id == event_id)) {
+            h->fn(h->arg, event_base, event_id, event_data);
+        }
+    }
+    return ESP_OK;
+}
+
+/*================= NETIF, WIFI =================*/
+esp_err_t esp_netif_init(void) {
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_ap(void) {
+    ap_netif.ip_info.ip.addr = htonl(INADDR_LOOPBACK);
+    ap_netif.ip_info.gw.addr = htonl(INADDR_LOOPBACK);
+    ap_netif.ip_info.netmask.addr = htonl(0xff000000);
+    return &ap_netif;
+}
+
+esp_err_t esp_netif_get_ip_info(esp_netif_t *esp_netif, esp_netif_ip_info_t *ip_info) {
+    if (esp_netif == NULL) return ESP_ERR_INVALID_ARG;
+    *ip_info = esp_netif->ip_info;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config) {
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode) {
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf) {
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void) {
+    return esp_event_post(WIFI_EVENT, WIFI_EVENT_AP_START, NULL, 0, portMAX_DELAY);
+}
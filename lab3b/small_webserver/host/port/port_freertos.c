@@ -0,0 +1,403 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+/*================= TASKS DEF =================*/
+//the firmware stack sizes are tuned for xtensa and a 32 bit libc, every host task gets this instead
+#define PORT_STACK_SIZE         (128 * 1024)
+#define PORT_STACK_PAINT        0xa5    //bytes never touched keep it, uxTaskGetStackHighWaterMark counts them
+
+struct port_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+    char name[16];
+    uint32_t stack_depth;
+    uint8_t *stack;             //lowest address, NULL for threads not created by xTaskCreate
+    uint32_t notify;            //notification value, used as a counting semaphore
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+static __thread struct port_task *cur_task;
+
+/*================= QUEUES DEF =================*/
+struct port_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    UBaseType_t len;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t cnt;
+    uint8_t items[];
+};
+
+struct port_sem {
+    pthread_mutex_t lock;
+};
+
+//a blocked xEventGroupWaitBits / xEventGroupSync, lives on the waiter's stack
+struct port_eg_waiter {
+    EventBits_t bits;
+    bool wait_for_all;
+    bool clear_on_exit;
+    bool met;
+    EventBits_t ret;
+    struct port_eg_waiter *next;
+};
+
+struct port_event_group {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    EventBits_t bits;
+    struct port_eg_waiter *waiters;
+};
+
+/*================= TIME =================*/
+static struct timespec ts_after(clockid_t clock, TickType_t ticks) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    uint64_t ns = (uint64_t)ticks * (1000000000u / configTICK_RATE_HZ) + ts.tv_nsec;
+    ts.tv_sec += ns / 1000000000u;
+    ts.tv_nsec = ns % 1000000000u;
+    return ts;
+}
+
+/* condition variables wait on the monotonic clock, so a wall clock step does not stretch a timeout */
+static void cond_init(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/* false on timeout, portMAX_DELAY waits forever */
+static bool cond_wait(pthread_cond_t *cond, pthread_mutex_t *lock, const struct timespec *deadline) {
+    if (deadline == NULL) return pthread_cond_wait(cond, lock) == 0;
+    return pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)((uint64_t)ts.tv_sec * configTICK_RATE_HZ + ts.tv_nsec / (1000000000u / configTICK_RATE_HZ));
+}
+
+void vTaskDelay(TickType_t ticks) {
+    struct timespec ts = { .tv_sec = ticks / configTICK_RATE_HZ,
+                           .tv_nsec = (ticks % configTICK_RATE_HZ) * (1000000000u / configTICK_RATE_HZ) };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+BaseType_t xPortGetCoreID(void) {
+    int cpu = sched_getcpu();
+    return (cpu < 0) ? 0 : cpu % portNUM_PROCESSORS;
+}
+
+/*================= TASKS =================*/
+static struct port_task *task_new(const char *name, uint32_t stack_depth) {
+    struct port_task *t = calloc(1, sizeof(*t));
+    if (t == NULL) return NULL;
+    strncpy(t->name, name, sizeof(t->name) - 1);
+    t->stack_depth = stack_depth;
+    pthread_mutex_init(&t->lock, NULL);
+    cond_init(&t->cond);
+    return t;
+}
+
+static void *task_entry(void *arg) {
+    cur_task = arg;
+    pthread_setname_np(pthread_self(), cur_task->name);
+    cur_task->fn(cur_task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *handle, BaseType_t core_id) {
+    struct port_task *t = task_new(name, stack_depth);
+    if (t == NULL) return pdFAIL;
+    t->fn = fn;
+    t->arg = arg;
+
+    //painted like freertos does, the stack grows down so the untouched paint is at the low end
+    t->stack = mmap(NULL, PORT_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (t->stack == MAP_FAILED) {
+        free(t);
+        return pdFAIL;
+    }
+    memset(t->stack, PORT_STACK_PAINT, PORT_STACK_SIZE);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstack(&attr, t->stack, PORT_STACK_SIZE);
+    //handle is written before the thread runs, a task may notify itself through it right away
+    if (handle != NULL) *handle = t;
+    int err = pthread_create(&t->thread, &attr, task_entry, t);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        munmap(t->stack, PORT_STACK_SIZE);
+        free(t);
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg, UBaseType_t prio,
+                       TaskHandle_t *handle) {
+    return xTaskCreatePinnedToCore(fn, name, stack_depth, arg, prio, handle, tskNO_AFFINITY);
+}
+
+/* only a task deleting itself is supported, the handle is leaked on purpose as other tasks may still notify it */
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL || task == cur_task) pthread_exit(NULL);
+}
+
+/* threads not created by xTaskCreate (main) get a task on first use */
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    if (cur_task == NULL) cur_task = task_new("main", 0);
+    return cur_task;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    if (task == NULL) task = xTaskGetCurrentTaskHandle();
+    if (task->stack == NULL) return task->stack_depth;
+
+    UBaseType_t free_bytes = 0;
+    while (free_bytes < PORT_STACK_SIZE && task->stack[free_bytes] == PORT_STACK_PAINT) free_bytes++;
+    return free_bytes;
+}
+
+UBaseType_t port_task_stack_size(void) {
+    return PORT_STACK_SIZE;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    struct port_task *t = xTaskGetCurrentTaskHandle();
+    struct timespec deadline = ts_after(CLOCK_MONOTONIC, ticks);
+
+    pthread_mutex_lock(&t->lock);
+    while (t->notify == 0 && ticks != 0) {
+        if (!cond_wait(&t->cond, &t->lock, (ticks == portMAX_DELAY) ? NULL : &deadline)) break;
+    }
+    uint32_t val = t->notify;
+    if (val != 0) t->notify = clear_on_exit ? 0 : val - 1;
+    pthread_mutex_unlock(&t->lock);
+    return val;
+}
+
+/*================= QUEUES =================*/
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item_size) {
+    struct port_queue *q = calloc(1, sizeof(*q) + (size_t)len * item_size);
+    if (q == NULL) return NULL;
+    pthread_mutex_init(&q->lock, NULL);
+    cond_init(&q->not_empty);
+    cond_init(&q->not_full);
+    q->len = len;
+    q->item_size = item_size;
+    return q;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t q, const void *item, TickType_t ticks) {
+    struct timespec deadline = ts_after(CLOCK_MONOTONIC, ticks);
+    BaseType_t ret = pdFAIL;
+
+    pthread_mutex_lock(&q->lock);
+    while (q->cnt == q->len && ticks != 0) {
+        if (!cond_wait(&q->not_full, &q->lock, (ticks == portMAX_DELAY) ? NULL : &deadline)) break;
+    }
+    if (q->cnt < q->len) {
+        memcpy(&q->items[((q->head + q->cnt) % q->len) * q->item_size], item, q->item_size);
+        q->cnt++;
+        pthread_cond_signal(&q->not_empty);
+        ret = pdPASS;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ret;
+}
+
+static BaseType_t queue_read(QueueHandle_t q, void *item, TickType_t ticks, bool remove) {
+    struct timespec deadline = ts_after(CLOCK_MONOTONIC, ticks);
+    BaseType_t ret = pdFALSE;
+
+    pthread_mutex_lock(&q->lock);
+    while (q->cnt == 0 && ticks != 0) {
+        if (!cond_wait(&q->not_empty, &q->lock, (ticks == portMAX_DELAY) ? NULL : &deadline)) break;
+    }
+    if (q->cnt > 0) {
+        memcpy(item, &q->items[q->head * q->item_size], q->item_size);
+        if (remove) {
+            q->head = (q->head + 1) % q->len;
+            q->cnt--;
+            pthread_cond_signal(&q->not_full);
+        } else {
+            //every peeker sees the item, like every task blocked in xQueuePeek is woken
+            pthread_cond_broadcast(&q->not_empty);
+        }
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ret;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks) {
+    return queue_read(q, item, ticks, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t q, void *item, TickType_t ticks) {
+    return queue_read(q, item, ticks, false);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t cnt = q->cnt;
+    pthread_mutex_unlock(&q->lock);
+    return cnt;
+}
+
+/*================= SEMAPHORES =================*/
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    struct port_sem *s = calloc(1, sizeof(*s));
+    if (s == NULL) return NULL;
+    pthread_mutex_init(&s->lock, NULL);
+    return s;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    if (ticks == portMAX_DELAY) return pthread_mutex_lock(&sem->lock) == 0;
+    if (ticks == 0) return pthread_mutex_trylock(&sem->lock) == 0;
+
+    //timed locks only take the realtime clock
+    struct timespec deadline = ts_after(CLOCK_REALTIME, ticks);
+    return pthread_mutex_timedlock(&sem->lock, &deadline) == 0;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    return pthread_mutex_unlock(&sem->lock) == 0;
+}
+
+/*================= EVENT GROUPS =================*/
+EventGroupHandle_t xEventGroupCreate(void) {
+    struct port_event_group *g = calloc(1, sizeof(*g));
+    if (g == NULL) return NULL;
+    pthread_mutex_init(&g->lock, NULL);
+    cond_init(&g->cond);
+    return g;
+}
+
+static bool bits_met(EventBits_t cur, EventBits_t bits, BaseType_t wait_for_all) {
+    return wait_for_all ? (cur & bits) == bits : (cur & bits) != 0;
+}
+
+/*
+like FreeRTOS, every waiter satisfied by the new bits is released first and the clear-on-exit bits of all of them
+are cleared after, so two tasks waiting on the same bit both get it. called with the lock held.
+*/
+static void eg_release(EventGroupHandle_t group) {
+    EventBits_t clear = 0;
+    for (struct port_eg_waiter **w = &group->waiters; *w != NULL;) {
+        if (!bits_met(group->bits, (*w)->bits, (*w)->wait_for_all)) {
+            w = &(*w)->next;
+            continue;
+        }
+        (*w)->met = true;
+        (*w)->ret = group->bits;
+        if ((*w)->clear_on_exit) clear |= (*w)->bits;
+        *w = (*w)->next;
+    }
+    group->bits &= ~clear;
+    pthread_cond_broadcast(&group->cond);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    pthread_mutex_lock(&group->lock);
+    group->bits |= bits;
+    EventBits_t ret = group->bits;
+    eg_release(group);
+    pthread_mutex_unlock(&group->lock);
+    return ret;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    pthread_mutex_lock(&group->lock);
+    EventBits_t ret = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->lock);
+    return ret;
+}
+
+/* block until the waiter is released by eg_release, called with the lock held and the waiter not queued */
+static EventBits_t eg_wait(EventGroupHandle_t group, struct port_eg_waiter *w, TickType_t ticks) {
+    struct timespec deadline = ts_after(CLOCK_MONOTONIC, ticks);
+
+    if (bits_met(group->bits, w->bits, w->wait_for_all)) {
+        EventBits_t ret = group->bits;
+        if (w->clear_on_exit) group->bits &= ~w->bits;
+        return ret;
+    }
+    if (ticks == 0) return group->bits;
+
+    w->next = group->waiters;
+    group->waiters = w;
+    while (!w->met) {
+        if (!cond_wait(&group->cond, &group->lock, (ticks == portMAX_DELAY) ? NULL : &deadline)) break;
+    }
+    if (w->met) return w->ret;
+
+    //timed out, still queued
+    for (struct port_eg_waiter **p = &group->waiters; *p != NULL; p = &(*p)->next) {
+        if (*p == w) {
+            *p = w->next;
+            break;
+        }
+    }
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks) {
+    struct port_eg_waiter w = { .bits = bits, .wait_for_all = wait_for_all, .clear_on_exit = clear_on_exit };
+
+    pthread_mutex_lock(&group->lock);
+    EventBits_t ret = eg_wait(group, &w, ticks);
+    pthread_mutex_unlock(&group->lock);
+    return ret;
+}
+
+EventBits_t xEventGroupSync(EventGroupHandle_t group, EventBits_t bits_to_set, EventBits_t bits_to_wait,
+                            TickType_t ticks) {
+    struct port_eg_waiter w = { .bits = bits_to_wait, .wait_for_all = true, .clear_on_exit = true };
+
+    pthread_mutex_lock(&group->lock);
+    EventBits_t ret = group->bits | bits_to_set;
+    group->bits = ret;
+    eg_release(group);
+    if (bits_met(ret, bits_to_wait, true)) {
+        //this task completed the rendezvous, judged on the bits before the released waiters cleared theirs
+        group->bits &= ~bits_to_wait;
+    } else {
+        ret = eg_wait(group, &w, ticks);
+    }
+    pthread_mutex_unlock(&group->lock);
+    return ret;
+}
@@ -0,0 +1,881 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_http_server.h"
+
+/*================= HTTPD DEF =================*/
+#define RESP_HDR_SIZE           512
+#define RESP_HDR_MAX            8
+#define CHUNK_HDR_SIZE          16
+#define DISCARD_BUF_SIZE        256
+#define SESS_SND_BUF            5744    //CONFIG_LWIP_TCP_SND_BUF_DEFAULT, linux counts twice what is asked for
+#define WS_HDR_MAX              14      //2 bytes, 8 of extended length, 4 of mask
+#define WS_CTRL_MAX             125     //payload limit of a control frame
+#define WS_GUID                 "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+static const char *TAG = "PORT_HTTPD";
+
+uint16_t port_httpd_port_override;
+
+typedef struct {
+    int fd;
+    const httpd_uri_t *ws_uri;  //the websocket uri after the handshake, frames go to its handler. NULL for http
+    uint64_t lru;               //request count of the server when the session was last used
+    size_t buf_len;
+    char buf[PORT_HTTPD_HDR_SIZE];  //received, not yet consumed bytes: a partial header or the next pipelined request
+} sess_t;
+
+/* a queued work item, written to the ctrl pipe in one piece. fn NULL closes the session arg */
+typedef struct {
+    httpd_work_fn_t fn;
+    void *arg;
+} work_t;
+
+typedef struct {
+    httpd_config_t cfg;
+    int listen_fd;
+    int ctrl_rd;
+    int ctrl_wr;
+    httpd_uri_t *uris;
+    int uri_cnt;
+    sess_t *sess;
+    uint64_t req_cnt;
+} server_t;
+
+typedef struct {
+    sess_t *sess;
+    size_t remaining;               //body bytes not read yet
+    const char *status;
+    const char *type;
+    const char *hdr_field[RESP_HDR_MAX];
+    const char *hdr_value[RESP_HDR_MAX];
+    int hdr_cnt;
+    bool chunked;
+    bool close;                     //the client asked for Connection: close
+    bool ws;                        //a websocket frame, remaining is its payload
+    bool ws_fin;
+    uint8_t ws_op;
+    uint8_t ws_mask[4];
+    size_t ws_len;
+    int req_hdr_cnt;
+    char req_hdr[PORT_HTTPD_HDR_SIZE];  //request header lines, each nul terminated
+} req_aux_t;
+
+static const struct {
+    const char *status;
+    const char *msg;
+} err_resp[HTTPD_ERR_CODE_MAX] = {
+    [HTTPD_500_INTERNAL_SERVER_ERROR]       = { "500 Internal Server Error", "Server has encountered an unexpected error" },
+    [HTTPD_501_METHOD_NOT_IMPLEMENTED]      = { "501 Method Not Implemented", "Request method is not supported by server" },
+    [HTTPD_505_VERSION_NOT_SUPPORTED]       = { "505 Version Not Supported", "HTTP version not supported by server" },
+    [HTTPD_400_BAD_REQUEST]                 = { "400 Bad Request", "Bad request syntax" },
+    [HTTPD_401_UNAUTHORIZED]                = { "401 Unauthorized", "No permission -- see authorization schemes" },
+    [HTTPD_403_FORBIDDEN]                   = { "403 Forbidden", "Request forbidden -- authorization will not help" },
+    [HTTPD_404_NOT_FOUND]                   = { "404 Not Found", "Nothing matches the given URI" },
+    [HTTPD_405_METHOD_NOT_ALLOWED]          = { "405 Method Not Allowed", "Specified method is invalid for this resource" },
+    [HTTPD_408_REQ_TIMEOUT]                 = { "408 Request Timeout", "Server closed this connection" },
+    [HTTPD_411_LENGTH_REQUIRED]             = { "411 Length Required", "Chunked encoding not supported" },
+    [HTTPD_414_URI_TOO_LONG]                = { "414 URI Too Long", "URI is too long" },
+    [HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE]    = { "431 Request Header Fields Too Large", "Header fields are too long" },
+};
+
+static const char *method_names[] = {
+    [HTTP_DELETE] = "DELETE",
+    [HTTP_GET] = "GET",
+    [HTTP_HEAD] = "HEAD",
+    [HTTP_POST] = "POST",
+    [HTTP_PUT] = "PUT",
+};
+
+/*================= SOCKET IO =================*/
+static int sock_ret(ssize_t ret) {
+    if (ret >= 0) return (int)ret;
+    if (errno == EAGAIN || errno == EWOULDBLOCK) return HTTPD_SOCK_ERR_TIMEOUT;
+    return HTTPD_SOCK_ERR_FAIL;
+}
+
+int httpd_socket_send(httpd_handle_t hd, int sockfd, const char *buf, size_t buf_len, int flags) {
+    ssize_t ret;
+    do {
+        ret = send(sockfd, buf, buf_len, flags | MSG_NOSIGNAL);
+    } while (ret < 0 && errno == EINTR);
+    return sock_ret(ret);
+}
+
+int httpd_socket_recv(httpd_handle_t hd, int sockfd, char *buf, size_t buf_len, int flags) {
+    ssize_t ret;
+    do {
+        ret = recv(sockfd, buf, buf_len, flags);
+    } while (ret < 0 && errno == EINTR);
+    return sock_ret(ret);
+}
+
+/* header and body leave in one segment, so nagle never holds back the body of a response */
+static esp_err_t send_iov(int fd, struct iovec *iov, int cnt) {
+    struct msghdr msg = { .msg_iov = iov, .msg_iovlen = cnt };
+    while (msg.msg_iovlen > 0) {
+        ssize_t ret = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return ESP_ERR_HTTPD_RESP_SEND;
+        }
+        while (msg.msg_iovlen > 0 && (size_t)ret >= msg.msg_iov->iov_len) {
+            ret -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + ret;
+            msg.msg_iov->iov_len -= ret;
+        }
+    }
+    return ESP_OK;
+}
+
+/*================= REQUEST =================*/
+int httpd_req_to_sockfd(httpd_req_t *r) {
+    req_aux_t *aux = r->aux;
+    return aux->sess->fd;
+}
+
+int httpd_req_recv(httpd_req_t *r, char *buf, size_t buf_len) {
+    req_aux_t *aux = r->aux;
+    sess_t *s = aux->sess;
+
+    if (buf_len > aux->remaining) buf_len = aux->remaining;
+    if (buf_len == 0) return 0;
+
+    //bytes that came in with the header first, the socket is never read past the body
+    if (s->buf_len > 0) {
+        if (buf_len > s->buf_len) buf_len = s->buf_len;
+        memcpy(buf, s->buf, buf_len);
+        memmove(s->buf, s->buf + buf_len, s->buf_len - buf_len);
+        s->buf_len -= buf_len;
+        aux->remaining -= buf_len;
+        return (int)buf_len;
+    }
+
+    int ret = httpd_socket_recv(r->handle, s->fd, buf, buf_len, 0);
+    if (ret > 0) aux->remaining -= ret;
+    return ret;
+}
+
+static const char *req_hdr_find(req_aux_t *aux, const char *field) {
+    size_t field_len = strlen(field);
+    const char *line = aux->req_hdr;
+
+    for (int i = 0; i < aux->req_hdr_cnt; i++, line += strlen(line) + 1) {
+        if (strncasecmp(line, field, field_len) != 0 || line[field_len] != ':') continue;
+        const char *val = line + field_len + 1;
+        while (*val == ' ' || *val == '\t') val++;
+        return val;
+    }
+    return NULL;
+}
+
+/* copies what fits, like esp-idf the result is truncated rather than missing */
+static esp_err_t copy_value(char *dst, size_t dst_size, const char *src, size_t src_len) {
+    if (dst_size == 0) return ESP_ERR_INVALID_ARG;
+    size_t n = (src_len < dst_size) ? src_len : dst_size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+    return (n < src_len) ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field, char *val, size_t val_size) {
+    const char *v = req_hdr_find(r->aux, field);
+    if (v == NULL) return ESP_ERR_NOT_FOUND;
+    return copy_value(val, val_size, v, strlen(v));
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *r, char *buf, size_t buf_len) {
+    const char *q = strchr(r->uri, '?');
+    if (q == NULL) return ESP_ERR_NOT_FOUND;
+    q++;
+    return copy_value(buf, buf_len, q, strcspn(q, "#"));
+}
+
+esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, size_t val_size) {
+    size_t key_len = strlen(key);
+
+    for (const char *p = qry; *p != '\0'; ) {
+        size_t pair_len = strcspn(p, "&");
+        if (pair_len > key_len && strncmp(p, key, key_len) == 0 && p[key_len] == '=') {
+            return copy_value(val, val_size, p + key_len + 1, pair_len - key_len - 1);
+        }
+        p += pair_len;
+        if (*p == '&') p++;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+/*================= RESPONSE =================*/
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status) {
+    ((req_aux_t *)r->aux)->status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type) {
+    ((req_aux_t *)r->aux)->type = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value) {
+    req_aux_t *aux = r->aux;
+    server_t *srv = r->handle;
+    if (aux->hdr_cnt >= RESP_HDR_MAX || aux->hdr_cnt >= srv->cfg.max_resp_headers) return ESP_ERR_HTTPD_RESP_HDR;
+    aux->hdr_field[aux->hdr_cnt] = field;
+    aux->hdr_value[aux->hdr_cnt] = value;
+    aux->hdr_cnt++;
+    return ESP_OK;
+}
+
+/* status line and headers, with Content-Length unless len < 0 (chunked). 0 when they do not fit */
+static int resp_hdr_fmt(req_aux_t *aux, char *hdr, ssize_t len) {
+    int n = snprintf(hdr, RESP_HDR_SIZE, "HTTP/1.1 %s\r\nContent-Type: %s\r\n", aux->status, aux->type);
+    if (len >= 0) {
+        n += snprintf(hdr + n, (n < RESP_HDR_SIZE) ? RESP_HDR_SIZE - n : 0, "Content-Length: %d\r\n", (int)len);
+    } else {
+        n += snprintf(hdr + n, (n < RESP_HDR_SIZE) ? RESP_HDR_SIZE - n : 0, "Transfer-Encoding: chunked\r\n");
+    }
+    for (int i = 0; i < aux->hdr_cnt; i++) {
+        n += snprintf(hdr + n, (n < RESP_HDR_SIZE) ? RESP_HDR_SIZE - n : 0, "%s: %s\r\n",
+                      aux->hdr_field[i], aux->hdr_value[i]);
+    }
+    n += snprintf(hdr + n, (n < RESP_HDR_SIZE) ? RESP_HDR_SIZE - n : 0, "\r\n");
+    return (n < RESP_HDR_SIZE) ? n : 0;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len) {
+    req_aux_t *aux = r->aux;
+    char hdr[RESP_HDR_SIZE];
+
+    if (buf == NULL) buf_len = 0;
+    if (buf_len == HTTPD_RESP_USE_STRLEN) buf_len = strlen(buf);
+
+    int hdr_len = resp_hdr_fmt(aux, hdr, buf_len);
+    if (hdr_len == 0) return ESP_ERR_HTTPD_RESP_HDR;
+
+    struct iovec iov[2] = { { hdr, hdr_len }, { (void *)buf, buf_len } };
+    return send_iov(aux->sess->fd, iov, (buf_len > 0) ? 2 : 1);
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len) {
+    req_aux_t *aux = r->aux;
+    char hdr[RESP_HDR_SIZE];
+    char chunk_hdr[CHUNK_HDR_SIZE];
+    struct iovec iov[4];
+    int cnt = 0;
+
+    if (buf == NULL) buf_len = 0;
+    if (buf_len == HTTPD_RESP_USE_STRLEN) buf_len = strlen(buf);
+
+    if (!aux->chunked) {
+        int hdr_len = resp_hdr_fmt(aux, hdr, -1);
+        if (hdr_len == 0) return ESP_ERR_HTTPD_RESP_HDR;
+        iov[cnt++] = (struct iovec){ hdr, hdr_len };
+        aux->chunked = true;
+    }
+
+    //a 0 length chunk ends the response
+    int chunk_hdr_len = snprintf(chunk_hdr, sizeof(chunk_hdr), "%x\r\n", (unsigned int)buf_len);
+    iov[cnt++] = (struct iovec){ chunk_hdr, chunk_hdr_len };
+    if (buf_len > 0) iov[cnt++] = (struct iovec){ (void *)buf, buf_len };
+    iov[cnt++] = (struct iovec){ "\r\n", 2 };
+    return send_iov(aux->sess->fd, iov, cnt);
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *msg) {
+    if (error >= HTTPD_ERR_CODE_MAX) return ESP_ERR_INVALID_ARG;
+
+    req_aux_t *aux = req->aux;
+    aux->status = err_resp[error].status;
+    aux->type = HTTPD_TYPE_TEXT;
+    return httpd_resp_send(req, (msg != NULL) ? msg : err_resp[error].msg, HTTPD_RESP_USE_STRLEN);
+}
+
+/*================= WEBSOCKET =================*/
+static uint32_t rol32(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+/* one 64 byte block into the sha1 state */
+static void sha1_block(uint32_t h[5], const uint8_t *block) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 | block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) w[i] = rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t t = rol32(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rol32(b, 30);
+        b = a;
+        a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+/* sha1 for the handshake, esp-idf uses mbedtls here */
+static void sha1(const uint8_t *msg, size_t len, uint8_t out[20]) {
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    uint8_t tail[128] = { 0 };
+
+    size_t full = len & ~(size_t)63;
+    for (size_t off = 0; off < full; off += 64) sha1_block(h, msg + off);
+
+    //the rest, the 0x80 end mark and the bit length, in one or two blocks
+    size_t rest = len - full;
+    size_t tail_len = (rest < 56) ? 64 : 128;
+    memcpy(tail, msg + full, rest);
+    tail[rest] = 0x80;
+    for (int i = 0; i < 8; i++) tail[tail_len - 1 - i] = (uint8_t)(((uint64_t)len * 8) >> (i * 8));
+    for (size_t off = 0; off < tail_len; off += 64) sha1_block(h, tail + off);
+
+    for (int i = 0; i < 20; i++) out[i] = (uint8_t)(h[i / 4] >> (24 - (i % 4) * 8));
+}
+
+static void base64_enc(const uint8_t *in, size_t len, char *out) {
+    static const char tbl[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16 | ((i + 1 < len) ? in[i + 1] << 8 : 0) | ((i + 2 < len) ? in[i + 2] : 0);
+        *out++ = tbl[(v >> 18) & 63];
+        *out++ = tbl[(v >> 12) & 63];
+        *out++ = (i + 1 < len) ? tbl[(v >> 6) & 63] : '=';
+        *out++ = (i + 2 < len) ? tbl[v & 63] : '=';
+    }
+    *out = '\0';
+}
+
+/* one unmasked server frame, header and payload in one segment */
+static esp_err_t ws_send(int fd, uint8_t first, const uint8_t *payload, size_t len) {
+    uint8_t hdr[WS_HDR_MAX];
+    int hdr_len = 2;
+
+    hdr[0] = first;
+    if (len < 126) {
+        hdr[1] = (uint8_t)len;
+    } else if (len <= UINT16_MAX) {
+        hdr[1] = 126;
+        hdr[2] = (uint8_t)(len >> 8);
+        hdr[3] = (uint8_t)len;
+        hdr_len = 4;
+    } else {
+        hdr[1] = 127;
+        for (int i = 0; i < 8; i++) hdr[2 + i] = (uint8_t)((uint64_t)len >> (56 - i * 8));
+        hdr_len = 10;
+    }
+    struct iovec iov[2] = { { hdr, hdr_len }, { (void *)payload, len } };
+    return (send_iov(fd, iov, (len > 0) ? 2 : 1) == ESP_OK) ? ESP_OK : ESP_FAIL;
+}
+
+/* length of the frame header at the start of buf, 0 while it is incomplete */
+static size_t ws_hdr_len(const uint8_t *buf, size_t len) {
+    if (len < 2) return 0;
+    size_t need = 2 + ((buf[1] & 0x80) ? 4 : 0);
+    if ((buf[1] & 0x7f) == 126) need += 2;
+    if ((buf[1] & 0x7f) == 127) need += 8;
+    return (len >= need) ? need : 0;
+}
+
+/* parses and consumes the frame header buffered in the session, the payload is left to httpd_req_recv */
+static void ws_hdr_parse(req_aux_t *aux, size_t hdr_len) {
+    sess_t *s = aux->sess;
+    const uint8_t *b = (const uint8_t *)s->buf;
+    uint64_t len = b[1] & 0x7f;
+    int off = 2;
+
+    if (len == 126) {
+        len = (uint64_t)b[2] << 8 | b[3];
+        off = 4;
+    } else if (len == 127) {
+        len = 0;
+        for (int i = 0; i < 8; i++) len = len << 8 | b[2 + i];
+        off = 10;
+    }
+    aux->ws = true;
+    aux->ws_fin = (b[0] & 0x80) != 0;
+    aux->ws_op = b[0] & 0x0f;
+    if (b[1] & 0x80) {
+        memcpy(aux->ws_mask, b + off, 4);
+    } else {
+        memset(aux->ws_mask, 0, 4);
+    }
+    aux->ws_len = len;
+    aux->remaining = len;
+    memmove(s->buf, s->buf + hdr_len, s->buf_len - hdr_len);
+    s->buf_len -= hdr_len;
+}
+
+/* the whole payload into buf (at least aux->ws_len bytes), unmasked */
+static esp_err_t ws_payload_read(httpd_req_t *req, uint8_t *buf) {
+    req_aux_t *aux = req->aux;
+    size_t got = 0;
+    while (got < aux->ws_len) {
+        int ret = httpd_req_recv(req, (char *)buf + got, aux->ws_len - got);
+        if (ret <= 0) return ESP_FAIL;
+        got += ret;
+    }
+    for (size_t i = 0; i < got; i++) buf[i] ^= aux->ws_mask[i % 4];
+    return ESP_OK;
+}
+
+esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *pkt, size_t max_len) {
+    req_aux_t *aux = req->aux;
+    if (pkt == NULL || !aux->ws) return ESP_ERR_INVALID_ARG;
+
+    //the header was read before the handler ran, max_len 0 only asks for the length
+    pkt->final = aux->ws_fin;
+    pkt->fragmented = !aux->ws_fin || aux->ws_op == HTTPD_WS_TYPE_CONTINUE;
+    pkt->type = (httpd_ws_type_t)aux->ws_op;
+    pkt->len = aux->ws_len;
+    if (max_len == 0) return ESP_OK;
+
+    if (pkt->payload == NULL) return ESP_ERR_INVALID_ARG;
+    if (max_len < aux->ws_len) return ESP_ERR_INVALID_SIZE;
+    if (aux->remaining != aux->ws_len) return ESP_ERR_INVALID_STATE;
+    return ws_payload_read(req, pkt->payload);
+}
+
+/* may be called from any task like in esp-idf, the frame is written to the socket directly */
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t *frame) {
+    if (frame == NULL || (frame->len > 0 && frame->payload == NULL)) return ESP_ERR_INVALID_ARG;
+    uint8_t first = (frame->final || !frame->fragmented) ? 0x80 : 0;
+    return ws_send(fd, first | (uint8_t)frame->type, frame->payload, frame->len);
+}
+
+/* only called from the server thread (queued work), like in esp-idf */
+httpd_ws_client_info_t httpd_ws_get_fd_info(httpd_handle_t hd, int fd) {
+    server_t *srv = hd;
+    for (int i = 0; i < srv->cfg.max_open_sockets; i++) {
+        if (srv->sess[i].fd == fd) return (srv->sess[i].ws_uri != NULL) ? HTTPD_WS_CLIENT_WEBSOCKET : HTTPD_WS_CLIENT_HTTP;
+    }
+    return HTTPD_WS_CLIENT_INVALID;
+}
+
+/* answers the upgrade and hands the session to the uri, the handler is called once with the GET */
+static esp_err_t ws_handshake(httpd_req_t *req, req_aux_t *aux, const httpd_uri_t *u) {
+    char key[64 + sizeof(WS_GUID)], hdr[RESP_HDR_SIZE];
+    uint8_t digest[20];
+    char accept[32];
+
+    const char *upgrade = req_hdr_find(aux, "Upgrade");
+    const char *k = req_hdr_find(aux, "Sec-WebSocket-Key");
+    if (req->method != HTTP_GET || upgrade == NULL || strcasecmp(upgrade, "websocket") != 0 || k == NULL ||
+        strlen(k) > 64 - 1) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, NULL);
+        return ESP_FAIL;
+    }
+    int key_len = snprintf(key, sizeof(key), "%s%s", k, WS_GUID);
+    sha1((const uint8_t *)key, key_len, digest);
+    base64_enc(digest, sizeof(digest), accept);
+
+    int len = snprintf(hdr, sizeof(hdr), "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+                       "Connection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n", accept);
+    if (u->supported_subprotocol != NULL) {
+        len += snprintf(hdr + len, sizeof(hdr) - len, "Sec-WebSocket-Protocol: %s\r\n", u->supported_subprotocol);
+    }
+    len += snprintf(hdr + len, sizeof(hdr) - len, "\r\n");
+    struct iovec iov = { hdr, len };
+    if (send_iov(aux->sess->fd, &iov, 1) != ESP_OK) return ESP_FAIL;
+
+    aux->sess->ws_uri = u;
+    req->user_ctx = u->user_ctx;
+    return u->handler(req);
+}
+
+/*
+one frame whose header is buffered in the session. control frames are answered here unless the uri handles them,
+data frames go to the handler with method 0 (HTTP_DELETE), like the zeroed request esp-idf hands it.
+false when the session must be closed
+*/
+static bool ws_frame_handle(server_t *srv, sess_t *s, size_t hdr_len) {
+    req_aux_t aux = { .sess = s, .status = HTTPD_200, .type = HTTPD_TYPE_TEXT };
+    httpd_req_t req = { .handle = srv, .aux = &aux, .user_ctx = s->ws_uri->user_ctx };
+    const httpd_uri_t *u = s->ws_uri;
+
+    s->lru = ++srv->req_cnt;
+    ws_hdr_parse(&aux, hdr_len);
+    snprintf((char *)req.uri, sizeof(req.uri), "%s", u->uri);
+
+    if ((aux.ws_op & 0x08) && !u->handle_ws_control_frames) {
+        uint8_t payload[WS_CTRL_MAX];
+        if (aux.ws_len > sizeof(payload) || ws_payload_read(&req, payload) != ESP_OK) return false;
+        if (aux.ws_op == HTTPD_WS_TYPE_PING) {
+            return ws_send(s->fd, 0x80 | HTTPD_WS_TYPE_PONG, payload, aux.ws_len) == ESP_OK;
+        }
+        if (aux.ws_op == HTTPD_WS_TYPE_CLOSE) {
+            //the status code of the client is echoed, then the session ends
+            ws_send(s->fd, 0x80 | HTTPD_WS_TYPE_CLOSE, payload, (aux.ws_len >= 2) ? 2 : 0);
+            return false;
+        }
+        return true;
+    }
+
+    if (u->handler(&req) != ESP_OK) return false;
+
+    //payload the handler did not read is dropped, the next frame starts after it
+    char discard[DISCARD_BUF_SIZE];
+    while (aux.remaining > 0) {
+        if (httpd_req_recv(&req, discard, sizeof(discard)) <= 0) return false;
+    }
+    return true;
+}
+
+/*================= URI MATCH =================*/
+/* a template ending in * matches every uri starting with the rest, a ? before that makes the char before it optional */
+bool httpd_uri_match_wildcard(const char *uri_template, const char *uri_to_match, size_t match_upto) {
+    size_t tpl_len = strlen(uri_template);
+    bool prefix = tpl_len > 0 && uri_template[tpl_len - 1] == '*';
+    if (prefix) tpl_len--;
+    bool opt = tpl_len > 1 && uri_template[tpl_len - 1] == '?';
+    if (opt) {
+        tpl_len--;
+        if (match_upto == tpl_len - 1 && strncmp(uri_template, uri_to_match, match_upto) == 0) return true;
+    }
+
+    if (prefix) return match_upto >= tpl_len && strncmp(uri_template, uri_to_match, tpl_len) == 0;
+    return match_upto == tpl_len && strncmp(uri_template, uri_to_match, tpl_len) == 0;
+}
+
+static bool uri_match(server_t *srv, const char *tpl, const char *uri, size_t len) {
+    if (srv->cfg.uri_match_fn != NULL) return srv->cfg.uri_match_fn(tpl, uri, len);
+    return strlen(tpl) == len && strncmp(tpl, uri, len) == 0;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler) {
+    server_t *srv = handle;
+    for (int i = 0; i < srv->uri_cnt; i++) {
+        if (srv->uris[i].method == uri_handler->method && strcmp(srv->uris[i].uri, uri_handler->uri) == 0) {
+            return ESP_ERR_HTTPD_HANDLER_EXISTS;
+        }
+    }
+    if (srv->uri_cnt >= srv->cfg.max_uri_handlers) return ESP_ERR_HTTPD_HANDLERS_FULL;
+    srv->uris[srv->uri_cnt++] = *uri_handler;
+    return ESP_OK;
+}
+
+/*================= SESSIONS =================*/
+static void sess_close(server_t *srv, sess_t *s) {
+    if (s->fd < 0) return;
+    if (srv->cfg.close_fn != NULL) {
+        srv->cfg.close_fn(srv, s->fd);
+    } else {
+        close(s->fd);
+    }
+    s->fd = -1;
+    s->ws_uri = NULL;
+    s->buf_len = 0;
+}
+
+static void sess_accept(server_t *srv) {
+    int fd = accept(srv->listen_fd, NULL, NULL);
+    if (fd < 0) return;
+
+    sess_t *free_s = NULL, *lru_s = NULL;
+    for (int i = 0; i < srv->cfg.max_open_sockets; i++) {
+        sess_t *s = &srv->sess[i];
+        if (s->fd < 0) {
+            if (free_s == NULL) free_s = s;
+        } else if (lru_s == NULL || s->lru < lru_s->lru) {
+            lru_s = s;
+        }
+    }
+    if (free_s == NULL && srv->cfg.lru_purge_enable && lru_s != NULL) {
+        ESP_LOGD(TAG, "purging lru session fd %d", lru_s->fd);
+        sess_close(srv, lru_s);
+        free_s = lru_s;
+    }
+    if (free_s == NULL) {
+        ESP_LOGD(TAG, "session table full, fd %d refused", fd);
+        close(fd);
+        return;
+    }
+
+    struct timeval rcv = { .tv_sec = srv->cfg.recv_wait_timeout };
+    struct timeval snd = { .tv_sec = srv->cfg.send_wait_timeout };
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &rcv, sizeof(rcv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &snd, sizeof(snd));
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    //a client that reads slowly fills the send buffer after as many bytes as on lwip, not after megabytes
+    int snd_buf = SESS_SND_BUF / 2;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &snd_buf, sizeof(snd_buf));
+
+    free_s->fd = fd;
+    free_s->ws_uri = NULL;
+    free_s->buf_len = 0;
+    free_s->lru = srv->req_cnt;
+    if (srv->cfg.open_fn != NULL && srv->cfg.open_fn(srv, fd) != ESP_OK) sess_close(srv, free_s);
+}
+
+static sess_t *sess_find(server_t *srv, int fd) {
+    for (int i = 0; i < srv->cfg.max_open_sockets; i++) {
+        if (srv->sess[i].fd == fd) return &srv->sess[i];
+    }
+    return NULL;
+}
+
+/*================= REQUEST HANDLING =================*/
+/* splits the header block in aux->req_hdr into nul terminated lines, fills the request line fields */
+static httpd_err_code_t req_parse(httpd_req_t *req, req_aux_t *aux) {
+    char *line = aux->req_hdr;
+    char *end = strstr(line, "\r\n");
+    *end = '\0';
+
+    char *sp1 = strchr(line, ' ');
+    char *sp2 = (sp1 != NULL) ? strchr(sp1 + 1, ' ') : NULL;
+    if (sp2 == NULL || strncmp(sp2 + 1, "HTTP/1.", 7) != 0) return HTTPD_400_BAD_REQUEST;
+    *sp1 = '\0';
+
+    req->method = -1;
+    for (size_t i = 0; i < sizeof(method_names) / sizeof(method_names[0]); i++) {
+        if (strcmp(line, method_names[i]) == 0) req->method = i;
+    }
+    if (req->method < 0) return HTTPD_501_METHOD_NOT_IMPLEMENTED;
+    if (sp2 - sp1 - 1 >= (long)sizeof(req->uri)) return HTTPD_414_URI_TOO_LONG;
+    memcpy((char *)req->uri, sp1 + 1, sp2 - sp1 - 1);
+    ((char *)req->uri)[sp2 - sp1 - 1] = '\0';
+    aux->close = strcmp(sp2 + 1, "HTTP/1.0") == 0;
+
+    //header lines are moved down to start at req_hdr, each nul terminated
+    char *dst = aux->req_hdr;
+    char *src = end + 2;
+    aux->req_hdr_cnt = 0;
+    while ((end = strstr(src, "\r\n")) != NULL && end != src) {
+        size_t len = end - src;
+        memmove(dst, src, len);
+        dst[len] = '\0';
+        dst += len + 1;
+        src = end + 2;
+        aux->req_hdr_cnt++;
+    }
+
+    const char *v = req_hdr_find(aux, "Transfer-Encoding");
+    if (v != NULL && strcasecmp(v, "identity") != 0) return HTTPD_411_LENGTH_REQUIRED;
+    v = req_hdr_find(aux, "Content-Length");
+    req->content_len = (v != NULL) ? strtoul(v, NULL, 10) : 0;
+    aux->remaining = req->content_len;
+    v = req_hdr_find(aux, "Connection");
+    if (v != NULL) aux->close = strcasecmp(v, "close") == 0;
+    return HTTPD_ERR_CODE_MAX;
+}
+
+static esp_err_t req_dispatch(server_t *srv, httpd_req_t *req) {
+    size_t len = strcspn(req->uri, "?#");
+    bool uri_found = false;
+
+    for (int i = 0; i < srv->uri_cnt; i++) {
+        httpd_uri_t *u = &srv->uris[i];
+        if (!uri_match(srv, u->uri, req->uri, len)) continue;
+        uri_found = true;
+        if (u->method != req->method) continue;
+
+        if (u->is_websocket) return ws_handshake(req, req->aux, u);
+        req->user_ctx = u->user_ctx;
+        return u->handler(req);
+    }
+
+    //like esp-idf, an error response to a request that matched no handler also ends the session
+    httpd_resp_send_err(req, uri_found ? HTTPD_405_METHOD_NOT_ALLOWED : HTTPD_404_NOT_FOUND, NULL);
+    return ESP_FAIL;
+}
+
+/* one request whose header ends at hdr_len in s->buf. false when the session must be closed */
+static bool req_handle(server_t *srv, sess_t *s, size_t hdr_len) {
+    req_aux_t aux = { .sess = s, .status = HTTPD_200, .type = HTTPD_TYPE_TEXT };
+    httpd_req_t req = { .handle = srv, .aux = &aux };
+
+    memcpy(aux.req_hdr, s->buf, hdr_len);
+    aux.req_hdr[hdr_len] = '\0';
+    memmove(s->buf, s->buf + hdr_len, s->buf_len - hdr_len);
+    s->buf_len -= hdr_len;
+
+    s->lru = ++srv->req_cnt;
+
+    httpd_err_code_t parse_err = req_parse(&req, &aux);
+    if (parse_err != HTTPD_ERR_CODE_MAX) {
+        httpd_resp_send_err(&req, parse_err, NULL);
+        return false;
+    }
+    if (req_dispatch(srv, &req) != ESP_OK) return false;
+
+    //body the handler did not read is dropped, the next request starts after it
+    char discard[DISCARD_BUF_SIZE];
+    while (aux.remaining > 0) {
+        if (httpd_req_recv(&req, discard, sizeof(discard)) <= 0) return false;
+    }
+    return !aux.close;
+}
+
+/* a complete request or frame header is buffered */
+static bool sess_pending(sess_t *s) {
+    if (s->ws_uri != NULL) return ws_hdr_len((const uint8_t *)s->buf, s->buf_len) != 0;
+    return memmem(s->buf, s->buf_len, "\r\n\r\n", 4) != NULL;
+}
+
+/*
+reads what the socket has when readable and handles one complete request. like httpd_sess_process, pipelined
+requests after it wait for the next poll round, the other sessions get their turn in between
+*/
+static void sess_process(server_t *srv, sess_t *s, bool readable) {
+    //a full buffer is left in the socket until the requests in it are handled
+    if (readable && s->buf_len < sizeof(s->buf)) {
+        int ret = recv(s->fd, s->buf + s->buf_len, sizeof(s->buf) - s->buf_len, MSG_DONTWAIT);
+        if (ret == 0 || (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            sess_close(srv, s);
+            return;
+        }
+        if (ret > 0) s->buf_len += ret;
+    }
+
+    if (s->ws_uri != NULL) {
+        size_t hdr_len = ws_hdr_len((const uint8_t *)s->buf, s->buf_len);
+        if (hdr_len != 0 && !ws_frame_handle(srv, s, hdr_len)) sess_close(srv, s);
+        return;
+    }
+
+    char *end = memmem(s->buf, s->buf_len, "\r\n\r\n", 4);
+    if (end != NULL) {
+        if (!req_handle(srv, s, end + 4 - s->buf)) sess_close(srv, s);
+        return;
+    }
+
+    if (s->buf_len == sizeof(s->buf)) {
+        req_aux_t aux = { .sess = s, .status = HTTPD_200, .type = HTTPD_TYPE_TEXT };
+        httpd_req_t req = { .handle = srv, .aux = &aux };
+        httpd_resp_send_err(&req, HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE, NULL);
+        sess_close(srv, s);
+    }
+}
+
+/*================= SERVER =================*/
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void *arg) {
+    server_t *srv = handle;
+    work_t w = { .fn = work, .arg = arg };
+    //a pipe write this small is atomic, concurrent callers never interleave
+    return (write(srv->ctrl_wr, &w, sizeof(w)) == sizeof(w)) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd) {
+    return httpd_queue_work(handle, NULL, (void *)(intptr_t)sockfd);
+}
+
+static void ctrl_process(server_t *srv) {
+    work_t w;
+    while (read(srv->ctrl_rd, &w, sizeof(w)) == sizeof(w)) {
+        if (w.fn != NULL) {
+            w.fn(w.arg);
+            continue;
+        }
+        sess_t *s = sess_find(srv, (int)(intptr_t)w.arg);
+        if (s != NULL) sess_close(srv, s);
+    }
+}
+
+/* a port task like httpd's own, so uxTaskGetStackHighWaterMark measures the handlers */
+static void httpd_thread(void *arg) {
+    server_t *srv = arg;
+    int max = srv->cfg.max_open_sockets;
+    struct pollfd *pfds = calloc(max + 2, sizeof(*pfds));
+    sess_t **pfd_sess = calloc(max, sizeof(*pfd_sess));
+
+    for (;;) {
+        int n = 0;
+        pfds[n++] = (struct pollfd){ .fd = srv->listen_fd, .events = POLLIN };
+        pfds[n++] = (struct pollfd){ .fd = srv->ctrl_rd, .events = POLLIN };
+        int timeout = -1;
+        for (int i = 0; i < max; i++) {
+            if (srv->sess[i].fd < 0) continue;
+            pfd_sess[n - 2] = &srv->sess[i];
+            pfds[n++] = (struct pollfd){ .fd = srv->sess[i].fd, .events = POLLIN };
+            //a buffered pipelined request is ready without the socket
+            if (sess_pending(&srv->sess[i])) timeout = 0;
+        }
+
+        if (poll(pfds, n, timeout) < 0) continue;
+
+        if (pfds[1].revents & POLLIN) ctrl_process(srv);
+        for (int i = 2; i < n; i++) {
+            //the session may have been closed by queued work or a purge since the poll
+            sess_t *s = pfd_sess[i - 2];
+            if (s->fd != pfds[i].fd) continue;
+            if (pfds[i].revents != 0 || sess_pending(s)) sess_process(srv, s, pfds[i].revents != 0);
+        }
+        if (pfds[0].revents & POLLIN) sess_accept(srv);
+    }
+}
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config) {
+    server_t *srv = calloc(1, sizeof(*srv));
+    if (srv == NULL) return ESP_ERR_HTTPD_ALLOC_MEM;
+    srv->cfg = *config;
+    if (port_httpd_port_override != 0) srv->cfg.server_port = port_httpd_port_override;
+    srv->uris = calloc(config->max_uri_handlers, sizeof(httpd_uri_t));
+    srv->sess = calloc(config->max_open_sockets, sizeof(sess_t));
+    if (srv->uris == NULL || srv->sess == NULL) return ESP_ERR_HTTPD_ALLOC_MEM;
+    for (int i = 0; i < config->max_open_sockets; i++) srv->sess[i].fd = -1;
+
+    //dual stack like the lwip server socket, ipv4 clients show up v4 mapped
+    struct sockaddr_in6 addr = { .sin6_family = AF_INET6, .sin6_addr = in6addr_any,
+                                 .sin6_port = htons(srv->cfg.server_port) };
+    int zero = 0, one = 1;
+    srv->listen_fd = socket(AF_INET6, SOCK_STREAM, 0);
+    if (srv->listen_fd < 0) return ESP_ERR_HTTPD_TASK;
+    setsockopt(srv->listen_fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+    setsockopt(srv->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(srv->listen_fd, srv->cfg.backlog_conn) != 0) {
+        ESP_LOGE(TAG, "cannot listen on port %d: %s", srv->cfg.server_port, strerror(errno));
+        close(srv->listen_fd);
+        return ESP_ERR_HTTPD_TASK;
+    }
+
+    int ctrl[2];
+    if (pipe2(ctrl, O_NONBLOCK | O_CLOEXEC) != 0) return ESP_ERR_HTTPD_TASK;
+    srv->ctrl_rd = ctrl[0];
+    srv->ctrl_wr = ctrl[1];
+
+    if (xTaskCreate(httpd_thread, "httpd", srv->cfg.stack_size, srv, srv->cfg.task_priority, NULL) != pdPASS) {
+        return ESP_ERR_HTTPD_TASK;
+    }
+    ESP_LOGI(TAG, "listening on port %d, %d sessions of %u bytes", srv->cfg.server_port,
+             srv->cfg.max_open_sockets, (unsigned int)sizeof(sess_t));
+    *handle = srv;
+    return ESP_OK;
+}
@@ -0,0 +1,30 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "esp_http_server.h"
+
+/*
+entry point of the host build: the firmware app_main runs as is, then main only keeps the process alive.
+usage: ./small_webserver [-p http_port]    (default 8080, the firmware port 80 needs root)
+*/
+
+void app_main(void);
+
+int main(int argc, char **argv) {
+    int c;
+    port_httpd_port_override = 8080;
+    while ((c = getopt(argc, argv, "p:")) != -1) {
+        switch (c) {
+        case 'p': port_httpd_port_override = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-p http_port]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    //a client closing early must not kill the server, sends report EPIPE instead
+    signal(SIGPIPE, SIG_IGN);
+    app_main();
+    for (;;) pause();
+}
@@ -0,0 +1,248 @@
+/*
+host client for the udp control endpoint, measures cmds/s and round trip latency.
+
+build: gcc -O2 -Wall -o udp_ctrl_client host/udp_ctrl_client.c
+usage: ./udp_ctrl_client [-h host] [-p port] [-n cmds] [-w window] [-s string] [-t timeout_ms] [-r]
+
+- every cmd asks for an ack, up to window cmds are in flight at once (-w 1 is ping-pong, the pure round trip).
+- without -s the cmd is a led toggle, with -s it is a print of the string.
+- a cmd not acked within the timeout is counted as lost and not retried.
+- the default host is 192.168.4.1 (the soft AP), against a host build of the server use -h 127.0.0.1.
+- -r checks the duplicate detection instead, one cmd at a time: a seq older than one already executed still runs,
+retransmissions of both are acked DUP with their own ticket, and a cmd refused for admission (throttled) runs
+when retried with the same seq after a later one ran. exits 1 on the first wrong ack.
+*/
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../main/udp_ctrl_proto.h"
+
+typedef struct {
+    const char *host;
+    int port;
+    int cmds;
+    int window;
+    const char *str;
+    int timeout_ms;
+    int reorder;
+} opts_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int parse_opts(int argc, char **argv, opts_t *o) {
+    int c;
+    *o = (opts_t){ .host = "192.168.4.1", .port = UDP_CTRL_PORT, .cmds = 1000, .window = 1, .str = NULL,
+                   .timeout_ms = 500 };
+
+    while ((c = getopt(argc, argv, "h:p:n:w:s:t:r")) != -1) {
+        switch (c) {
+        case 'h': o->host = optarg; break;
+        case 'p': o->port = atoi(optarg); break;
+        case 'n': o->cmds = atoi(optarg); break;
+        case 'w': o->window = atoi(optarg); break;
+        case 's': o->str = optarg; break;
+        case 't': o->timeout_ms = atoi(optarg); break;
+        case 'r': o->reorder = 1; break;
+        default: return -1;
+        }
+    }
+    if (o->cmds <= 0 || o->window <= 0 || o->timeout_ms <= 0) return -1;
+    if (o->str != NULL && strlen(o->str) > UDP_CTRL_VALUE_MAX) return -1;
+    return 0;
+}
+
+static int send_cmd(int sock, const opts_t *o, uint32_t seq) {
+    udp_cmd_pkt_t pkt = {
+        .magic = UDP_CTRL_MAGIC,
+        .version = UDP_CTRL_VERSION,
+        .cmd = (o->str != NULL) ? UDP_CMD_STR : UDP_CMD_TOGGLE,
+        .flags = UDP_FLAG_ACK,
+        .seq = seq,
+        .len = (o->str != NULL) ? strlen(o->str) : 0,
+    };
+    if (pkt.len > 0) memcpy(pkt.value, o->str, pkt.len);
+    return send(sock, &pkt, UDP_CMD_HDR_SIZE + pkt.len, 0) < 0 ? -1 : 0;
+}
+
+/*================= REORDER CHECK =================*/
+static const char *status_names[] = { "ok", "dup", "throttled", "busy", "bad" };
+
+/* one cmd and its ack, -1 when none came within the timeout */
+static int cmd_ack(int sock, const opts_t *o, uint32_t seq, udp_ack_pkt_t *ack) {
+    if (send_cmd(sock, o, seq) != 0) return -1;
+    uint64_t deadline = now_ns() + (uint64_t)o->timeout_ms * 1000000u;
+    for (;;) {
+        int64_t left_ms = ((int64_t)(deadline - now_ns())) / 1000000;
+        struct pollfd pfd = { .fd = sock, .events = POLLIN };
+        if (left_ms < 0 || poll(&pfd, 1, (int)left_ms) <= 0) return -1;
+        ssize_t len = recv(sock, ack, sizeof(*ack), 0);
+        if (len == sizeof(*ack) && ack->magic == UDP_CTRL_ACK_MAGIC && ack->seq == seq) return 0;
+    }
+}
+
+/* ticket of an ok ack or of a dup ack carrying want_ticket, exits on anything else */
+static uint32_t expect_ack(int sock, const opts_t *o, uint32_t seq, uint8_t want, uint32_t want_ticket) {
+    udp_ack_pkt_t ack;
+    if (cmd_ack(sock, o, seq, &ack) != 0) {
+        printf("seq %u: no ack\n", (unsigned int)seq);
+        exit(1);
+    }
+    const char *got = ack.status <= UDP_ACK_BAD ? status_names[ack.status] : "?";
+    if (ack.status != want || (want == UDP_ACK_DUP && ack.ticket != want_ticket)) {
+        printf("seq %u: %s ticket %u, expected %s ticket %u\n", (unsigned int)seq, got, (unsigned int)ack.ticket,
+               status_names[want], (unsigned int)want_ticket);
+        exit(1);
+    }
+    printf("seq %u: %s ticket %u\n", (unsigned int)seq, got, (unsigned int)ack.ticket);
+    return ack.ticket;
+}
+
+static int reorder_check(int sock, const opts_t *o) {
+    //a new socket is a new ip:port to the server, seqs start without history
+    uint32_t t10 = expect_ack(sock, o, 10, UDP_ACK_OK, 0);
+    uint32_t t9 = expect_ack(sock, o, 9, UDP_ACK_OK, 0);
+    if (t9 == t10) {
+        printf("seq 9 and 10 share ticket %u\n", (unsigned int)t9);
+        return 1;
+    }
+    expect_ack(sock, o, 9, UDP_ACK_DUP, t9);
+    expect_ack(sock, o, 10, UDP_ACK_DUP, t10);
+    uint32_t t12 = expect_ack(sock, o, 12, UDP_ACK_OK, 0);
+    expect_ack(sock, o, 11, UDP_ACK_OK, 0);
+    expect_ack(sock, o, 12, UDP_ACK_DUP, t12);
+
+    //empty the client's admission bucket, the throttled seq must run once retried after the refill
+    uint32_t seq = 100, throttled = 0;
+    for (int i = 0; i < 1000 && throttled == 0; i++, seq++) {
+        udp_ack_pkt_t ack;
+        if (cmd_ack(sock, o, seq, &ack) != 0) {
+            printf("seq %u: no ack\n", (unsigned int)seq);
+            return 1;
+        }
+        if (ack.status == UDP_ACK_THROTTLED) throttled = seq;
+    }
+    if (throttled == 0) {
+        printf("never throttled, retry after throttling not checked\n");
+        printf("reorder check ok\n");
+        return 0;
+    }
+    printf("seq %u: throttled\n", (unsigned int)throttled);
+
+    //a later seq runs first, then the throttled one is retried as is until the bucket lets it through
+    uint32_t seqs[2] = { throttled + 1, throttled };
+    for (int k = 0; k < 2; k++) {
+        udp_ack_pkt_t ack = { .status = UDP_ACK_THROTTLED };
+        for (int i = 0; i < 50 && ack.status == UDP_ACK_THROTTLED; i++) {
+            usleep(100000);
+            if (cmd_ack(sock, o, seqs[k], &ack) != 0) ack.status = UDP_ACK_THROTTLED;
+        }
+        if (ack.status != UDP_ACK_OK) {
+            printf("seq %u: %s on retry\n", (unsigned int)seqs[k],
+                   ack.status <= UDP_ACK_BAD ? status_names[ack.status] : "?");
+            return 1;
+        }
+        printf("seq %u: ok ticket %u\n", (unsigned int)seqs[k], (unsigned int)ack.ticket);
+        if (k == 1) expect_ack(sock, o, throttled, UDP_ACK_DUP, ack.ticket);
+    }
+    printf("reorder check ok\n");
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    opts_t o;
+    if (parse_opts(argc, argv, &o) != 0) {
+        fprintf(stderr, "usage: %s [-h host] [-p port] [-n cmds] [-w window] [-s string] [-t timeout_ms] [-r]\n",
+                argv[0]);
+        return 2;
+    }
+
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(o.port) };
+    if (inet_pton(AF_INET, o.host, &addr.sin_addr) != 1) {
+        fprintf(stderr, "bad host %s\n", o.host);
+        return 2;
+    }
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("socket");
+        return 1;
+    }
+    if (o.reorder) return reorder_check(sock, &o);
+
+    //seq i + 1 is sent at sent_ns[i], acked cmds get their round trip in rtt_ns
+    uint64_t *sent_ns = calloc(o.cmds, sizeof(uint64_t));
+    uint64_t *rtt_ns = calloc(o.cmds, sizeof(uint64_t));
+    uint8_t *acked = calloc(o.cmds, 1);
+    int status_cnt[UDP_ACK_BAD + 1] = { 0 };
+    int next = 0, oldest = 0, done = 0, rtt_cnt = 0, lost = 0;
+    uint64_t timeout_ns = (uint64_t)o.timeout_ms * 1000000u;
+    uint64_t start = now_ns();
+
+    while (done < o.cmds) {
+        while (next < o.cmds && next - oldest < o.window) {
+            sent_ns[next] = now_ns();
+            if (send_cmd(sock, &o, next + 1) != 0) {
+                perror("send");
+                return 1;
+            }
+            next++;
+        }
+
+        //give up on the oldest cmd once it timed out, that frees a window slot
+        while (oldest < next && (acked[oldest] || now_ns() - sent_ns[oldest] > timeout_ns)) {
+            if (!acked[oldest]) {
+                lost++;
+                done++;
+            }
+            oldest++;
+        }
+        if (oldest < next && next - oldest >= o.window) {
+            struct pollfd pfd = { .fd = sock, .events = POLLIN };
+            if (poll(&pfd, 1, o.timeout_ms) <= 0) continue;
+        }
+
+        udp_ack_pkt_t ack;
+        ssize_t len = recv(sock, &ack, sizeof(ack), MSG_DONTWAIT);
+        if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNREFUSED)) continue;
+        if (len != sizeof(ack) || ack.magic != UDP_CTRL_ACK_MAGIC || ack.seq == 0 || ack.seq > (uint32_t)o.cmds) continue;
+
+        int i = ack.seq - 1;
+        if (acked[i] || i < oldest) continue;   //late ack of a cmd already counted as lost
+        acked[i] = 1;
+        rtt_ns[rtt_cnt++] = now_ns() - sent_ns[i];
+        if (ack.status <= UDP_ACK_BAD) status_cnt[ack.status]++;
+        done++;
+    }
+
+    double secs = (now_ns() - start) / 1e9;
+    printf("cmds %d in %.3f s, %.0f cmds/s (window %d)\n", o.cmds, secs, o.cmds / secs, o.window);
+    printf("acks ok %d dup %d throttled %d busy %d bad %d, lost %d\n", status_cnt[UDP_ACK_OK], status_cnt[UDP_ACK_DUP],
+           status_cnt[UDP_ACK_THROTTLED], status_cnt[UDP_ACK_BUSY], status_cnt[UDP_ACK_BAD], lost);
+    if (rtt_cnt > 0) {
+        qsort(rtt_ns, rtt_cnt, sizeof(uint64_t), cmp_u64);
+        uint64_t sum = 0;
+        for (int i = 0; i < rtt_cnt; i++) sum += rtt_ns[i];
+        printf("rtt us: min %.1f avg %.1f p50 %.1f p99 %.1f max %.1f\n", rtt_ns[0] / 1e3, sum / 1e3 / rtt_cnt,
+               rtt_ns[rtt_cnt / 2] / 1e3, rtt_ns[(rtt_cnt * 99) / 100] / 1e3, rtt_ns[rtt_cnt - 1] / 1e3);
+    }
+
+    free(sent_ns);
+    free(rtt_ns);
+    free(acked);
+    close(sock);
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "admission.h"
+
+//tokens are kept in thousandths so slow rates still refill between close requests
+#define TOKEN_MILLI             1000
+
+typedef struct {
+    uint32_t rate;
+    uint32_t burst_milli;
+    uint32_t tokens_milli;
+    int64_t last_us;
+} token_bucket_t;
+
+typedef struct {
+    uint32_t ip;
+    token_bucket_t bucket;
+} client_slot_t;
+
+static token_bucket_t global_bucket;
+static client_slot_t clients[ADMIT_MAX_CLIENTS];
+static portMUX_TYPE admit_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void bucket_init(token_bucket_t *b, uint32_t rate, uint32_t burst, int64_t now_us) {
+    b->rate = rate;
+    b->burst_milli = burst * TOKEN_MILLI;
+    b->tokens_milli = b->burst_milli;
+    b->last_us = now_us;
+}
+
+static void bucket_refill(token_bucket_t *b, int64_t now_us) {
+    int64_t elapsed_us = now_us - b->last_us;
+    //rate tokens/s is rate milli-tokens/ms
+    int64_t add = elapsed_us * b->rate / 1000;
+    if (add <= 0) return;
+
+    uint64_t tokens = (uint64_t)b->tokens_milli + add;
+    b->tokens_milli = (tokens > b->burst_milli) ? b->burst_milli : (uint32_t)tokens;
+    b->last_us = now_us;
+}
+
+static uint32_t bucket_wait_s(const token_bucket_t *b) {
+    if (b->tokens_milli >= TOKEN_MILLI || b->rate == 0) return 1;
+    //missing milli-tokens / (rate milli-tokens per ms), both divisions round up so the result is at least 1
+    uint32_t wait_ms = (TOKEN_MILLI - b->tokens_milli + b->rate - 1) / b->rate;
+    return (wait_ms + 999) / 1000;
+}
+
+static token_bucket_t *client_bucket(uint32_t ip, int64_t now_us) {
+    client_slot_t *lru = &clients[0];
+
+    for (int i = 0; i < ADMIT_MAX_CLIENTS; i++) {
+        if (clients[i].ip == ip) return &clients[i].bucket;
+        if (clients[i].bucket.last_us < lru->bucket.last_us) lru = &clients[i];
+    }
+
+    //a new client starts with a full burst
+    lru->ip = ip;
+    bucket_init(&lru->bucket, ADMIT_CLIENT_RATE, ADMIT_CLIENT_BURST, now_us);
+    return &lru->bucket;
+}
+
+void admission_init(void) {
+    int64_t now_us = esp_timer_get_time();
+
+    //free slots look like idle clients with a full bucket, so they are evicted first
+    for (int i = 0; i < ADMIT_MAX_CLIENTS; i++) {
+        clients[i].ip = 0;
+        bucket_init(&clients[i].bucket, ADMIT_CLIENT_RATE, ADMIT_CLIENT_BURST, 0);
+    }
+    bucket_init(&global_bucket, ADMIT_RATE, ADMIT_BURST, now_us);
+}
+
+/* refill both buckets, true if both hold a token. called with admit_mux held */
+static bool peek_locked(uint32_t client_ip, int64_t now_us, token_bucket_t **cb) {
+    *cb = client_bucket(client_ip, now_us);
+    bucket_refill(&global_bucket, now_us);
+    bucket_refill(*cb, now_us);
+    return global_bucket.tokens_milli >= TOKEN_MILLI && (*cb)->tokens_milli >= TOKEN_MILLI;
+}
+
+bool admission_peek(uint32_t client_ip) {
+    int64_t now_us = esp_timer_get_time();
+    token_bucket_t *cb;
+
+    portENTER_CRITICAL(&admit_mux);
+    bool ok = peek_locked(client_ip, now_us, &cb);
+    portEXIT_CRITICAL(&admit_mux);
+    return ok;
+}
+
+bool admission_take(uint32_t client_ip) {
+    int64_t now_us = esp_timer_get_time();
+    token_bucket_t *cb;
+
+    portENTER_CRITICAL(&admit_mux);
+    bool ok = peek_locked(client_ip, now_us, &cb);
+    if (ok) {
+        global_bucket.tokens_milli -= TOKEN_MILLI;
+        cb->tokens_milli -= TOKEN_MILLI;
+    }
+    portEXIT_CRITICAL(&admit_mux);
+    return ok;
+}
+
+uint32_t admission_retry_after(uint32_t client_ip) {
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&admit_mux);
+    token_bucket_t *cb = client_bucket(client_ip, now_us);
+    uint32_t g = bucket_wait_s(&global_bucket);
+    uint32_t c = bucket_wait_s(cb);
+    portEXIT_CRITICAL(&admit_mux);
+    return (g > c) ? g : c;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+token bucket admission control in front of the cmd bus.
+
+- every command takes one token from the global bucket and one from its client's bucket, so a single client can
+only use its own share of the global rate.
+- clients are keyed by IPv4 address in a small table, the least recently seen client is evicted when it is full.
+- the buckets are updated in a short critical section, so the httpd and udp tasks can both admit cmds.
+*/
+
+//the host build raises the rates to measure the server itself, bursts are limited to 4M by the milli-tokens
+#ifndef ADMIT_RATE
+#define ADMIT_RATE              20  //cmds/s for all clients together
+#endif
+#ifndef ADMIT_BURST
+#define ADMIT_BURST             10
+#endif
+#ifndef ADMIT_CLIENT_RATE
+#define ADMIT_CLIENT_RATE       10  //cmds/s for one client
+#endif
+#ifndef ADMIT_CLIENT_BURST
+#define ADMIT_CLIENT_BURST      5
+#endif
+#define ADMIT_MAX_CLIENTS       8
+
+void admission_init(void);
+
+/* true when the client could take a token now, nothing is consumed */
+bool admission_peek(uint32_t client_ip);
+
+/* take one token from the global and the client bucket, false if either is empty */
+bool admission_take(uint32_t client_ip);
+
+/* whole seconds until admission_take can succeed again for this client, at least 1 */
+uint32_t admission_retry_after(uint32_t client_ip);
@@ -0,0 +1,42 @@
+#include "buf_pool.h"
+
+static buf_pool_t *pools[BUF_POOL_MAX_POOLS];
+static int pool_cnt;
+
+void buf_pool_init(buf_pool_t *pool) {
+    atomic_store(&pool->free_map, (pool->block_cnt >= 32) ? 0xffffffffu : ((1u << pool->block_cnt) - 1));
+    atomic_store(&pool->in_use, 0);
+    atomic_store(&pool->high_water, 0);
+    atomic_store(&pool->exhausted, 0);
+
+    //pools are registered once at boot, before any task uses them
+    if (pool_cnt < BUF_POOL_MAX_POOLS) pools[pool_cnt++] = pool;
+}
+
+void *buf_pool_get(buf_pool_t *pool) {
+    unsigned int map = atomic_load(&pool->free_map);
+
+    while (map != 0) {
+        unsigned int bit = map & -map; //lowest free block
+        if (atomic_compare_exchange_weak(&pool->free_map, &map, map & ~bit)) {
+            unsigned int used = atomic_fetch_add(&pool->in_use, 1) + 1;
+            unsigned int hw = atomic_load(&pool->high_water);
+            while (used > hw && !atomic_compare_exchange_weak(&pool->high_water, &hw, used)) {}
+            return pool->mem + __builtin_ctz(bit) * pool->block_size;
+        }
+    }
+
+    atomic_fetch_add(&pool->exhausted, 1);
+    return NULL;
+}
+
+void buf_pool_put(buf_pool_t *pool, void *buf) {
+    unsigned int idx = ((uint8_t *)buf - pool->mem) / pool->block_size;
+    atomic_fetch_sub(&pool->in_use, 1);
+    atomic_fetch_or(&pool->free_map, 1u << idx);
+}
+
+buf_pool_t *const *buf_pool_list(int *cnt) {
+    *cnt = pool_cnt;
+    return pools;
+}
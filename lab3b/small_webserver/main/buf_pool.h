@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+fixed-block buffer pool, no heap.
+
+- blocks are handed out from a static array, a free bitmap updated with CAS makes get/put lock-free and usable from any task.
+- at most 32 blocks per pool.
+- the pool tracks its high-water mark and how many gets failed, so block counts can be sized from real load.
+*/
+
+#define BUF_POOL_MAX_POOLS      4   //pools listed by buf_pool_list()
+
+typedef struct {
+    const char *name;
+    uint8_t *mem;
+    size_t block_size;
+    int block_cnt;
+    atomic_uint free_map;       //bit i set means block i is free
+    atomic_uint in_use;
+    atomic_uint high_water;
+    atomic_uint exhausted;      //gets that found the pool empty
+} buf_pool_t;
+
+/* define a file local pool with static storage, it must still be registered with buf_pool_init */
+#define BUF_POOL_DEFINE(pool_name, blk_size, blk_cnt)                                               \
+    static uint8_t pool_name##_mem[(blk_cnt)][((blk_size) + 3) & ~3] __attribute__((aligned(4)));  \
+    static buf_pool_t pool_name = {                                                                 \
+        .name = #pool_name,                                                                         \
+        .mem = &pool_name##_mem[0][0],                                                              \
+        .block_size = ((blk_size) + 3) & ~3,                                                        \
+        .block_cnt = (blk_cnt),                                                                     \
+    }
+
+void buf_pool_init(buf_pool_t *pool);
+
+/* NULL when every block is in use */
+void *buf_pool_get(buf_pool_t *pool);
+
+void buf_pool_put(buf_pool_t *pool, void *buf);
+
+/* registered pools, for reporting */
+buf_pool_t *const *buf_pool_list(int *cnt);
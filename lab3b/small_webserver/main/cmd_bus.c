@@ -0,0 +1,184 @@
+#include <string.h>
+#include "cmd_bus.h"
+#include "buf_pool.h"
+
+BUF_POOL_DEFINE(cmd_msg_pool, sizeof(cmd_msg_t), CMD_BUS_POOL_SIZE);
+
+//a slot index is claimed first and the pointer stored after, readers skip slots still NULL
+static cmd_sub_t *_Atomic subs[CMD_BUS_MAX_SUBS];
+static atomic_uint sub_cnt;     //slots claimed, may pass CMD_BUS_MAX_SUBS when subscribes fail
+
+//ticket 0 is never issued. done_tickets[t % history] holds (t << 1 | dropped) once t is completed
+static atomic_uint last_ticket;
+static atomic_uint done_tickets[CMD_BUS_TICKET_HISTORY];
+static SemaphoreHandle_t publish_lock;
+
+void cmd_bus_init(void) {
+    buf_pool_init(&cmd_msg_pool);
+    publish_lock = xSemaphoreCreateMutex();
+    atomic_store(&sub_cnt, 0);
+    for (int i = 0; i < CMD_BUS_MAX_SUBS; i++) atomic_store(&subs[i], NULL);
+    atomic_store(&last_ticket, 0);
+    for (int i = 0; i < CMD_BUS_TICKET_HISTORY; i++) atomic_store(&done_tickets[i], 0);
+}
+
+esp_err_t cmd_bus_subscribe(cmd_sub_t *sub, uint32_t cmd_mask) {
+    //handler tasks subscribe concurrently, each claims its own slot
+    unsigned int n = atomic_fetch_add(&sub_cnt, 1);
+    if (n >= CMD_BUS_MAX_SUBS) return ESP_ERR_NO_MEM;
+
+    atomic_store(&sub->head, 0);
+    atomic_store(&sub->tail, 0);
+    atomic_store(&sub->dropped, 0);
+    sub->task = xTaskGetCurrentTaskHandle();
+    sub->cmd_mask = cmd_mask;
+
+    //the pointer is stored last so the producer never sees a half registered subscriber
+    atomic_store_explicit(&subs[n], sub, memory_order_release);
+    return ESP_OK;
+}
+
+/* the registered subscribers, copied once so one publish works on a fixed set */
+static unsigned int subs_snapshot(cmd_sub_t **out) {
+    unsigned int n = atomic_load(&sub_cnt);
+    unsigned int cnt = 0;
+    if (n > CMD_BUS_MAX_SUBS) n = CMD_BUS_MAX_SUBS;
+    for (unsigned int i = 0; i < n; i++) {
+        cmd_sub_t *sub = atomic_load_explicit(&subs[i], memory_order_acquire);
+        if (sub != NULL) out[cnt++] = sub;
+    }
+    return cnt;
+}
+
+cmd_id_t cmd_id_from_key(const char *key) {
+    static const char *const keys[CMD_ID_CNT] = {
+        [CMD_ID_TOGGLE] = "toggle",
+        [CMD_ID_STR] = "str",
+        [CMD_ID_LED_SET] = "led",
+    };
+
+    for (int id = CMD_ID_NONE + 1; id < CMD_ID_CNT; id++) {
+        if (strcmp(key, keys[id]) == 0) return (cmd_id_t)id;
+    }
+    return CMD_ID_NONE;
+}
+
+cmd_msg_t *cmd_bus_alloc(void) {
+    cmd_msg_t *msg = (cmd_msg_t *)buf_pool_get(&cmd_msg_pool);
+    if (msg == NULL) return NULL;
+
+    msg->id = CMD_ID_NONE;
+    msg->ticket = 0;
+    atomic_store(&msg->refcnt, 1);
+    atomic_store(&msg->dropped, 0);
+    return msg;
+}
+
+void cmd_bus_release(cmd_msg_t *msg) {
+    if (atomic_fetch_sub(&msg->refcnt, 1) == 1) {
+        //a message allocated but never published has no ticket to complete
+        if (msg->ticket != 0) {
+            unsigned int done = (msg->ticket << 1) | (atomic_load(&msg->dropped) ? 1 : 0);
+            atomic_store(&done_tickets[msg->ticket & (CMD_BUS_TICKET_HISTORY - 1)], done);
+        }
+        buf_pool_put(&cmd_msg_pool, msg);
+    }
+}
+
+uint32_t cmd_bus_publish(cmd_msg_t *msg) {
+    return cmd_bus_publish_batch(&msg, 1);
+}
+
+uint32_t cmd_bus_publish_batch(cmd_msg_t **msgs, int cnt) {
+    cmd_sub_t *active[CMD_BUS_MAX_SUBS];
+    unsigned int n = subs_snapshot(active);
+    uint32_t first_ticket = 0;
+
+    //tickets and ring heads have a single writer at a time
+    xSemaphoreTake(publish_lock, portMAX_DELAY);
+    uint32_t ticket = atomic_load(&last_ticket);
+
+    for (int m = 0; m < cnt; m++) {
+        if (++ticket > (UINT32_MAX >> 1)) ticket = 1; //the top bit is used by done_tickets
+        if (m == 0) first_ticket = ticket;
+        msgs[m]->ticket = ticket;
+        //take all subscriber references up front so an early release cannot free the message under us
+        unsigned int refs = 0;
+        for (unsigned int i = 0; i < n; i++) {
+            if (active[i]->cmd_mask & CMD_BIT(msgs[m]->id)) refs++;
+        }
+        atomic_fetch_add(&msgs[m]->refcnt, refs);
+    }
+    atomic_store(&last_ticket, ticket);
+
+    //one head update and one notification per subscriber for the whole batch
+    for (unsigned int i = 0; i < n; i++) {
+        cmd_sub_t *sub = active[i];
+        unsigned int head = atomic_load_explicit(&sub->head, memory_order_relaxed);
+        unsigned int tail = atomic_load_explicit(&sub->tail, memory_order_acquire);
+        unsigned int space = CMD_BUS_RING_LEN - (head - tail);
+        unsigned int put = 0;
+
+        for (int m = 0; m < cnt; m++) {
+            if (!(sub->cmd_mask & CMD_BIT(msgs[m]->id))) continue;
+            if (put < space) {
+                sub->ring[(head + put++) & (CMD_BUS_RING_LEN - 1)] = msgs[m];
+            } else {
+                //the tail of the batch that does not fit is dropped for this subscriber only
+                atomic_fetch_add(&sub->dropped, 1);
+                atomic_store(&msgs[m]->dropped, 1);
+                cmd_bus_release(msgs[m]);
+            }
+        }
+        if (put > 0) {
+            atomic_store_explicit(&sub->head, head + put, memory_order_release);
+            xTaskNotifyGive(sub->task);
+        }
+    }
+
+    xSemaphoreGive(publish_lock);
+
+    for (int m = 0; m < cnt; m++) cmd_bus_release(msgs[m]);
+    return first_ticket;
+}
+
+cmd_msg_t *cmd_bus_take(cmd_sub_t *sub, TickType_t wait) {
+    unsigned int tail = atomic_load_explicit(&sub->tail, memory_order_relaxed);
+
+    //notifications are counted, so a message pushed between the check and the take is never missed
+    while (atomic_load_explicit(&sub->head, memory_order_acquire) == tail) {
+        if (ulTaskNotifyTake(pdTRUE, wait) == 0) return NULL;
+    }
+
+    cmd_msg_t *msg = sub->ring[tail & (CMD_BUS_RING_LEN - 1)];
+    atomic_store_explicit(&sub->tail, tail + 1, memory_order_release);
+    return msg;
+}
+
+uint32_t cmd_bus_dropped_total(void) {
+    cmd_sub_t *active[CMD_BUS_MAX_SUBS];
+    unsigned int n = subs_snapshot(active);
+    uint32_t total = 0;
+    for (unsigned int i = 0; i < n; i++) total += atomic_load(&active[i]->dropped);
+    return total;
+}
+
+cmd_ticket_status_t cmd_bus_ticket_status(uint32_t ticket) {
+    uint32_t last = atomic_load(&last_ticket);
+
+    //only the last CMD_BUS_TICKET_HISTORY tickets are remembered
+    if (ticket == 0 || ticket > last || last - ticket >= CMD_BUS_TICKET_HISTORY) return CMD_TICKET_UNKNOWN;
+
+    unsigned int done = atomic_load(&done_tickets[ticket & (CMD_BUS_TICKET_HISTORY - 1)]);
+    if ((done >> 1) != ticket) return CMD_TICKET_PENDING;
+    return (done & 1) ? CMD_TICKET_DROPPED : CMD_TICKET_DONE;
+}
+
+const char *cmd_ticket_status_str(cmd_ticket_status_t st) {
+    switch (st) {
+    case CMD_TICKET_PENDING: return "pending";
+    case CMD_TICKET_DONE: return "done";
+    case CMD_TICKET_DROPPED: return "dropped";
+    default: return "unknown";
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+
+/*
+publish/subscribe bus for the commands posted to the web server.
+
+- messages live in a fixed buf_pool and are refcounted, the last subscriber to release a message returns it to the pool.
+- every subscriber owns a single producer/single consumer ring of message pointers, so a slow subscriber only fills
+its own ring (further messages are dropped for it) and never stalls the others.
+- the producer wakes a subscriber with a task notification, there is no global barrier.
+- commands are identified by a cmd_id_t resolved once at ingress, a subscriber only gets the ids in its mask.
+- publishers (the httpd and udp tasks) are serialized by a mutex, subscribers never take it.
+- every published message gets a ticket, its completion (all subscribers released it) is kept for the last
+CMD_BUS_TICKET_HISTORY tickets so clients can poll it.
+*/
+
+#define KEY_BUF_SIZE            50
+#define VAL_BUF_SIZE            50
+
+#define CMD_BUS_POOL_SIZE       8   //max 32, one bit per message in the free map
+#define CMD_BUS_RING_LEN        8   //must be a power of 2
+#define CMD_BUS_MAX_SUBS        4
+#define CMD_BUS_TICKET_HISTORY  32  //must be a power of 2
+
+typedef enum {
+    CMD_ID_NONE = 0,        //unknown key, never published
+    CMD_ID_TOGGLE,          //toggle=...
+    CMD_ID_STR,             //str=<string to print>
+    CMD_ID_LED_SET,         //led=1 (on) or led=0 (off), applied as is so a repeated cmd changes nothing
+    CMD_ID_CNT
+} cmd_id_t;
+
+#define CMD_BIT(id)             (1u << (id))
+
+typedef enum {
+    CMD_TICKET_UNKNOWN = 0,     //never issued or too old to be remembered
+    CMD_TICKET_PENDING,
+    CMD_TICKET_DONE,
+    CMD_TICKET_DROPPED,         //at least one subscriber ring was full
+} cmd_ticket_status_t;
+
+typedef struct {
+    cmd_id_t id;
+    char value[VAL_BUF_SIZE];
+    uint32_t ticket;
+    atomic_uint refcnt;
+    atomic_uint dropped;
+} cmd_msg_t;
+
+typedef struct {
+    cmd_msg_t *ring[CMD_BUS_RING_LEN];
+    atomic_uint head;       //only written by the producer
+    atomic_uint tail;       //only written by the subscriber
+    TaskHandle_t task;
+    uint32_t cmd_mask;      //CMD_BIT() of the ids this subscriber handles
+    atomic_uint dropped;    //messages lost because the ring was full
+} cmd_sub_t;
+
+void cmd_bus_init(void);
+
+/* register the calling task as a subscriber of the ids in cmd_mask, sub must stay valid forever */
+esp_err_t cmd_bus_subscribe(cmd_sub_t *sub, uint32_t cmd_mask);
+
+/* id of a form/api key, CMD_ID_NONE if no subscriber could handle it */
+cmd_id_t cmd_id_from_key(const char *key);
+
+/* get an empty message from the pool with one reference owned by the caller, NULL if the pool is empty */
+cmd_msg_t *cmd_bus_alloc(void);
+
+/* hand msg to every subscriber of msg->id without blocking, the caller's reference is consumed. returns the ticket of msg */
+uint32_t cmd_bus_publish(cmd_msg_t *msg);
+
+/* publish cnt messages with one ring update per subscriber, tickets are consecutive. returns the first ticket */
+uint32_t cmd_bus_publish_batch(cmd_msg_t **msgs, int cnt);
+
+/* next message for sub, blocks up to wait ticks, NULL on timeout. must be given back with cmd_bus_release */
+cmd_msg_t *cmd_bus_take(cmd_sub_t *sub, TickType_t wait);
+
+void cmd_bus_release(cmd_msg_t *msg);
+
+cmd_ticket_status_t cmd_bus_ticket_status(uint32_t ticket);
+
+/* messages lost by all subscribers because their ring was full */
+uint32_t cmd_bus_dropped_total(void);
+
+const char *cmd_ticket_status_str(cmd_ticket_status_t st);
@@ -0,0 +1,57 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "event_ring.h"
+
+static event_t ring[EVENT_RING_LEN];
+static uint32_t next_seq;
+static portMUX_TYPE ring_mux = portMUX_INITIALIZER_UNLOCKED;
+
+uint32_t event_ring_push(event_type_t type, const char *data, size_t len) {
+    if (len > EVENT_DATA_SIZE - 1) len = EVENT_DATA_SIZE - 1;
+
+    portENTER_CRITICAL(&ring_mux);
+    uint32_t seq = next_seq++;
+    event_t *e = &ring[seq & (EVENT_RING_LEN - 1)];
+    e->seq = seq;
+    e->type = type;
+    memcpy(e->data, data, len);
+    e->data[len] = '\0';
+    portEXIT_CRITICAL(&ring_mux);
+    return seq;
+}
+
+uint32_t event_ring_next_seq(void) {
+    portENTER_CRITICAL(&ring_mux);
+    uint32_t seq = next_seq;
+    portEXIT_CRITICAL(&ring_mux);
+    return seq;
+}
+
+uint32_t event_ring_oldest_seq(void) {
+    portENTER_CRITICAL(&ring_mux);
+    uint32_t seq = (next_seq > EVENT_RING_LEN) ? next_seq - EVENT_RING_LEN : 0;
+    portEXIT_CRITICAL(&ring_mux);
+    return seq;
+}
+
+bool event_ring_read(uint32_t seq, event_t *out) {
+    bool ok = false;
+
+    portENTER_CRITICAL(&ring_mux);
+    //the slot holds seq only while seq is one of the last EVENT_RING_LEN events
+    const event_t *e = &ring[seq & (EVENT_RING_LEN - 1)];
+    if (seq < next_seq && e->seq == seq) {
+        *out = *e;
+        ok = true;
+    }
+    portEXIT_CRITICAL(&ring_mux);
+    return ok;
+}
+
+const char *event_type_str(event_type_t type) {
+    switch (type) {
+    case EVENT_LED: return "led";
+    case EVENT_PRINT: return "print";
+    default: return "unknown";
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "cmd_bus.h"
+
+/*
+bounded ring of server events (led changes, printed strings) for the SSE stream.
+
+- any task may push, a push never blocks on readers: the oldest event is simply overwritten.
+- every event gets a sequence number, readers keep their own cursor and notice when they fell behind.
+- the critical section only covers copying one small event in or out of its slot.
+*/
+
+#define EVENT_RING_LEN          16  //must be a power of 2
+#define EVENT_DATA_SIZE         VAL_BUF_SIZE
+
+typedef enum {
+    EVENT_LED = 0,
+    EVENT_PRINT,
+} event_type_t;
+
+typedef struct {
+    uint32_t seq;
+    event_type_t type;
+    char data[EVENT_DATA_SIZE];     //always NUL terminated
+} event_t;
+
+/* copies at most EVENT_DATA_SIZE - 1 bytes of data, returns the sequence number of the event */
+uint32_t event_ring_push(event_type_t type, const char *data, size_t len);
+
+/* sequence number the next pushed event will get */
+uint32_t event_ring_next_seq(void);
+
+/* copy event seq into out, false if it was already overwritten or not pushed yet */
+bool event_ring_read(uint32_t seq, event_t *out);
+
+/* sequence number of the oldest event still in the ring */
+uint32_t event_ring_oldest_seq(void);
+
+const char *event_type_str(event_type_t type);
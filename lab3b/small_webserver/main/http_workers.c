@@ -0,0 +1,318 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include "http_workers.h"
+
+static const char *TAG = "HTTP_WORKERS";
+
+typedef struct {
+    http_job_t job;             //first member, a job pointer is its slot pointer
+    SemaphoreHandle_t lock;     //held while the job writes to the socket (never blocking), a close waits for it
+    bool in_use;
+    bool closed;                //the session went away, the job must not touch fd any more
+    bool held;                  //an older job of the same connection is pending, this one is queued once it ended
+    bool submitted;
+    uint32_t order;             //begin order, the oldest held job of a connection runs next
+    //response being sent, a job on the queue with out_len != 0 resumes the send instead of calling fn
+    uint16_t out_len;
+    uint16_t out_off;
+    const char *body;           //the part of the body that did not fit out
+    size_t body_len;
+    size_t body_off;
+    TickType_t deadline;        //the socket has to take a byte before this
+    char out[HTTP_JOB_OUT_SIZE];
+} pending_t;
+
+static pending_t pending[HTTP_PENDING_MAX];
+static int pending_cnt;
+static int pending_high;
+static uint32_t pending_order;
+static portMUX_TYPE pending_mux = portMUX_INITIALIZER_UNLOCKED;
+static QueueHandle_t job_q;
+static int idle_wait_fd = -1;       //fd the httpd task waits on, -1 when none
+static int idle_wait_below;         //it goes on once fd has fewer jobs open than this
+static TaskHandle_t idle_waiter;
+
+static esp_err_t send_step(pending_t *slot);
+
+static void http_worker(void *pvParameters) {
+    for (;;) {
+        http_job_t *job;
+        if (xQueueReceive(job_q, &job, portMAX_DELAY) != pdTRUE) continue;
+        if (((pending_t *)job)->out_len != 0) {
+            send_step((pending_t *)job);
+        } else {
+            job->fn(job);
+        }
+    }
+
+    vTaskDelete(NULL);
+}
+
+void http_workers_init(void) {
+    if (HTTP_WORKER_CNT == 0) return;
+
+    for (int i = 0; i < HTTP_PENDING_MAX; i++) {
+        pending[i].lock = xSemaphoreCreateMutex();
+        pending[i].in_use = false;
+    }
+    //one entry per pending slot and a slot is on the queue at most once, a submit or requeue never waits
+    job_q = xQueueCreate(HTTP_PENDING_MAX, sizeof(http_job_t *));
+
+    for (int i = 0; i < HTTP_WORKER_CNT; i++) {
+        if (xTaskCreatePinnedToCore(&http_worker, "http_worker", HTTP_WORKER_STACK, NULL, HTTP_WORKER_PRIO, NULL,
+                                    HTTP_WORKER_CORE) == pdPASS) {
+            ESP_LOGI(TAG, "http_worker %d created success", i);
+        }
+    }
+}
+
+/* jobs of the open connection fd, called with pending_mux held */
+static int fd_pending(int fd) {
+    int cnt = 0;
+    for (int i = 0; i < HTTP_PENDING_MAX; i++) {
+        if (pending[i].in_use && !pending[i].closed && pending[i].job.fd == fd) cnt++;
+    }
+    return cnt;
+}
+
+/* blocks the httpd task until fd has fewer than below jobs open */
+static void fd_wait(int fd, int below) {
+    for (;;) {
+        portENTER_CRITICAL(&pending_mux);
+        bool wait = fd_pending(fd) >= below;
+        if (wait) {
+            idle_wait_fd = fd;
+            idle_wait_below = below;
+            idle_waiter = xTaskGetCurrentTaskHandle();
+        }
+        portEXIT_CRITICAL(&pending_mux);
+        if (!wait) return;
+
+        //bounded by HTTP_JOB_SEND_TIMEOUT_MS per pending job, like an inline send to this client; a stale notify
+        //just loops
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+http_job_t *http_job_begin(httpd_req_t *req) {
+    if (job_q == NULL) return NULL;
+
+    int fd = httpd_req_to_sockfd(req);
+    pending_t *slot = NULL;
+
+    //the slots a slow reader's pipeline does not get are left for the other clients
+    fd_wait(fd, HTTP_PENDING_PER_FD);
+
+    portENTER_CRITICAL(&pending_mux);
+    for (int i = 0; i < HTTP_PENDING_MAX && slot == NULL; i++) {
+        if (!pending[i].in_use) slot = &pending[i];
+    }
+    if (slot != NULL) {
+        //a pipelined request queues behind the one before it instead of holding httpd
+        slot->held = fd_pending(fd) > 0;
+        slot->in_use = true;
+        slot->closed = false;
+        slot->submitted = false;
+        slot->order = ++pending_order;
+        slot->job.fd = fd;
+        if (++pending_cnt > pending_high) pending_high = pending_cnt;
+    }
+    portEXIT_CRITICAL(&pending_mux);
+
+    if (slot == NULL) return NULL;
+    slot->job.hd = req->handle;
+    slot->job.fn = NULL;
+    slot->job.start_us = 0;
+    slot->job.arg = 0;
+    slot->job.val = 0;
+    slot->job.data = NULL;
+    slot->job.len = 0;
+    slot->out_len = 0;
+    return &slot->job;
+}
+
+void http_job_submit(http_job_t *job, http_job_fn_t fn) {
+    pending_t *slot = (pending_t *)job;
+    job->fn = fn;
+
+    portENTER_CRITICAL(&pending_mux);
+    slot->submitted = true;
+    bool held = slot->held;
+    portEXIT_CRITICAL(&pending_mux);
+
+    //a held job is queued by the job before it when that one ends
+    if (!held) xQueueSendToBack(job_q, &job, 0);
+}
+
+/* release the oldest held job of fd, returns it when it must be queued now. called with pending_mux held */
+static pending_t *release_next(int fd) {
+    pending_t *next = NULL;
+    for (int i = 0; i < HTTP_PENDING_MAX; i++) {
+        pending_t *p = &pending[i];
+        if (p->in_use && p->held && p->job.fd == fd && (next == NULL || (int32_t)(p->order - next->order) < 0)) {
+            next = p;
+        }
+    }
+    if (next == NULL) return NULL;
+    next->held = false;
+    //not submitted yet, http_job_submit queues it
+    return next->submitted ? next : NULL;
+}
+
+void http_job_end(http_job_t *job) {
+    pending_t *slot = (pending_t *)job;
+    TaskHandle_t waiter = NULL;
+    pending_t *next = NULL;
+
+    portENTER_CRITICAL(&pending_mux);
+    slot->in_use = false;
+    pending_cnt--;
+    //a held job that ends (its session closed) was not the one its successors wait for
+    if (!slot->held && !slot->closed) next = release_next(job->fd);
+    if (job->fd == idle_wait_fd && fd_pending(job->fd) < idle_wait_below) {
+        waiter = idle_waiter;
+        idle_wait_fd = -1;
+    }
+    portEXIT_CRITICAL(&pending_mux);
+
+    if (next != NULL) {
+        http_job_t *next_job = &next->job;
+        xQueueSendToBack(job_q, &next_job, 0);
+    }
+    if (waiter != NULL) xTaskNotifyGive(waiter);
+}
+
+/*
+writes what the socket takes without blocking. true when the response is out or the job must go on later,
+false when it has to be dropped. called with the slot lock held
+*/
+static bool send_some(pending_t *slot, bool *done) {
+    http_job_t *job = &slot->job;
+    *done = false;
+
+    while (slot->out_off < slot->out_len || slot->body_off < slot->body_len) {
+        const char *buf;
+        size_t len;
+        if (slot->out_off < slot->out_len) {
+            buf = slot->out + slot->out_off;
+            len = slot->out_len - slot->out_off;
+        } else {
+            buf = slot->body + slot->body_off;
+            len = slot->body_len - slot->body_off;
+        }
+
+        int ret = httpd_socket_send(job->hd, job->fd, buf, len, MSG_DONTWAIT);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT) return (int32_t)(xTaskGetTickCount() - slot->deadline) < 0;
+        if (ret <= 0) return false;
+
+        if (slot->out_off < slot->out_len) {
+            slot->out_off += ret;
+        } else {
+            slot->body_off += ret;
+        }
+        slot->deadline = xTaskGetTickCount() + pdMS_TO_TICKS(HTTP_JOB_SEND_TIMEOUT_MS);
+    }
+    *done = true;
+    return true;
+}
+
+/* one more round of the send, the job ends when it is done or dropped and goes back on the queue otherwise */
+static esp_err_t send_step(pending_t *slot) {
+    http_job_t *job = &slot->job;
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    bool done = true;
+
+    xSemaphoreTake(slot->lock, portMAX_DELAY);
+    if (!slot->closed) err = send_some(slot, &done) ? ESP_OK : ESP_FAIL;
+    xSemaphoreGive(slot->lock);
+
+    if (err == ESP_OK && !done) {
+        //nothing else to do, give the client a tick to read before the next try
+        if (uxQueueMessagesWaiting(job_q) == 0) vTaskDelay(1);
+        xQueueSendToBack(job_q, &job, 0);
+        return ESP_OK;
+    }
+
+    //a dropped or half sent response leaves the connection unusable
+    if (err == ESP_FAIL) {
+        ESP_LOGD(TAG, "response to fd %d dropped", job->fd);
+        httpd_sess_trigger_close(job->hd, job->fd);
+    }
+    slot->out_len = 0;
+    http_job_end(job);
+    return err;
+}
+
+esp_err_t http_job_send(http_job_t *job, const char *status, const char *type, const char *hdrs, const char *body,
+                        size_t len) {
+    pending_t *slot = (pending_t *)job;
+
+    int hdr_len = snprintf(slot->out, sizeof(slot->out),
+                           "HTTP/1.1 %s\r\nContent-Type: %s\r\n%sContent-Length: %u\r\n\r\n", status, type,
+                           (hdrs != NULL) ? hdrs : "", (unsigned int)len);
+    if (hdr_len >= (int)sizeof(slot->out)) {
+        ESP_LOGI(TAG, "response header of %d bytes does not fit", hdr_len);
+        httpd_sess_trigger_close(job->hd, job->fd);
+        http_job_end(job);
+        return ESP_FAIL;
+    }
+
+    //a short body goes with the header, the caller's buffer may be gone before the socket takes it
+    size_t copy = (len <= sizeof(slot->out) - hdr_len) ? len : 0;
+    if (copy > 0) memcpy(slot->out + hdr_len, body, copy);
+    slot->out_len = hdr_len + copy;
+    slot->out_off = 0;
+    slot->body = body;
+    slot->body_len = len - copy;
+    slot->body_off = 0;
+    slot->deadline = xTaskGetTickCount() + pdMS_TO_TICKS(HTTP_JOB_SEND_TIMEOUT_MS);
+    return send_step(slot);
+}
+
+void http_workers_wait_fd(int fd) {
+    if (job_q == NULL) return;
+    fd_wait(fd, 1);
+}
+
+void http_workers_sess_closed(int fd) {
+    if (job_q == NULL) return;
+
+    for (int i = 0; i < HTTP_PENDING_MAX; i++) {
+        pending_t *slot = &pending[i];
+        portENTER_CRITICAL(&pending_mux);
+        bool match = slot->in_use && !slot->closed && slot->job.fd == fd;
+        portEXIT_CRITICAL(&pending_mux);
+        if (!match) continue;
+
+        //waits for a send in progress (it never blocks), after that the job sees closed and leaves fd alone
+        xSemaphoreTake(slot->lock, portMAX_DELAY);
+        http_job_t *job = NULL;
+        portENTER_CRITICAL(&pending_mux);
+        if (slot->in_use && slot->job.fd == fd) {
+            slot->closed = true;
+            //a held job runs now, it only finds its session gone and ends
+            if (slot->held) {
+                slot->held = false;
+                if (slot->submitted) job = &slot->job;
+            }
+        }
+        portEXIT_CRITICAL(&pending_mux);
+        xSemaphoreGive(slot->lock);
+        if (job != NULL) xQueueSendToBack(job_q, &job, 0);
+    }
+}
+
+int http_workers_pending(int *high_water) {
+    portENTER_CRITICAL(&pending_mux);
+    int cnt = pending_cnt;
+    *high_water = pending_high;
+    portEXIT_CRITICAL(&pending_mux);
+    return cnt;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+/*
+worker pool that runs http requests off the httpd task.
+
+- the httpd task only reads what a request needs (headers, path parameters, a body that fits an io block), then
+detaches the rest (parsing the body, publishing cmds, rendering, sending the response) as a job and goes on
+serving other clients.
+- jobs run on HTTP_WORKER_CNT tasks, optionally pinned to one core. a response is written to the socket without
+blocking: when the socket buffer is full the job goes back to the end of the queue and resumes where it stopped,
+so a slow reader never holds a worker or httpd. one that takes no byte for HTTP_JOB_SEND_TIMEOUT_MS is dropped,
+like httpd drops it after its send_wait_timeout.
+- a bounded table of pending jobs replaces "one request at a time": when it is full the request is answered
+inline on the httpd task.
+- responses on one connection leave in request order: a job begun while an older one of the same connection is
+pending is held until that one ended. one connection has at most HTTP_PENDING_PER_FD jobs open, a pipelined
+request past that waits in http_job_begin() for the oldest to end, so a slow reader keeps no more slots than that
+and holds httpd only while its own response drains. a request answered inline calls http_workers_wait_fd() first.
+those are the only places httpd waits for a worker, at most as long as an inline send to the same client would
+have blocked it.
+- every job remembers its session fd, http_workers_sess_closed() (from the httpd close_fn) makes sure a job never
+writes into a socket that was closed and reused for another client.
+- HTTP_WORKER_CNT 0 turns the pool off, http_job_begin then always returns NULL.
+*/
+
+#ifndef HTTP_WORKER_CNT
+#define HTTP_WORKER_CNT         2
+#endif
+#define HTTP_WORKER_CORE        1       //core the workers are pinned to, tskNO_AFFINITY to let them float
+#define HTTP_WORKER_PRIO        5       //same as the httpd task
+#define HTTP_WORKER_STACK       4096    //runs the handler work httpd ran, same as the httpd stack
+#define HTTP_PENDING_MAX        4       //jobs queued, held or running
+#define HTTP_PENDING_PER_FD     2       //of those one connection may have open
+#define HTTP_JOB_OUT_SIZE       192     //response header, and the body when it fits, copied into the job
+#define HTTP_JOB_SEND_TIMEOUT_MS 5000   //httpd's default send_wait_timeout
+
+typedef struct http_job http_job_t;
+
+typedef void (*http_job_fn_t)(http_job_t *job);
+
+struct http_job {
+    httpd_handle_t hd;
+    int fd;
+    http_job_fn_t fn;
+    int64_t start_us;       //when the handler was entered, for the metrics of the detached part
+    int arg;                //arg, val, data and len are free for the job function
+    uint32_t val;
+    void *data;
+    size_t len;
+};
+
+void http_workers_init(void);
+
+/*
+reserve a pending slot for req, NULL when the pool is off or full (the caller then answers inline).
+waits first while the connection already has HTTP_PENDING_PER_FD jobs open
+*/
+http_job_t *http_job_begin(httpd_req_t *req);
+
+/* queue the job, fn runs on a worker and must finish with http_job_send or http_job_end */
+void http_job_submit(http_job_t *job, http_job_fn_t fn);
+
+/*
+send a complete response with Content-Length and end the job, job is invalid afterwards.
+status like "200 OK", hdrs NULL or extra "Name: value\r\n" lines, body may be NULL when len is 0. header and body
+are copied into the job when they fit HTTP_JOB_OUT_SIZE, a longer body must outlive the job (flash).
+ESP_OK once the response is out or queued behind a full socket buffer, ESP_ERR_INVALID_STATE if the session is
+already gone, ESP_FAIL when the response was dropped and the session closed.
+*/
+esp_err_t http_job_send(http_job_t *job, const char *status, const char *type, const char *hdrs, const char *body,
+                        size_t len);
+
+/* end the job without a response, job is invalid afterwards */
+void http_job_end(http_job_t *job);
+
+/* call from the httpd task before answering a request on fd inline, returns once fd has no job pending */
+void http_workers_wait_fd(int fd);
+
+/* call from the httpd close_fn before closing fd */
+void http_workers_sess_closed(int fd);
+
+/* jobs pending right now and the most ever pending at once */
+int http_workers_pending(int *high_water);
@@ -1,4 +1,9 @@
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 #include "esp_system.h"
@@ -8,43 +13,42 @@
 #include "nvs_flash.h"
 #include "esp_http_server.h"
 #include "esp_netif.h"
+#include "esp_timer.h"
+#include "hal/cpu_hal.h"
 
 #include "lwip/err.h"
 #include "lwip/sys.h"
+#include "lwip/sockets.h"
 
 #include "driver/gpio.h"
 
-#define KEY_BUF_SIZE            50
-#define VAL_BUF_SIZE            50
-
-typedef struct {
-    char key[KEY_BUF_SIZE];
-    char value[VAL_BUF_SIZE];
-} key_value_t;
+#include "form_parser.h"
+#include "obj_codec.h"
+#include "route_trie.h"
+#include "cmd_bus.h"
+#include "metrics.h"
+#include "buf_pool.h"
+#include "admission.h"
+#include "event_ring.h"
+#include "http_workers.h"
+#include "udp_ctrl.h"
 
 /* a TAG to used when log to screen */
 static const char *WIFI_TAG = "WIFI_AP";
 static const char *HTTP_TAG = "HTTP_SERVER";
-static const char *QUEUE_TAG = "QUEUE";
+static const char *BUS_TAG = "CMD_BUS";
 static const char *LED_TAG = "LED_HANDLER";
 static const char *PRINT_TAG = "PRINT_HANDLER";
-static const char *GARBAGE_COLLECTOR_TAG = "GARBAGE_COLLECTOR";
 
 /*================= GPIO DEF =================*/
 #define BUILTIN_LED_PIN     GPIO_NUM_2
 
 uint8_t led_st = 1;
 
-/*================= QUEUE DEF =================*/
-#define QUEUE_MAX_LEN    5
-
-QueueHandle_t q;
-
 /*================= TASKS DEF =================*/
-#define PEEK_LED_TASK_BIT       BIT0
-#define PEEK_PRINT_TASK_BIT     BIT1
-#define ALL_TASKS_CONTINUE      BIT2
-static EventGroupHandle_t tasks_event_group;
+//every handler task has its own ring on the cmd bus
+static cmd_sub_t led_sub;
+static cmd_sub_t print_sub;
 
 /*================= WIFI AP DEF =================*/
 #define WIFI_SSID       "esp32"
@@ -60,47 +64,201 @@ esp_netif_ip_info_t ip_info;
 
 /*================= HTTP SERVER DEF =================*/
 #define SIMPLE_SERVER_PORT      80
-#define RESP_BUF_SIZE           500
-#define REQ_BUF_SIZE            50
+//esp-idf default, keep it until httpd_stack_free_min_bytes was read on a board under load (loadgen, /ws, sse)
+#define HTTPD_STACK_SIZE        4096
+#define TICKET_RESP_SIZE        64
+#define CMD_BATCH_MAX           CMD_BUS_POOL_SIZE   //pairs decoded before one bulk publish
+
+/*
+request/response buffers come from fixed-block pools instead of the httpd stack.
+io blocks back body receive chunks, the bodies of detached requests and the /metrics writer, ctx blocks back the
+per request cmd batch.
+*/
+#define IO_BUF_SIZE             512
+#define IO_BUF_CNT              (HTTP_PENDING_MAX + 2)  //a body per pending job, the inline handler and /metrics
+#define CMD_CTX_CNT             (HTTP_WORKER_CNT + 1)   //one per worker and one for the httpd task
+
+BUF_POOL_DEFINE(io_pool, IO_BUF_SIZE, IO_BUF_CNT);
 
 httpd_handle_t simple_server;
 
+/*================= ROUTER DEF =================*/
+/*
+uris are resolved by a route trie (components/route_trie) built at boot from route_defs[], see ROUTER.
+path parameters of the request being handled stay in route_match, only the httpd task touches it.
+*/
+static route_match_t route_match;
+
+/* copy path parameter i of the current request into buf, false if it is missing or too long */
+bool route_param(int i, char *buf, size_t size);
+
+/*================= REST API DEF =================*/
+/*
+machine clients use /api instead of the form interface and get a few bytes back instead of the page:
+GET /api/led -> {"on":true}, PUT /api/led {"on":false} -> {"on":false,"ticket":7}, POST /api/print {"str":"hi"} -> {"ticket":8}
+bodies and responses are JSON, or CBOR when the request says so in Content-Type / Accept.
+*/
+#define API_RESP_SIZE           32
+#define API_HDR_SIZE            128     //Accept / Content-Type value, on the httpd stack
+#define API_BODY_SIZE           IO_BUF_SIZE     //request bodies are received into an io block
+
+/*================= WEBSOCKET DEF =================*/
+/*
+compact control frames on /ws, first byte is the opcode:
+client -> server: 'T' toggle led, 'S'<string> print string, '?' ask for the led state
+server -> client: 'L' followed by '1' (led on) or '0' (led off), pushed to every client when the led changes,
+                  'B' when a cmd was refused by admission control or the bus is full
+*/
+#define WS_MAX_CLIENTS          4
+#define WS_FRAME_MAX            VAL_BUF_SIZE    //opcode + string, the string still fits msg->value with its NUL
+
+#define WS_OP_TOGGLE            'T'
+#define WS_OP_STR               'S'
+#define WS_OP_GET_LED           '?'
+#define WS_OP_LED_STATE         'L'
+#define WS_OP_BUSY              'B'     //server -> client: cmd not accepted (throttled or no free bus message)
+
+static atomic_int ws_fds[WS_MAX_CLIENTS];   //-1 means free slot
+
+void ws_push_led_state(void);
+
+/*================= SSE DEF =================*/
+/*
+GET /events streams led changes and printed strings as text/event-stream from the event ring.
+after the response header the socket is left idle in httpd, events are written to it raw from the httpd task
+with MSG_DONTWAIT. a client whose socket is full keeps the rest of its event in out and resumes on the next flush,
+events overwritten in the meantime are skipped. the led and print tasks only push to the ring and never wait.
+*/
+#define SSE_MAX_CLIENTS         3
+#define SSE_OUT_SIZE            160     //response header + first event, or one event
+#define SSE_RETRY_MS            2000    //browser reconnect delay after the stream is closed
+
+typedef struct {
+    int fd;                 //-1 means free slot
+    uint32_t next_seq;      //next event to format
+    uint16_t out_len;
+    uint16_t out_off;       //bytes of out already sent
+    char out[SSE_OUT_SIZE];
+} sse_client_t;
+
+static sse_client_t sse_clients[SSE_MAX_CLIENTS];  //only touched from the httpd task
+static atomic_bool sse_flush_queued;
+
+void sse_publish(event_type_t type, const char *data, size_t len);
+
+/*================= STATIC ASSETS DEF =================*/
+/*
+files gzip'ed and embedded by main/CMakeLists.txt, served as is from flash with Content-Encoding: gzip.
+the strong ETag is a hash of the compressed body, so a matching If-None-Match gets an empty 304.
+*/
+#define ETAG_SIZE               12  //quoted 8 hex digits + NUL
+#define STATIC_HDR_SIZE         128 //request header values, browsers send long Accept-Encoding lists
+
+typedef struct {
+    const char *uri;
+    const char *type;
+    const uint8_t *start;
+    const uint8_t *end;
+    char etag[ETAG_SIZE];
+} static_asset_t;
+
+extern const uint8_t test_html_gz_start[] asm("_binary_test_html_gz_start");
+extern const uint8_t test_html_gz_end[] asm("_binary_test_html_gz_end");
+
+static static_asset_t static_assets[] = {
+    { .uri = "/test.html", .type = "text/html", .start = test_html_gz_start, .end = test_html_gz_end },
+};
+#define STATIC_ASSET_CNT        ((int)(sizeof(static_assets) / sizeof(static_assets[0])))
+
+/*================= INDEX PAGE CACHE DEF =================*/
+/*
+the index page only depends on the led state, so both variants are built at compile time
+by string literal concatenation and live in flash with their length.
+toggle_led() flips index_page_cur, handlers send the current variant as is: no rendering, no strlen.
+*/
+#define INDEX_PAGE_HEAD \
+    "<head>\n" \
+    "<title>ESP32 control</title>\n" \
+    "<style>\n" \
+    ".circle {\n" \
+    "height: 50px;\n" \
+    "width: 50px;\n"
+
+#define INDEX_PAGE_TAIL \
+    "border-radius: 50%;\n" \
+    "}\n" \
+    "</style>\n" \
+    "</head>\n" \
+    "<body>\n" \
+    "<h2>ESP32 control</h2>\n" \
+    "<form action=\"/\" method=\"post\">\n" \
+    "<input type=\"submit\" id=\"toggle\" name=\"toggle\" value=\"toggleled\">\n" \
+    "</form>\n" \
+    "<form action=\"/\" method=\"post\">\n" \
+    "<input type=\"text\" id=\"str\" name=\"str\">\n" \
+    "<input type=\"submit\" value=\"send string\">\n" \
+    " </form>\n" \
+    "</body>" \
+    "</html>\n"
+
+#define INDEX_PAGE_LED_ON       INDEX_PAGE_HEAD "background-color: #ffff00;\n" INDEX_PAGE_TAIL
+#define INDEX_PAGE_LED_OFF      INDEX_PAGE_HEAD "background-color: #555;\n" INDEX_PAGE_TAIL
+
+typedef struct {
+    const char *body;
+    size_t len;
+} index_page_t;
+
+//indexed by led_st, the led is active low: 0 means ON
+static const index_page_t index_pages[2] = {
+    { .body = INDEX_PAGE_LED_ON, .len = sizeof(INDEX_PAGE_LED_ON) - 1 },
+    { .body = INDEX_PAGE_LED_OFF, .len = sizeof(INDEX_PAGE_LED_OFF) - 1 },
+};
+
+static const index_page_t *_Atomic index_page_cur = &index_pages[1];
+
 
 /*================= GPIO =================*/
 void gpio_init(void) {
     gpio_set_direction(BUILTIN_LED_PIN, GPIO_MODE_OUTPUT);
     //gpio_set_pull_mode(BUILTIN_LED_PIN, GPIO_PULLUP_ONLY);
     gpio_set_level(BUILTIN_LED_PIN, led_st);
+    atomic_store_explicit(&index_page_cur, &index_pages[led_st], memory_order_release);
 }
 
 /*================= APP TASKS =================*/
 void toggle_led(void) {
     led_st = !led_st;
     gpio_set_level(BUILTIN_LED_PIN, led_st);
+    atomic_store_explicit(&index_page_cur, &index_pages[led_st], memory_order_release);
     ESP_LOGI(LED_TAG, "LED state %s", led_st == 0 ? "ON" : "OFF");
+    ws_push_led_state();
+    sse_publish(EVENT_LED, (led_st == 0) ? "1" : "0", 1);
+}
+
+/* only the led task changes led_st, so comparing against it here is not racy */
+void set_led(bool on) {
+    //active low, led_st == 0 means ON
+    if (on != (led_st == 0)) toggle_led();
 }
 
 void led_handler(void *pvParameters) {
-    key_value_t recv_pkt;
+    //the bus only delivers the ids in the mask, the key was resolved once at ingress
+    cmd_bus_subscribe(&led_sub, CMD_BIT(CMD_ID_TOGGLE) | CMD_BIT(CMD_ID_LED_SET));
 
     for (;;) {
-        //get cmd pkt from the queue
-        if (q == 0) continue;
-        //wake up only there is a cmd pkt in the queue, else waiting forever
-        //peek to see if the pkt is for this task, not removed from the queue yet
-        if (xQueuePeek(q, (void *)&recv_pkt, portMAX_DELAY) != pdPASS) continue;
-
-        //sync point
-        xEventGroupSync(tasks_event_group, PEEK_LED_TASK_BIT, ALL_TASKS_CONTINUE, portMAX_DELAY);
-        xEventGroupClearBits(tasks_event_group, ALL_TASKS_CONTINUE);
-
-        //check if the pkt is not for this task
-        if (strcmp(recv_pkt.key, "toggle") != 0) {
-            continue;
+        //wake up only there is a cmd pkt in this task's ring, else waiting forever
+        cmd_msg_t *msg = cmd_bus_take(&led_sub, portMAX_DELAY);
+        if (msg == NULL) continue;
+
+        if (msg->id == CMD_ID_TOGGLE) {
+            toggle_led();
+        } else if (msg->id == CMD_ID_LED_SET) {
+            set_led(msg->value[0] == '1');
         }
 
-        //do sth
-        toggle_led();
+        //drop this task's reference, the last one frees the pkt
+        cmd_bus_release(msg);
     }
 
     vTaskDelete(NULL);
@@ -111,70 +269,38 @@ void print_str(char *buf) {
 }
 
 void print_handler(void *pvParameters) {
-    key_value_t recv_pkt;
+    cmd_bus_subscribe(&print_sub, CMD_BIT(CMD_ID_STR));
 
     for (;;) {
-        //get cmd pkt from the queue
-        if (q == 0) continue;
-        //wake up only there is a cmd pkt in the queue, else waiting forever
-        //peek to see if the pkt is for this task, not removed from the queue yet
-        if (xQueuePeek(q, (void *)&recv_pkt, portMAX_DELAY) != pdPASS) continue;
-
-        //sync point
-        xEventGroupSync(tasks_event_group, PEEK_PRINT_TASK_BIT, ALL_TASKS_CONTINUE, portMAX_DELAY);
-        xEventGroupClearBits(tasks_event_group, ALL_TASKS_CONTINUE);
-
-        //check if the pkt is not for this task
-        if (strcmp(recv_pkt.key, "str") != 0) {
-            continue;
-        }
+        //wake up only there is a cmd pkt in this task's ring, else waiting forever
+        cmd_msg_t *msg = cmd_bus_take(&print_sub, portMAX_DELAY);
+        if (msg == NULL) continue;
 
-        //do sth
-        print_str(recv_pkt.value);
-    }
-
-    vTaskDelete(NULL);
-}
-
-void garbage_collector(void *pvParameters) {
-    key_value_t recv_pkt;
+        if (msg->id == CMD_ID_STR) {
+            print_str(msg->value);
+            sse_publish(EVENT_PRINT, msg->value, strlen(msg->value));
+        }
 
-    for (;;) {
-        //if the pkt is not for other functional tasks
-        xEventGroupWaitBits(tasks_event_group, PEEK_LED_TASK_BIT | PEEK_PRINT_TASK_BIT, pdTRUE, pdTRUE, portMAX_DELAY);
-        xQueueReceive(q, (void *)&recv_pkt, portMAX_DELAY);
-        ESP_LOGI(GARBAGE_COLLECTOR_TAG, "garbage collected");
-        xEventGroupSetBits(tasks_event_group, ALL_TASKS_CONTINUE);
+        //drop this task's reference, the last one frees the pkt
+        cmd_bus_release(msg);
     }
 
     vTaskDelete(NULL);
 }
 
 void tasks_init(void) {
-    tasks_event_group = xEventGroupCreate();
-
     if (xTaskCreate(&led_handler, "led_handler", 1024 * 2, NULL, 0, NULL) == pdPASS) {
         ESP_LOGI(LED_TAG, "led_handler created success");
     }
     if (xTaskCreate(&print_handler, "print_handler", 1024 * 2, NULL, 0, NULL) == pdPASS) {
         ESP_LOGI(PRINT_TAG, "print_handler created success");
     }
-    if (xTaskCreate(&garbage_collector, "garbage_collector", 1024 * 2, NULL, 0, NULL) == pdPASS) {
-        ESP_LOGI(GARBAGE_COLLECTOR_TAG, "garbage_collector created success");
-    }
 }
 
-/*================= QUEUE =================*/
-void queue_init(void) {
-    q = xQueueCreate(QUEUE_MAX_LEN, sizeof(key_value_t));
-    ESP_LOGI(QUEUE_TAG, "data size = %d", sizeof(key_value_t));
-    while (q == 0) {
-        ESP_LOGI(QUEUE_TAG, "q created failed");
-        q = xQueueCreate(QUEUE_MAX_LEN, sizeof(key_value_t));
-    }
-
-    xQueueReset(q);
-    ESP_LOGI(QUEUE_TAG, "q created success");
+/*================= CMD BUS =================*/
+void bus_init(void) {
+    cmd_bus_init();
+    ESP_LOGI(BUS_TAG, "data size = %d, pool = %d, ring = %d", sizeof(cmd_msg_t), CMD_BUS_POOL_SIZE, CMD_BUS_RING_LEN);
 }
 
 /*================= WIFI AP =================*/
@@ -251,133 +377,1173 @@ void wifi_init_ap(void) {
 }
 
 /*================= HTTP server =================*/
-key_value_t extract_content(char *buf, int buf_len) {
-    key_value_t ret;
-
-    //extract key
-    int i;
-    for (i = 0; buf[i] != '='; i++) {
-        ret.key[i] = buf[i];
-    }
-    ret.key[i] = '\0';
-    i++; //skip =
-
-    //extract value
-    int key_len = i;
-    for (; i < buf_len; i++) {
-        if (buf[i] == '+') ret.value[i - key_len] = ' ';
-        else ret.value[i - key_len] = buf[i];
-    }
-    ret.value[i - key_len] = '\0';
-
-    return ret;
-}
-
-int gen_index_page(char *buf) {
-    strcat(buf, ""); //THIS BUF MUST BE CLEAR. IF NOT, THE INITIAL CONTENT IS UNKNOWN WHICH CAUSE UNEXPECTED CHARACTERS
-    strcat(buf, "<head>\n");
-    strcat(buf, "<title>ESP32 control</title>\n");
-    strcat(buf, "<style>\n");
-    strcat(buf, ".circle {\n");
-    strcat(buf, "height: 50px;\n");
-    strcat(buf, "width: 50px;\n");
-    strcat(buf, (led_st == 0) ? "background-color: #ffff00;\n" : "background-color: #555;\n");
-    strcat(buf, "border-radius: 50%;\n");
-    strcat(buf, "}\n");
-    strcat(buf, "</style>\n");
-    strcat(buf, "</head>\n");
-    strcat(buf, "<body>\n");
-    strcat(buf, "<h2>ESP32 control</h2>\n");
-    strcat(buf, "<form action=\"/\" method=\"post\">\n");
-    //strcat(buf, "<div class=\"circle\"></div>\n");
-    strcat(buf, "<input type=\"submit\" id=\"toggle\" name=\"toggle\" value=\"toggleled\">\n");
-    strcat(buf, "</form>\n");
-    strcat(buf, "<form action=\"/\" method=\"post\">\n");
-    strcat(buf, "<input type=\"text\" id=\"str\" name=\"str\">\n");
-    strcat(buf, "<input type=\"submit\" value=\"send string\">\n");
-    strcat(buf, " </form>\n");
-    strcat(buf, "</body>");
-    strcat(buf, "</html>\n");
-    return (int)strlen(buf);
+typedef struct {
+    form_parser_t parser;
+    cmd_msg_t *msg;         //bus message the parser decodes values into, NULL when the pool is empty
+    char key[KEY_BUF_SIZE]; //keys are only needed until they are resolved to a cmd id
+    char scratch[VAL_BUF_SIZE];     //fallback value storage so the body is still consumed when the pool is empty
+    cmd_msg_t *batch[CMD_BATCH_MAX];    //decoded pairs waiting for the bulk publish
+    int batch_len;
+    uint32_t client;        //ipv4 address of the client, key of its admission bucket
+    uint32_t first_ticket;
+    int published;
+    int dropped;            //admitted but no free bus message
+    int throttled;          //refused by admission control
+} cmd_req_ctx_t;
+
+BUF_POOL_DEFINE(cmd_ctx_pool, sizeof(cmd_req_ctx_t), CMD_CTX_CNT);
+
+void buf_pools_init(void) {
+    buf_pool_init(&io_pool);
+    buf_pool_init(&cmd_ctx_pool);
+}
+
+/* a pool ran dry, the client may retry shortly */
+esp_err_t send_busy(httpd_req_t *req) {
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_hdr(req, "Retry-After", "1");
+    return httpd_resp_send(req, NULL, 0);
+}
+
+/* the client used up its admission tokens, tell it when the next one is due */
+esp_err_t send_throttled(httpd_req_t *req, uint32_t client) {
+    char retry_after[12];
+    snprintf(retry_after, sizeof(retry_after), "%u", (unsigned int)admission_retry_after(client));
+    httpd_resp_set_status(req, "429 Too Many Requests");
+    httpd_resp_set_hdr(req, "Retry-After", retry_after);
+    return httpd_resp_send(req, NULL, 0);
+}
+
+/*
+whole body of at most IO_BUF_SIZE bytes into an io block, nothing is sent.
+ESP_ERR_NO_MEM when the pool is empty, ESP_ERR_TIMEOUT when the client stalled, ESP_FAIL when it went away.
+*/
+esp_err_t body_recv(httpd_req_t *req, char **body, size_t *len) {
+    char *buf = (char *)buf_pool_get(&io_pool);
+    if (buf == NULL) return ESP_ERR_NO_MEM;
+
+    size_t got = 0;
+    while (got < req->content_len) {
+        int ret = httpd_req_recv(req, buf + got, req->content_len - got);
+        if (ret <= 0) {
+            buf_pool_put(&io_pool, buf);
+            return (ret == HTTPD_SOCK_ERR_TIMEOUT) ? ESP_ERR_TIMEOUT : ESP_FAIL;
+        }
+        got += ret;
+    }
+    *body = buf;
+    *len = got;
+    return ESP_OK;
+}
+
+/* ipv4 address of the peer of fd, 0 if unknown */
+uint32_t sock_client_ip(int fd) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    uint32_t ip = 0;
+
+    if (getpeername(fd, (struct sockaddr *)&addr, &addr_len) != 0) return 0;
+    if (addr.ss_family == AF_INET) {
+        ip = ((struct sockaddr_in *)&addr)->sin_addr.s_addr;
+    } else if (addr.ss_family == AF_INET6) {
+        //the server socket is ipv6, ipv4 clients show up as v4-mapped addresses ending with the ipv4 address
+        memcpy(&ip, &((struct sockaddr_in6 *)&addr)->sin6_addr.s6_addr[12], sizeof(ip));
+    }
+    return ip;
+}
+
+/* publish every decoded pair of the batch in one go */
+void cmd_req_flush(cmd_req_ctx_t *ctx) {
+    if (ctx->batch_len == 0) return;
+
+    //never blocks, the handler tasks complete the tickets later
+    uint32_t ticket = cmd_bus_publish_batch(ctx->batch, ctx->batch_len);
+    if (ctx->published == 0) ctx->first_ticket = ticket;
+    ctx->published += ctx->batch_len;
+    ctx->batch_len = 0;
+    ESP_LOGD(HTTP_TAG, "publish pkts to bus success, tickets from %u", ticket);
+}
+
+/* give the parser a fresh bus message to decode the next pair into */
+void cmd_req_next_msg(cmd_req_ctx_t *ctx) {
+    ctx->msg = cmd_bus_alloc();
+    //the pending batch may be holding the last free messages
+    if (ctx->msg == NULL && ctx->batch_len > 0) {
+        cmd_req_flush(ctx);
+        ctx->msg = cmd_bus_alloc();
+    }
+    char *value = (ctx->msg != NULL) ? ctx->msg->value : ctx->scratch;
+    form_parser_set_storage(&ctx->parser, ctx->key, KEY_BUF_SIZE, value, VAL_BUF_SIZE);
+}
+
+/* called by the form parser for every key=value pair of a POST body, the value is already in the bus message */
+esp_err_t push_cmd(const char *key, size_t key_len, const char *value, size_t value_len, void *arg) {
+    cmd_req_ctx_t *ctx = (cmd_req_ctx_t *)arg;
+    //per request logs are debug only, printing them costs more than serving the request
+    ESP_LOGD(HTTP_TAG, "cmd req content: key = %s, value = %s", key, value);
+
+    //routed once here, consumers never look at the key
+    cmd_id_t id = cmd_id_from_key(key);
+    if (id == CMD_ID_NONE) {
+        metrics_inc(METRIC_CNT_BAD_REQ);
+        return ESP_OK;
+    }
+
+    if (!admission_take(ctx->client)) {
+        //the message is left in place for the next pair
+        ctx->throttled++;
+        metrics_inc(METRIC_CNT_THROTTLED);
+        return ESP_OK;
+    }
+
+    metrics_inc(METRIC_CNT_ADMITTED);
+    if (ctx->msg != NULL) {
+        ctx->msg->id = id;
+        ctx->batch[ctx->batch_len++] = ctx->msg;
+        if (ctx->batch_len == CMD_BATCH_MAX) cmd_req_flush(ctx);
+    } else {
+        ctx->dropped++;
+        metrics_inc(METRIC_CNT_BUS_POOL_EMPTY);
+        ESP_LOGD(HTTP_TAG, "bus pool empty, pkt dropped");
+    }
+
+    cmd_req_next_msg(ctx);
+    return ESP_OK;
+}
+
+void cmd_req_start(cmd_req_ctx_t *ctx, uint32_t client) {
+    ctx->batch_len = 0;
+    ctx->client = client;
+    ctx->first_ticket = 0;
+    ctx->published = 0;
+    ctx->dropped = 0;
+    ctx->throttled = 0;
+    form_parser_init(&ctx->parser, ctx->key, KEY_BUF_SIZE, ctx->scratch, VAL_BUF_SIZE, push_cmd, ctx);
+    cmd_req_next_msg(ctx);
+}
+
+void cmd_req_done(cmd_req_ctx_t *ctx) {
+    //pairs decoded before an error are still delivered, like they would have been one by one
+    cmd_req_flush(ctx);
+    //the message prepared for a pair that never came goes back to the pool
+    if (ctx->msg != NULL) cmd_bus_release(ctx->msg);
+}
+
+/*
+receive the body chunk by chunk (it can be longer than one io block) and publish every pair on the bus.
+on error the error response is already sent.
+*/
+esp_err_t recv_cmds(httpd_req_t *req, cmd_req_ctx_t *ctx, uint32_t client) {
+    char *req_buf = (char *)buf_pool_get(&io_pool);
+    if (req_buf == NULL) {
+        send_busy(req);
+        return ESP_FAIL;
+    }
+
+    cmd_req_start(ctx, client);
+
+    size_t remaining = req->content_len;
+    while (remaining > 0) {
+        int ret = httpd_req_recv(req, req_buf, remaining < IO_BUF_SIZE ? remaining : IO_BUF_SIZE);
+        if (ret <= 0) {
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+                httpd_resp_send_408(req); //timeout
+            }
+            break;
+        }
+        remaining -= ret;
+
+        if (form_parser_feed(&ctx->parser, req_buf, ret) != ESP_OK) break;
+    }
+
+    if (remaining == 0) form_parser_finish(&ctx->parser);
+    cmd_req_done(ctx);
+    buf_pool_put(&io_pool, req_buf);
+
+    if (remaining != 0 && ctx->parser.err == ESP_OK) return ESP_FAIL;
+    if (ctx->parser.err != ESP_OK) {
+        ESP_LOGI(HTTP_TAG, "malformed cmd req, err = %x", ctx->parser.err);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "malformed form body");
+        metrics_inc(METRIC_CNT_BAD_REQ);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/* the whole page of the current led state goes out in one send with a known Content-Length */
+esp_err_t send_index_page(httpd_req_t *req, size_t *resp_len) {
+    uint32_t start_cycles = cpu_hal_get_cycle_count();
+    //one load, body and len always belong to the same variant even if the led flips meanwhile
+    const index_page_t *page = atomic_load_explicit(&index_page_cur, memory_order_acquire);
+
+    esp_err_t err = httpd_resp_send(req, page->body, page->len);
+    metrics_add(METRIC_CNT_INDEX_CYCLES, cpu_hal_get_cycle_count() - start_cycles);
+    *resp_len = (err == ESP_OK) ? page->len : 0;
+    return err;
 }
 
 esp_err_t index_get_handler(httpd_req_t *req) {
-    //send resp
-    char resp_buf[RESP_BUF_SIZE] = "";
-    int resp_buf_len = gen_index_page(resp_buf);
-    ESP_LOGI(HTTP_TAG, "resp_buf_len = %d", resp_buf_len);
+    int64_t start_us = esp_timer_get_time();
 
-    esp_err_t err = httpd_resp_send(req, resp_buf, resp_buf_len);
+    //send resp
+    size_t resp_len;
+    esp_err_t err = send_index_page(req, &resp_len);
     if (err != ESP_OK) {
         ESP_LOGI(HTTP_TAG, "error while sending /");
     }
 
-    else {
-        ESP_LOGI(HTTP_TAG, "success while sending /");
-    }
+    metrics_record(METRIC_ROUTE_INDEX_GET, start_us, resp_len);
     return err;
 }
 
+/* clients opt in to async handoff with "Prefer: respond-async" (RFC 7240) */
+bool wants_async_resp(httpd_req_t *req) {
+    char prefer[32];
+    if (httpd_req_get_hdr_value_str(req, "Prefer", prefer, sizeof(prefer)) != ESP_OK) return false;
+    return strstr(prefer, "respond-async") != NULL;
+}
+
+/*
+nothing got through: 429 if admission control refused the cmds, 503 if the bus was full.
+returns false when at least one cmd was published and the normal response should be sent.
+*/
+bool send_rejected(httpd_req_t *req, const cmd_req_ctx_t *ctx, esp_err_t *err) {
+    if (ctx->published > 0 || (ctx->throttled == 0 && ctx->dropped == 0)) return false;
+    *err = (ctx->throttled > 0) ? send_throttled(req, ctx->client) : send_busy(req);
+    return true;
+}
+
+/* 202 Accepted with the ticket of the first queued cmd, tickets of one request are consecutive */
+esp_err_t send_ticket_resp(httpd_req_t *req, const cmd_req_ctx_t *ctx, size_t *resp_len) {
+    char resp_buf[TICKET_RESP_SIZE];
+    char location[32];
+
+    httpd_resp_set_status(req, "202 Accepted");
+    httpd_resp_set_type(req, "text/plain");
+    if (ctx->published > 0) {
+        snprintf(location, sizeof(location), "/status?ticket=%u", ctx->first_ticket);
+        httpd_resp_set_hdr(req, "Location", location);
+    }
+
+    int len = snprintf(resp_buf, sizeof(resp_buf), "ticket=%u count=%d dropped=%d throttled=%d\n",
+                       ctx->first_ticket, ctx->published, ctx->dropped, ctx->throttled);
+    *resp_len = len;
+    return httpd_resp_send(req, resp_buf, len);
+}
+
 esp_err_t cmd_post_handler(httpd_req_t *req) {
+    int64_t start_us = esp_timer_get_time();
+    uint32_t client = sock_client_ip(httpd_req_to_sockfd(req));
+
+    //refuse before reading the body when the client has no token left
+    if (!admission_peek(client)) {
+        metrics_inc(METRIC_CNT_THROTTLED);
+        metrics_record(METRIC_ROUTE_CMD_POST, start_us, 0);
+        return send_throttled(req, client);
+    }
+
+    //the ctx holds a batch of bus messages, too big for the httpd stack
+    cmd_req_ctx_t *ctx = (cmd_req_ctx_t *)buf_pool_get(&cmd_ctx_pool);
+    if (ctx == NULL) {
+        metrics_record(METRIC_ROUTE_CMD_POST, start_us, 0);
+        return send_busy(req);
+    }
+
     //process req
-    char req_buf[REQ_BUF_SIZE] = "";
-    int req_buf_len = req->content_len;
-    if (req_buf_len > REQ_BUF_SIZE) return ESP_FAIL;
-
-    int ret = httpd_req_recv(req, req_buf, req_buf_len);
-    if (ret <= 0) {
-        if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
-            httpd_resp_send_408(req); //timeout
+    if (recv_cmds(req, ctx, client) != ESP_OK) {
+        buf_pool_put(&cmd_ctx_pool, ctx);
+        metrics_record(METRIC_ROUTE_CMD_POST, start_us, 0);
+        return ESP_FAIL;
+    }
+
+    esp_err_t err;
+    size_t resp_len = 0;
+    if (send_rejected(req, ctx, &err)) {
+        //nothing was queued, the status code says why
+    } else if (wants_async_resp(req)) {
+        //async clients get the ticket right away instead of the page
+        err = send_ticket_resp(req, ctx, &resp_len);
+    } else {
+        //send resp
+        err = send_index_page(req, &resp_len);
+    }
+
+    buf_pool_put(&cmd_ctx_pool, ctx);
+    metrics_record(METRIC_ROUTE_CMD_POST, start_us, resp_len);
+    return err;
+}
+
+/*
+POST /batch: many commands in one body, either "toggle=1&str=a&str=b" or one key=value record per line.
+all of them are published in bulk and answered with one compact status line instead of the page.
+*/
+esp_err_t batch_post_handler(httpd_req_t *req) {
+    int64_t start_us = esp_timer_get_time();
+    char resp_buf[TICKET_RESP_SIZE];
+    uint32_t client = sock_client_ip(httpd_req_to_sockfd(req));
+
+    if (!admission_peek(client)) {
+        metrics_inc(METRIC_CNT_THROTTLED);
+        metrics_record(METRIC_ROUTE_BATCH_POST, start_us, 0);
+        return send_throttled(req, client);
+    }
+
+    cmd_req_ctx_t *ctx = (cmd_req_ctx_t *)buf_pool_get(&cmd_ctx_pool);
+    if (ctx == NULL) {
+        metrics_record(METRIC_ROUTE_BATCH_POST, start_us, 0);
+        return send_busy(req);
+    }
+
+    if (recv_cmds(req, ctx, client) != ESP_OK) {
+        buf_pool_put(&cmd_ctx_pool, ctx);
+        metrics_record(METRIC_ROUTE_BATCH_POST, start_us, 0);
+        return ESP_FAIL;
+    }
+
+    esp_err_t err;
+    int len = 0;
+    if (!send_rejected(req, ctx, &err)) {
+        //partly throttled batches still succeed, the counts tell the client what to resend
+        httpd_resp_set_type(req, "text/plain");
+        len = snprintf(resp_buf, sizeof(resp_buf), "accepted=%d dropped=%d throttled=%d first_ticket=%u\n",
+                       ctx->published, ctx->dropped, ctx->throttled, ctx->first_ticket);
+        err = httpd_resp_send(req, resp_buf, len);
+    }
+    buf_pool_put(&cmd_ctx_pool, ctx);
+
+    metrics_record(METRIC_ROUTE_BATCH_POST, start_us, len);
+    return err;
+}
+
+/* ticket of GET /status/{ticket} or GET /status?ticket=N, false when there is none */
+bool status_ticket(httpd_req_t *req, uint32_t *ticket) {
+    char query[TICKET_RESP_SIZE];
+    char ticket_str[16];
+
+    if (!route_param(0, ticket_str, sizeof(ticket_str)) &&
+        (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+         httpd_query_key_value(query, "ticket", ticket_str, sizeof(ticket_str)) != ESP_OK)) {
+        return false;
+    }
+    *ticket = (uint32_t)strtoul(ticket_str, NULL, 10);
+    return true;
+}
+
+esp_err_t status_get_handler(httpd_req_t *req) {
+    int64_t start_us = esp_timer_get_time();
+    uint32_t ticket;
+
+    if (!status_ticket(req, &ticket)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "missing ticket");
+        metrics_inc(METRIC_CNT_BAD_REQ);
+        metrics_record(METRIC_ROUTE_STATUS_GET, start_us, 0);
+        return ESP_FAIL;
+    }
+
+    cmd_ticket_status_t st = cmd_bus_ticket_status(ticket);
+    const char *st_str = cmd_ticket_status_str(st);
+    if (st == CMD_TICKET_UNKNOWN) httpd_resp_set_status(req, "404 Not Found");
+    httpd_resp_set_type(req, "text/plain");
+    esp_err_t err = httpd_resp_sendstr(req, st_str);
+
+    metrics_record(METRIC_ROUTE_STATUS_GET, start_us, strlen(st_str));
+    return err;
+}
+
+/*================= DETACHED REQUESTS =================*/
+/*
+GET /, POST /, POST /batch and GET /status run on the http workers when a pending slot is free (route_dispatch).
+the httpd task only checks admission, reads the body into an io block or the ticket from the uri and returns,
+the job parses, publishes and answers. every response of a detached request goes through the job, so it stays
+in order behind the other pending responses of its connection.
+*/
+
+/* the response of a detached request and its metrics, job->arg is the metric route. job is gone afterwards */
+esp_err_t job_respond(http_job_t *job, const char *status, const char *type, const char *hdrs, const char *body,
+                      size_t len) {
+    metric_route_t route = (metric_route_t)job->arg;
+    int64_t start_us = job->start_us;
+
+    esp_err_t err = http_job_send(job, status, type, hdrs, body, len);
+    metrics_record(route, start_us, (err == ESP_OK) ? len : 0);
+    return err;
+}
+
+void busy_job(http_job_t *job) {
+    job_respond(job, "503 Service Unavailable", "text/plain", "Retry-After: 1\r\n", NULL, 0);
+}
+
+/* job->val is the client */
+void throttled_job(http_job_t *job) {
+    char hdrs[32];
+    snprintf(hdrs, sizeof(hdrs), "Retry-After: %u\r\n", (unsigned int)admission_retry_after(job->val));
+    job_respond(job, "429 Too Many Requests", "text/plain", hdrs, NULL, 0);
+}
+
+/* job->data is the message, a constant string */
+void bad_req_job(http_job_t *job) {
+    const char *msg = (const char *)job->data;
+    job_respond(job, "400 Bad Request", "text/plain", NULL, msg, strlen(msg));
+}
+
+void index_page_job(http_job_t *job) {
+    const index_page_t *page = atomic_load_explicit(&index_page_cur, memory_order_acquire);
+    job_respond(job, "200 OK", "text/html", NULL, page->body, page->len);
+}
+
+/* POST / and POST /batch, the body is the io block job->data of job->len bytes, job->val the client */
+void cmd_job_run(http_job_t *job, bool async) {
+    cmd_req_ctx_t *ctx = (cmd_req_ctx_t *)buf_pool_get(&cmd_ctx_pool);
+    if (ctx == NULL) {
+        buf_pool_put(&io_pool, job->data);
+        busy_job(job);
+        return;
+    }
+
+    cmd_req_start(ctx, job->val);
+    if (form_parser_feed(&ctx->parser, job->data, job->len) == ESP_OK) form_parser_finish(&ctx->parser);
+    cmd_req_done(ctx);
+    buf_pool_put(&io_pool, job->data);
+
+    //the counts are copied out, the ctx goes back before the send
+    cmd_req_ctx_t res = { .first_ticket = ctx->first_ticket, .published = ctx->published, .dropped = ctx->dropped,
+                          .throttled = ctx->throttled };
+    esp_err_t parse_err = ctx->parser.err;
+    buf_pool_put(&cmd_ctx_pool, ctx);
+
+    char resp_buf[TICKET_RESP_SIZE];
+    char hdrs[48];
+    int len;
+    if (parse_err != ESP_OK) {
+        ESP_LOGI(HTTP_TAG, "malformed cmd req, err = %x", parse_err);
+        metrics_inc(METRIC_CNT_BAD_REQ);
+        job->data = "malformed form body";
+        bad_req_job(job);
+    } else if (res.published == 0 && (res.throttled > 0 || res.dropped > 0)) {
+        //nothing was queued, the status code says why
+        if (res.throttled > 0) {
+            throttled_job(job);
+        } else {
+            busy_job(job);
+        }
+    } else if (job->arg == METRIC_ROUTE_BATCH_POST) {
+        len = snprintf(resp_buf, sizeof(resp_buf), "accepted=%d dropped=%d throttled=%d first_ticket=%u\n",
+                       res.published, res.dropped, res.throttled, res.first_ticket);
+        job_respond(job, "200 OK", "text/plain", NULL, resp_buf, len);
+    } else if (async) {
+        hdrs[0] = '\0';
+        if (res.published > 0) snprintf(hdrs, sizeof(hdrs), "Location: /status?ticket=%u\r\n", res.first_ticket);
+        len = snprintf(resp_buf, sizeof(resp_buf), "ticket=%u count=%d dropped=%d throttled=%d\n",
+                       res.first_ticket, res.published, res.dropped, res.throttled);
+        job_respond(job, "202 Accepted", "text/plain", hdrs, resp_buf, len);
+    } else {
+        index_page_job(job);
+    }
+}
+
+void cmd_job(http_job_t *job) {
+    cmd_job_run(job, false);
+}
+
+void cmd_async_job(http_job_t *job) {
+    cmd_job_run(job, true);
+}
+
+/* job->val is the ticket */
+void status_job(http_job_t *job) {
+    cmd_ticket_status_t st = cmd_bus_ticket_status(job->val);
+    const char *st_str = cmd_ticket_status_str(st);
+    job_respond(job, (st == CMD_TICKET_UNKNOWN) ? "404 Not Found" : "200 OK", "text/plain", NULL, st_str,
+                strlen(st_str));
+}
+
+esp_err_t index_get_detach(httpd_req_t *req, http_job_t *job) {
+    job->arg = METRIC_ROUTE_INDEX_GET;
+    http_job_submit(job, index_page_job);
+    return ESP_OK;
+}
+
+esp_err_t cmd_detach(httpd_req_t *req, http_job_t *job, metric_route_t route, http_job_fn_t fn) {
+    job->arg = route;
+    job->val = sock_client_ip(job->fd);
+
+    //refuse before reading the body when the client has no token left
+    if (!admission_peek(job->val)) {
+        metrics_inc(METRIC_CNT_THROTTLED);
+        http_job_submit(job, throttled_job);
+        return ESP_OK;
+    }
+
+    char *body;
+    esp_err_t err = body_recv(req, &body, &job->len);
+    if (err == ESP_ERR_NO_MEM) {
+        http_job_submit(job, busy_job);
+        return ESP_OK;
+    }
+    if (err != ESP_OK) {
+        //the session is closed, there is no one to answer
+        metrics_record(route, job->start_us, 0);
+        http_job_end(job);
+        return ESP_FAIL;
+    }
+    job->data = body;
+    http_job_submit(job, fn);
+    return ESP_OK;
+}
+
+esp_err_t cmd_post_detach(httpd_req_t *req, http_job_t *job) {
+    return cmd_detach(req, job, METRIC_ROUTE_CMD_POST, wants_async_resp(req) ? cmd_async_job : cmd_job);
+}
+
+esp_err_t batch_post_detach(httpd_req_t *req, http_job_t *job) {
+    return cmd_detach(req, job, METRIC_ROUTE_BATCH_POST, cmd_job);
+}
+
+esp_err_t status_get_detach(httpd_req_t *req, http_job_t *job) {
+    job->arg = METRIC_ROUTE_STATUS_GET;
+    if (!status_ticket(req, &job->val)) {
+        metrics_inc(METRIC_CNT_BAD_REQ);
+        job->data = "missing ticket";
+        http_job_submit(job, bad_req_job);
+        return ESP_OK;
+    }
+    http_job_submit(job, status_job);
+    return ESP_OK;
+}
+
+/*================= REST API =================*/
+/* q of a media range in permille from its parameters (";q=0.5" -> 500), 1000 when there is none */
+int media_range_q(char *params) {
+    char *save;
+    for (char *p = strtok_r(params, ";", &save); p != NULL; p = strtok_r(NULL, ";", &save)) {
+        while (*p == ' ' || *p == '\t') p++;
+        if ((p[0] != 'q' && p[0] != 'Q') || p[1] != '=') continue;
+
+        int q = (p[2] == '1') ? 1000 : 0;
+        if (p[2] == '0' && p[3] == '.') {
+            int scale = 100;
+            for (const char *d = p + 4; *d >= '0' && *d <= '9' && scale > 0; d++, scale /= 10) q += (*d - '0') * scale;
         }
+        return q;
+    }
+    return 1000;
+}
+
+/*
+CBOR only when the client prefers it, JSON is the default.
+the field is a list of media ranges with optional q values (Accept) or a single media type (Content-Type):
+CBOR wins when application/cbor has a higher q than application/json and the wildcard ranges.
+a value longer than the buffer is judged on the part that was read.
+*/
+obj_fmt_t api_hdr_fmt(httpd_req_t *req, const char *field) {
+    char value[API_HDR_SIZE];
+    esp_err_t err = httpd_req_get_hdr_value_str(req, field, value, sizeof(value));
+    if (err != ESP_OK && err != ESP_ERR_HTTPD_RESULT_TRUNC) return OBJ_FMT_JSON;
+
+    int cbor_q = -1;
+    int json_q = -1;
+    char *save;
+    for (char *range = strtok_r(value, ",", &save); range != NULL; range = strtok_r(NULL, ",", &save)) {
+        while (*range == ' ' || *range == '\t') range++;
+        size_t type_len = strcspn(range, "; \t");
+        char *params = range + strcspn(range, ";");
+        int q = media_range_q(params);
+
+        if (type_len == 16 && strncasecmp(range, "application/cbor", 16) == 0) {
+            if (q > cbor_q) cbor_q = q;
+        } else if ((type_len == 16 && strncasecmp(range, "application/json", 16) == 0) ||
+                   (type_len == 13 && strncmp(range, "application/*", 13) == 0) ||
+                   (type_len == 3 && strncmp(range, "*/*", 3) == 0)) {
+            if (q > json_q) json_q = q;
+        }
+    }
+    return (cbor_q > 0 && cbor_q > json_q) ? OBJ_FMT_CBOR : OBJ_FMT_JSON;
+}
+
+esp_err_t api_send(httpd_req_t *req, const char *status, obj_writer_t *w, size_t *resp_len) {
+    size_t len;
+    if (obj_writer_finish(w, &len) != ESP_OK) {
+        *resp_len = 0;
+        return httpd_resp_send_500(req);
+    }
+    httpd_resp_set_status(req, status);
+    httpd_resp_set_type(req, (w->fmt == OBJ_FMT_CBOR) ? "application/cbor" : "application/json");
+    *resp_len = len;
+    return httpd_resp_send(req, (const char *)w->buf, len);
+}
+
+/* whole body into an io block, on failure the error response is already sent */
+esp_err_t api_recv_body(httpd_req_t *req, char **body, size_t *len) {
+    if (req->content_len > API_BODY_SIZE) {
+        metrics_inc(METRIC_CNT_BAD_REQ);
+        //not in httpd_err_code_t, the unread body closes the session
+        httpd_resp_set_status(req, "413 Payload Too Large");
+        httpd_resp_send(req, NULL, 0);
         return ESP_FAIL;
     }
-    ESP_LOGI(HTTP_TAG, "toggle req content: %s", req_buf);
-    key_value_t extracted_content = extract_content(req_buf, req_buf_len);
-    ESP_LOGI(HTTP_TAG, "toggle req content: key = %s, value = %s", extracted_content.key, extracted_content.value);
-    
-    //push recv pkt to the queue
-    if (q != 0) {
-        if (xQueueSendToBack(q, (void *)&extracted_content, (TickType_t)10) == pdPASS) { //if send successfully
-            ESP_LOGI(HTTP_TAG, "send pkt to queue success");
-        } //can we set a timeout in this http server task?
+
+    esp_err_t err = body_recv(req, body, len);
+    if (err == ESP_ERR_NO_MEM) {
+        send_busy(req);
+    } else if (err == ESP_ERR_TIMEOUT) {
+        httpd_resp_send_408(req);
     }
+    return (err == ESP_OK) ? ESP_OK : ESP_FAIL;
+}
 
-    //send resp
-    char resp_buf[RESP_BUF_SIZE] = "";
-    int resp_buf_len = gen_index_page(resp_buf);
-    ESP_LOGI(HTTP_TAG, "resp_buf_len = %d", resp_buf_len);
-    esp_err_t err = httpd_resp_send(req, resp_buf, resp_buf_len);
+esp_err_t api_bad_body(httpd_req_t *req, esp_err_t err) {
+    metrics_inc(METRIC_CNT_BAD_REQ);
+    ESP_LOGD(HTTP_TAG, "malformed api body, err = %x", err);
+    return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "malformed body");
+}
+
+/*
+admission, bus message and publish for one api cmd.
+returns the ticket, 0 when the cmd was refused and the 429/503 response is already sent (*err holds its result).
+*/
+uint32_t api_publish(httpd_req_t *req, cmd_id_t id, const char *value, esp_err_t *err) {
+    uint32_t client = sock_client_ip(httpd_req_to_sockfd(req));
+    if (!admission_take(client)) {
+        metrics_inc(METRIC_CNT_THROTTLED);
+        *err = send_throttled(req, client);
+        return 0;
+    }
+    metrics_inc(METRIC_CNT_ADMITTED);
+
+    cmd_msg_t *msg = cmd_bus_alloc();
+    if (msg == NULL) {
+        metrics_inc(METRIC_CNT_BUS_POOL_EMPTY);
+        *err = send_busy(req);
+        return 0;
+    }
+    //callers pass values that already fit msg->value
+    msg->id = id;
+    strcpy(msg->value, value);
+    return cmd_bus_publish(msg);
+}
+
+esp_err_t api_led_get_handler(httpd_req_t *req) {
+    int64_t start_us = esp_timer_get_time();
+    uint8_t resp_buf[API_RESP_SIZE];
+    size_t resp_len;
+    obj_writer_t w;
+
+    obj_writer_init(&w, api_hdr_fmt(req, "Accept"), resp_buf, sizeof(resp_buf));
+    obj_begin(&w, 1);
+    //led is active low, led_st == 0 means ON
+    obj_bool(&w, "on", led_st == 0);
+    obj_end(&w);
+
+    esp_err_t err = api_send(req, HTTPD_200, &w, &resp_len);
+    metrics_record(METRIC_ROUTE_API_LED_GET, start_us, resp_len);
+    return err;
+}
+
+/* the led task owns the state, the target state goes on the bus and is applied as is, so a retried PUT is harmless */
+esp_err_t api_led_put_handler(httpd_req_t *req) {
+    int64_t start_us = esp_timer_get_time();
+    uint8_t resp_buf[API_RESP_SIZE];
+    size_t resp_len = 0;
+    char *body;
+    size_t body_len;
+    bool on;
+    esp_err_t err;
+
+    if (api_recv_body(req, &body, &body_len) != ESP_OK) {
+        metrics_record(METRIC_ROUTE_API_LED_PUT, start_us, 0);
+        return ESP_FAIL;
+    }
+    err = obj_read_bool(api_hdr_fmt(req, "Content-Type"), body, body_len, "on", &on);
+    buf_pool_put(&io_pool, body);
+    if (err != ESP_OK) {
+        err = api_bad_body(req, err);
+        metrics_record(METRIC_ROUTE_API_LED_PUT, start_us, 0);
+        return err;
+    }
+
+    //always queued: led_st read here may already be outdated by cmds still on the bus
+    uint32_t ticket = api_publish(req, CMD_ID_LED_SET, on ? "1" : "0", &err);
+    if (ticket != 0) {
+        obj_writer_t w;
+        obj_writer_init(&w, api_hdr_fmt(req, "Accept"), resp_buf, sizeof(resp_buf));
+        obj_begin(&w, 2);
+        obj_bool(&w, "on", on);
+        obj_uint(&w, "ticket", ticket);
+        obj_end(&w);
+        err = api_send(req, "202 Accepted", &w, &resp_len);
+    }
+
+    metrics_record(METRIC_ROUTE_API_LED_PUT, start_us, resp_len);
+    return err;
+}
+
+esp_err_t api_print_post_handler(httpd_req_t *req) {
+    int64_t start_us = esp_timer_get_time();
+    uint8_t resp_buf[API_RESP_SIZE];
+    size_t resp_len = 0;
+    char str[VAL_BUF_SIZE];
+    char *body;
+    size_t body_len;
+    esp_err_t err;
+
+    if (api_recv_body(req, &body, &body_len) != ESP_OK) {
+        metrics_record(METRIC_ROUTE_API_PRINT_POST, start_us, 0);
+        return ESP_FAIL;
+    }
+    err = obj_read_str(api_hdr_fmt(req, "Content-Type"), body, body_len, "str", str, sizeof(str));
+    buf_pool_put(&io_pool, body);
+    if (err != ESP_OK) {
+        err = api_bad_body(req, err);
+        metrics_record(METRIC_ROUTE_API_PRINT_POST, start_us, 0);
+        return err;
+    }
+
+    uint32_t ticket = api_publish(req, CMD_ID_STR, str, &err);
+    if (ticket != 0) {
+        obj_writer_t w;
+        obj_writer_init(&w, api_hdr_fmt(req, "Accept"), resp_buf, sizeof(resp_buf));
+        obj_begin(&w, 1);
+        obj_uint(&w, "ticket", ticket);
+        obj_end(&w);
+        err = api_send(req, "202 Accepted", &w, &resp_len);
+    }
+
+    metrics_record(METRIC_ROUTE_API_PRINT_POST, start_us, resp_len);
+    return err;
+}
+
+/*================= WEBSOCKET =================*/
+void ws_add_client(int fd) {
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        int expected = -1;
+        if (atomic_load(&ws_fds[i]) == fd) return;
+        if (atomic_compare_exchange_strong(&ws_fds[i], &expected, fd)) return;
+    }
+    ESP_LOGI(HTTP_TAG, "ws client table full, fd %d will not get led pushes", fd);
+}
+
+esp_err_t ws_send_led_state(httpd_handle_t hd, int fd) {
+    //led is active low, led_st == 0 means ON
+    uint8_t payload[2] = { WS_OP_LED_STATE, (led_st == 0) ? '1' : '0' };
+    httpd_ws_frame_t frame = {
+        .final = true,
+        .fragmented = false,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = payload,
+        .len = sizeof(payload)
+    };
+    return httpd_ws_send_frame_async(hd, fd, &frame);
+}
+
+esp_err_t ws_send_busy(httpd_handle_t hd, int fd) {
+    uint8_t payload[1] = { WS_OP_BUSY };
+    httpd_ws_frame_t frame = {
+        .final = true,
+        .fragmented = false,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = payload,
+        .len = sizeof(payload)
+    };
+    return httpd_ws_send_frame_async(hd, fd, &frame);
+}
+
+/* runs on the httpd task, so it never races with the session handling */
+void ws_push_work(void *arg) {
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        int fd = atomic_load(&ws_fds[i]);
+        if (fd < 0) continue;
+
+        //closed or purged sessions are forgotten here
+        if (httpd_ws_get_fd_info(simple_server, fd) != HTTPD_WS_CLIENT_WEBSOCKET ||
+            ws_send_led_state(simple_server, fd) != ESP_OK) {
+            atomic_compare_exchange_strong(&ws_fds[i], &fd, -1);
+        }
+    }
+}
+
+void ws_push_led_state(void) {
+    if (simple_server == NULL) return;
+    httpd_queue_work(simple_server, ws_push_work, NULL);
+}
+
+esp_err_t ws_recv_cmd(httpd_req_t *req) {
+    uint8_t buf[WS_FRAME_MAX];
+    httpd_ws_frame_t frame = { .payload = NULL, .len = 0 };
+
+    //first read the frame length only
+    esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+    if (err != ESP_OK) return err;
+    if (frame.len == 0 || frame.len > sizeof(buf)) {
+        ESP_LOGI(HTTP_TAG, "ws frame of %d bytes rejected", frame.len);
+        metrics_inc(METRIC_CNT_BAD_REQ);
+        return ESP_FAIL;
+    }
+
+    frame.payload = buf;
+    err = httpd_ws_recv_frame(req, &frame, frame.len);
+    if (err != ESP_OK) return err;
+
+    switch (buf[0]) {
+    case WS_OP_GET_LED:
+        return ws_send_led_state(req->handle, httpd_req_to_sockfd(req));
+    case WS_OP_TOGGLE:
+    case WS_OP_STR: {
+        int fd = httpd_req_to_sockfd(req);
+        if (!admission_take(sock_client_ip(fd))) {
+            metrics_inc(METRIC_CNT_THROTTLED);
+            return ws_send_busy(req->handle, fd);
+        }
+        metrics_inc(METRIC_CNT_ADMITTED);
+
+        cmd_msg_t *msg = cmd_bus_alloc();
+        if (msg == NULL) {
+            metrics_inc(METRIC_CNT_BUS_POOL_EMPTY);
+            ESP_LOGD(HTTP_TAG, "bus pool empty, ws pkt dropped");
+            return ws_send_busy(req->handle, fd);
+        }
+        msg->id = (buf[0] == WS_OP_TOGGLE) ? CMD_ID_TOGGLE : CMD_ID_STR;
+        memcpy(msg->value, &buf[1], frame.len - 1);
+        msg->value[frame.len - 1] = '\0';
+        cmd_bus_publish(msg);
+        return ESP_OK;
+    }
+    default:
+        metrics_inc(METRIC_CNT_BAD_REQ);
+        ESP_LOGI(HTTP_TAG, "unknown ws opcode %x", buf[0]);
+        return ESP_OK;
+    }
+}
+
+esp_err_t ws_handler(httpd_req_t *req) {
+    //the handshake is done by the server, the handler is only called once with GET
+    if (req->method == HTTP_GET) {
+        ws_add_client(httpd_req_to_sockfd(req));
+        return ESP_OK;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = ws_recv_cmd(req);
+    metrics_record(METRIC_ROUTE_WS, start_us, 0);
+    return err;
+}
+
+/*================= SSE =================*/
+/* one event in event stream format, line breaks in the data would end the field early */
+uint16_t sse_format(char *out, const event_t *e) {
+    char data[EVENT_DATA_SIZE];
+    size_t i;
+    for (i = 0; e->data[i] != '\0'; i++) {
+        data[i] = (e->data[i] == '\r' || e->data[i] == '\n') ? ' ' : e->data[i];
+    }
+    data[i] = '\0';
+    return (uint16_t)snprintf(out, SSE_OUT_SIZE, "id: %u\nevent: %s\ndata: %s\n\n",
+                              (unsigned int)e->seq, event_type_str(e->type), data);
+}
+
+/* send what the socket takes without blocking, ESP_FAIL when the client is gone */
+esp_err_t sse_client_flush(sse_client_t *c) {
+    for (;;) {
+        if (c->out_off < c->out_len) {
+            int ret = httpd_socket_send(simple_server, c->fd, c->out + c->out_off, c->out_len - c->out_off, MSG_DONTWAIT);
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT) return ESP_OK;   //socket buffer full, resume on the next flush
+            if (ret < 0) return ESP_FAIL;
+            c->out_off += ret;
+            continue;
+        }
+        if (c->next_seq == event_ring_next_seq()) return ESP_OK;
+
+        event_t e;
+        if (!event_ring_read(c->next_seq, &e)) {
+            //the client fell behind the ring, continue with the oldest event still there
+            uint32_t oldest = event_ring_oldest_seq();
+            metrics_add(METRIC_CNT_SSE_SKIPPED, oldest - c->next_seq);
+            c->next_seq = oldest;
+            continue;
+        }
+        c->out_len = sse_format(c->out, &e);
+        c->out_off = 0;
+        c->next_seq++;
+    }
+}
+
+/* runs on the httpd task, so it never races with the session handling */
+void sse_flush_work(void *arg) {
+    //cleared first, an event pushed during the flush queues another one
+    atomic_store(&sse_flush_queued, false);
+
+    for (int i = 0; i < SSE_MAX_CLIENTS; i++) {
+        sse_client_t *c = &sse_clients[i];
+        if (c->fd < 0) continue;
+        if (sse_client_flush(c) != ESP_OK) {
+            httpd_sess_trigger_close(simple_server, c->fd);
+            c->fd = -1;
+        }
+    }
+}
+
+/* called by the app tasks, never blocks: at most one flush is queued at a time */
+void sse_publish(event_type_t type, const char *data, size_t len) {
+    event_ring_push(type, data, len);
+    if (simple_server == NULL || atomic_exchange(&sse_flush_queued, true)) return;
+    if (httpd_queue_work(simple_server, sse_flush_work, NULL) != ESP_OK) {
+        atomic_store(&sse_flush_queued, false);
+    }
+}
+
+void sse_remove_client(int fd) {
+    for (int i = 0; i < SSE_MAX_CLIENTS; i++) {
+        if (sse_clients[i].fd == fd) sse_clients[i].fd = -1;
+    }
+}
+
+esp_err_t events_get_handler(httpd_req_t *req) {
+    int64_t start_us = esp_timer_get_time();
+    sse_client_t *c = NULL;
+    for (int i = 0; i < SSE_MAX_CLIENTS && c == NULL; i++) {
+        if (sse_clients[i].fd < 0) c = &sse_clients[i];
+    }
+    if (c == NULL) {
+        metrics_record(METRIC_ROUTE_EVENTS_GET, start_us, 0);
+        return send_busy(req);
+    }
+
+    //the stream has no length, it is written raw and ends when either side closes the socket
+    c->fd = httpd_req_to_sockfd(req);
+    c->next_seq = event_ring_next_seq();
+    c->out_off = 0;
+    c->out_len = (uint16_t)snprintf(c->out, SSE_OUT_SIZE,
+                                    "HTTP/1.1 200 OK\r\n"
+                                    "Content-Type: text/event-stream\r\n"
+                                    "Cache-Control: no-cache\r\n"
+                                    "\r\n"
+                                    "retry: %d\n"
+                                    "event: led\ndata: %c\n\n",
+                                    SSE_RETRY_MS, (led_st == 0) ? '1' : '0');
+    uint16_t hdr_len = c->out_len;
+
+    esp_err_t err = sse_client_flush(c);
+    if (err != ESP_OK) c->fd = -1;
+    metrics_record(METRIC_ROUTE_EVENTS_GET, start_us, (err == ESP_OK) ? hdr_len : 0);
+    return err;
+}
+
+/* replaces close() for every httpd session, forgets stream clients and pending jobs before their fd can be reused */
+void http_sess_close(httpd_handle_t hd, int sockfd) {
+    sse_remove_client(sockfd);
+    http_workers_sess_closed(sockfd);
+    close(sockfd);
+}
+
+/*================= STATIC ASSETS =================*/
+/* FNV-1a over the compressed body, computed once at boot */
+void static_assets_init(void) {
+    for (int i = 0; i < STATIC_ASSET_CNT; i++) {
+        static_asset_t *asset = &static_assets[i];
+        uint32_t hash = 2166136261u;
+        for (const uint8_t *p = asset->start; p < asset->end; p++) {
+            hash = (hash ^ *p) * 16777619u;
+        }
+        snprintf(asset->etag, ETAG_SIZE, "\"%08x\"", (unsigned int)hash);
+    }
+}
+
+/* header value into buf, false when it is missing. a value longer than buf is cut, callers search what was read */
+bool req_hdr_read(httpd_req_t *req, const char *field, char *buf, size_t size) {
+    esp_err_t err = httpd_req_get_hdr_value_str(req, field, buf, size);
+    return err == ESP_OK || err == ESP_ERR_HTTPD_RESULT_TRUNC;
+}
+
+esp_err_t static_get_handler(httpd_req_t *req) {
+    int64_t start_us = esp_timer_get_time();
+    const static_asset_t *asset = NULL;
+    char hdr[STATIC_HDR_SIZE];
+    esp_err_t err;
+    size_t resp_len = 0;
+
+    //the route is /{file}, asset uris are "/" + file
+    if (route_param(0, hdr, sizeof(hdr))) {
+        for (int i = 0; i < STATIC_ASSET_CNT && asset == NULL; i++) {
+            if (strcmp(static_assets[i].uri + 1, hdr) == 0) asset = &static_assets[i];
+        }
+    }
+    if (asset == NULL) {
+        metrics_record(METRIC_ROUTE_STATIC_GET, start_us, 0);
+        return httpd_resp_send_404(req);
+    }
+
+    httpd_resp_set_hdr(req, "ETag", asset->etag);
+    //always revalidate, a revalidation costs only the 304 headers
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    if (req_hdr_read(req, "If-None-Match", hdr, sizeof(hdr)) && strstr(hdr, asset->etag) != NULL) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        err = httpd_resp_send(req, NULL, 0);
+    } else if (!req_hdr_read(req, "Accept-Encoding", hdr, sizeof(hdr)) || strstr(hdr, "gzip") == NULL) {
+        //bodies only exist compressed
+        httpd_resp_set_status(req, "406 Not Acceptable");
+        err = httpd_resp_send(req, NULL, 0);
+    } else {
+        resp_len = asset->end - asset->start;
+        httpd_resp_set_type(req, asset->type);
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+        err = httpd_resp_send(req, (const char *)asset->start, resp_len);
+    }
+
+    metrics_record(METRIC_ROUTE_STATIC_GET, start_us, resp_len);
     return err;
 }
 
-httpd_uri_t index_get_uri = {
-    .uri = "/",
+/*================= ROUTER =================*/
+typedef enum {
+    ROUTE_INDEX_GET = 0,
+    ROUTE_CMD_POST,
+    ROUTE_BATCH_POST,
+    ROUTE_STATUS_GET,
+    ROUTE_STATUS_TICKET_GET,
+    ROUTE_METRICS_GET,
+    ROUTE_EVENTS_GET,
+    ROUTE_API_LED_GET,
+    ROUTE_API_LED_PUT,
+    ROUTE_API_PRINT_POST,
+    ROUTE_STATIC_GET,
+    ROUTE_CNT
+} route_id_t;
+
+typedef struct {
+    esp_err_t (*handler)(httpd_req_t *req);
+    void *user_ctx;
+    esp_err_t (*detach)(httpd_req_t *req, http_job_t *job);    //httpd side when it runs on a worker, or NULL
+} route_target_t;
+
+static const route_def_t route_defs[ROUTE_CNT] = {
+    [ROUTE_INDEX_GET]           = { HTTP_GET, "/" },
+    [ROUTE_CMD_POST]            = { HTTP_POST, "/" },
+    [ROUTE_BATCH_POST]          = { HTTP_POST, "/batch" },
+    [ROUTE_STATUS_GET]          = { HTTP_GET, "/status" },
+    [ROUTE_STATUS_TICKET_GET]   = { HTTP_GET, "/status/{ticket}" },
+    [ROUTE_METRICS_GET]         = { HTTP_GET, "/metrics" },
+    [ROUTE_EVENTS_GET]          = { HTTP_GET, "/events" },
+    [ROUTE_API_LED_GET]         = { HTTP_GET, "/api/led" },
+    [ROUTE_API_LED_PUT]         = { HTTP_PUT, "/api/led" },
+    [ROUTE_API_PRINT_POST]      = { HTTP_POST, "/api/print" },
+    [ROUTE_STATIC_GET]          = { HTTP_GET, "/{file}" },
+};
+
+static const route_target_t route_targets[ROUTE_CNT] = {
+    [ROUTE_INDEX_GET]           = { index_get_handler, NULL, index_get_detach },
+    [ROUTE_CMD_POST]            = { cmd_post_handler, NULL, cmd_post_detach },
+    [ROUTE_BATCH_POST]          = { batch_post_handler, NULL, batch_post_detach },
+    [ROUTE_STATUS_GET]          = { status_get_handler, NULL, status_get_detach },
+    [ROUTE_STATUS_TICKET_GET]   = { status_get_handler, NULL, status_get_detach },
+    [ROUTE_METRICS_GET]         = { metrics_get_handler, &io_pool },    //the metrics writer batches lines in an io block
+    [ROUTE_EVENTS_GET]          = { events_get_handler, NULL },
+    [ROUTE_API_LED_GET]         = { api_led_get_handler, NULL },
+    [ROUTE_API_LED_PUT]         = { api_led_put_handler, NULL },
+    [ROUTE_API_PRINT_POST]      = { api_print_post_handler, NULL },
+    [ROUTE_STATIC_GET]          = { static_get_handler, NULL },
+};
+
+static route_trie_t route_trie;
+
+bool route_param(int i, char *buf, size_t size) {
+    if (i >= route_match.param_cnt || route_match.params[i].len >= size) return false;
+    memcpy(buf, route_match.params[i].start, route_match.params[i].len);
+    buf[route_match.params[i].len] = '\0';
+    return true;
+}
+
+/*
+a worker takes the request when its route can be detached, its body fits an io block and a pending slot is free.
+a connection that asks to be closed is answered inline, httpd closes it as soon as the handler returns.
+*/
+http_job_t *route_detach_begin(httpd_req_t *req, int id) {
+    char conn[16];
+    if (id < 0 || route_targets[id].detach == NULL || req->content_len > IO_BUF_SIZE) return NULL;
+    if (req_hdr_read(req, "Connection", conn, sizeof(conn)) && strcasecmp(conn, "close") == 0) return NULL;
+    return http_job_begin(req);
+}
+
+/* every request but the websocket lands here, the trie maps it to a route id in one walk of the uri */
+esp_err_t route_dispatch(httpd_req_t *req) {
+    int64_t start_us = esp_timer_get_time();
+    int id = route_trie_lookup(&route_trie, req->method, req->uri, &route_match);
+
+    //may wait for an older response of this connection, that counts to the request like it does inline
+    http_job_t *job = route_detach_begin(req, id);
+    if (job != NULL) {
+        job->start_us = start_us;
+        return route_targets[id].detach(req, job);
+    }
+    //an inline answer would overtake a detached response still pending on the same connection
+    http_workers_wait_fd(httpd_req_to_sockfd(req));
+
+    if (id == ROUTE_METHOD_NOT_ALLOWED) {
+        return httpd_resp_send_err(req, HTTPD_405_METHOD_NOT_ALLOWED, NULL);
+    }
+    if (id == ROUTE_NOT_FOUND) {
+        return httpd_resp_send_404(req);
+    }
+
+    req->user_ctx = route_targets[id].user_ctx;
+    return route_targets[id].handler(req);
+}
+
+/* httpd only matches the method and the wildcard, one uri per method the routes use */
+httpd_uri_t route_get_uri = {
+    .uri = "/*",
     .method = HTTP_GET,
-    .handler = index_get_handler,
+    .handler = route_dispatch,
     .user_ctx = NULL
 };
 
-httpd_uri_t cmd_post_uri = {
-    .uri = "/",
+httpd_uri_t route_post_uri = {
+    .uri = "/*",
     .method = HTTP_POST,
-    .handler = cmd_post_handler,
+    .handler = route_dispatch,
     .user_ctx = NULL
 };
 
+httpd_uri_t route_put_uri = {
+    .uri = "/*",
+    .method = HTTP_PUT,
+    .handler = route_dispatch,
+    .user_ctx = NULL
+};
+
+httpd_uri_t ws_uri = {
+    .uri = "/ws",
+    .method = HTTP_GET,
+    .handler = ws_handler,
+    .user_ctx = NULL,
+    .is_websocket = true
+};
+
 void http_server_init(void) {
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) atomic_init(&ws_fds[i], -1);
+    for (int i = 0; i < SSE_MAX_CLIENTS; i++) sse_clients[i].fd = -1;
+    atomic_init(&sse_flush_queued, false);
+    static_assets_init();
+    ESP_ERROR_CHECK(route_trie_build(&route_trie, route_defs, ROUTE_CNT));
+
     httpd_config_t http_cfg = HTTPD_DEFAULT_CONFIG();
     http_cfg.lru_purge_enable = true;
     http_cfg.server_port = SIMPLE_SERVER_PORT;
+    http_cfg.max_uri_handlers = 4;
+    http_cfg.uri_match_fn = httpd_uri_match_wildcard;
+    http_cfg.stack_size = HTTPD_STACK_SIZE;
+    http_cfg.close_fn = http_sess_close;
 
     //start server
     esp_netif_get_ip_info(netif, &ip_info);
     ESP_LOGI(HTTP_TAG, "starting server on "IPSTR":%d", IP2STR(&ip_info.ip), http_cfg.server_port);
 
     if (httpd_start(&simple_server, &http_cfg) == ESP_OK) {
-        //register uris
+        //register uris, the websocket first: httpd picks the first match and the wildcards match /ws too
         ESP_LOGI(HTTP_TAG, "register URIs");
-        httpd_register_uri_handler(simple_server, &index_get_uri);
-        httpd_register_uri_handler(simple_server, &cmd_post_uri);
+        httpd_register_uri_handler(simple_server, &ws_uri);
+        httpd_register_uri_handler(simple_server, &route_get_uri);
+        httpd_register_uri_handler(simple_server, &route_post_uri);
+        httpd_register_uri_handler(simple_server, &route_put_uri);
     }
 }
 
@@ -385,8 +1551,13 @@ void app_main(void)
 {
     gpio_init();
     flash_init();
+    //handler tasks subscribe to the bus while app_main waits for the AP, before the server can publish
+    buf_pools_init();
+    admission_init();
+    bus_init();
+    tasks_init();
     wifi_init_ap();
+    http_workers_init();
     http_server_init();
-    queue_init();
-    tasks_init();
+    udp_ctrl_init();
 }
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include <stdatomic.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "metrics.h"
+#include "cmd_bus.h"
+#include "buf_pool.h"
+#include "http_workers.h"
+
+typedef struct {
+    atomic_uint count;
+    atomic_uint bytes;
+    atomic_uint lat_sum_us;
+    atomic_uint lat_buckets[METRICS_LAT_BUCKETS];
+} route_metrics_t;
+
+typedef struct {
+    const char *uri;
+    const char *method;
+} route_label_t;
+
+static const route_label_t route_labels[METRIC_ROUTE_CNT] = {
+    [METRIC_ROUTE_INDEX_GET]    = { "/", "GET" },
+    [METRIC_ROUTE_CMD_POST]     = { "/", "POST" },
+    [METRIC_ROUTE_BATCH_POST]   = { "/batch", "POST" },
+    [METRIC_ROUTE_STATUS_GET]   = { "/status", "GET" },
+    [METRIC_ROUTE_WS]           = { "/ws", "GET" },
+    [METRIC_ROUTE_STATIC_GET]   = { "static", "GET" },
+    [METRIC_ROUTE_METRICS_GET]  = { "/metrics", "GET" },
+    [METRIC_ROUTE_EVENTS_GET]   = { "/events", "GET" },
+    [METRIC_ROUTE_API_LED_GET]  = { "/api/led", "GET" },
+    [METRIC_ROUTE_API_LED_PUT]  = { "/api/led", "PUT" },
+    [METRIC_ROUTE_API_PRINT_POST] = { "/api/print", "POST" },
+};
+
+static const char *counter_names[METRIC_CNT_CNT] = {
+    [METRIC_CNT_BUS_POOL_EMPTY] = "cmd_bus_pool_empty_total",
+    [METRIC_CNT_BAD_REQ]        = "httpd_bad_requests_total",
+    [METRIC_CNT_ADMITTED]       = "admission_admitted_total",
+    [METRIC_CNT_THROTTLED]      = "admission_throttled_total",
+    [METRIC_CNT_INDEX_CYCLES]   = "index_page_cpu_cycles_total",
+    [METRIC_CNT_SSE_SKIPPED]    = "sse_events_skipped_total",
+    [METRIC_CNT_UDP_CMDS]       = "udp_cmds_total",
+};
+
+static route_metrics_t routes[METRIC_ROUTE_CNT];
+static atomic_uint counters[METRIC_CNT_CNT];
+
+void metrics_record(metric_route_t route, int64_t start_us, size_t resp_bytes) {
+    route_metrics_t *m = &routes[route];
+    uint32_t lat = (uint32_t)(esp_timer_get_time() - start_us);
+
+    //bucket i counts latencies in (2^(i-1), 2^i] us
+    int bucket = (lat <= 1) ? 0 : 32 - __builtin_clz(lat - 1);
+    if (bucket >= METRICS_LAT_BUCKETS) bucket = METRICS_LAT_BUCKETS - 1;
+
+    atomic_fetch_add_explicit(&m->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&m->bytes, resp_bytes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&m->lat_sum_us, lat, memory_order_relaxed);
+    atomic_fetch_add_explicit(&m->lat_buckets[bucket], 1, memory_order_relaxed);
+}
+
+void metrics_inc(metric_counter_t cnt) {
+    atomic_fetch_add_explicit(&counters[cnt], 1, memory_order_relaxed);
+}
+
+void metrics_add(metric_counter_t cnt, uint32_t n) {
+    atomic_fetch_add_explicit(&counters[cnt], n, memory_order_relaxed);
+}
+
+/* lines are batched in buf and sent as http chunks */
+typedef struct {
+    httpd_req_t *req;
+    char *buf;
+    int size;
+    int len;
+    size_t total;
+    esp_err_t err;
+} metrics_writer_t;
+
+static void writer_flush(metrics_writer_t *w) {
+    if (w->err == ESP_OK && w->len > 0) w->err = httpd_resp_send_chunk(w->req, w->buf, w->len);
+    w->total += w->len;
+    w->len = 0;
+}
+
+/* one line (one sample or one # line) straight into buf, a line never gets split or cut */
+static void writer_line(metrics_writer_t *w, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void writer_line(metrics_writer_t *w, const char *fmt, ...) {
+    va_list args;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        va_start(args, fmt);
+        int n = vsnprintf(&w->buf[w->len], w->size - w->len, fmt, args);
+        va_end(args);
+        if (n < 0) return;
+        if (n < w->size - w->len) {
+            w->len += n;
+            return;
+        }
+        //did not fit behind the batched lines, retry in an empty buffer
+        if (w->len == 0) break;
+        writer_flush(w);
+    }
+    //longer than a whole block: left out, a cut line would break the exposition
+}
+
+esp_err_t metrics_get_handler(httpd_req_t *req) {
+    int64_t start_us = esp_timer_get_time();
+    //lines are batched in a block of the pool given as user ctx, not on the httpd stack
+    buf_pool_t *io_pool = (buf_pool_t *)req->user_ctx;
+    metrics_writer_t w = {
+        .req = req,
+        .buf = (char *)buf_pool_get(io_pool),
+        .size = io_pool->block_size,
+        .len = 0,
+        .total = 0,
+        .err = ESP_OK
+    };
+    if (w.buf == NULL) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "1");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+
+    writer_line(&w, "# TYPE httpd_request_duration_us histogram\n");
+    for (int r = 0; r < METRIC_ROUTE_CNT; r++) {
+        const route_label_t *l = &route_labels[r];
+        route_metrics_t *m = &routes[r];
+        unsigned int cumulative = 0;
+
+        for (int b = 0; b < METRICS_LAT_BUCKETS; b++) {
+            cumulative += atomic_load_explicit(&m->lat_buckets[b], memory_order_relaxed);
+            if (b == METRICS_LAT_BUCKETS - 1) {
+                writer_line(&w, "httpd_request_duration_us_bucket{uri=\"%s\",method=\"%s\",le=\"+Inf\"} %u\n",
+                            l->uri, l->method, cumulative);
+            } else {
+                writer_line(&w, "httpd_request_duration_us_bucket{uri=\"%s\",method=\"%s\",le=\"%u\"} %u\n",
+                            l->uri, l->method, 1u << b, cumulative);
+            }
+        }
+        writer_line(&w, "httpd_request_duration_us_sum{uri=\"%s\",method=\"%s\"} %u\n",
+                    l->uri, l->method, atomic_load(&m->lat_sum_us));
+        writer_line(&w, "httpd_request_duration_us_count{uri=\"%s\",method=\"%s\"} %u\n",
+                    l->uri, l->method, atomic_load(&m->count));
+    }
+
+    writer_line(&w, "# TYPE httpd_response_bytes_total counter\n");
+    for (int r = 0; r < METRIC_ROUTE_CNT; r++) {
+        writer_line(&w, "httpd_response_bytes_total{uri=\"%s\",method=\"%s\"} %u\n",
+                    route_labels[r].uri, route_labels[r].method, atomic_load(&routes[r].bytes));
+    }
+
+    for (int c = 0; c < METRIC_CNT_CNT; c++) {
+        writer_line(&w, "# TYPE %s counter\n", counter_names[c]);
+        writer_line(&w, "%s %u\n", counter_names[c], atomic_load(&counters[c]));
+    }
+    writer_line(&w, "# TYPE cmd_bus_ring_dropped_total counter\n");
+    writer_line(&w, "cmd_bus_ring_dropped_total %u\n", (unsigned int)cmd_bus_dropped_total());
+
+    //every family is written whole, one pool per sample
+    int pool_cnt;
+    buf_pool_t *const *pools = buf_pool_list(&pool_cnt);
+    writer_line(&w, "# TYPE buf_pool_blocks gauge\n");
+    for (int i = 0; i < pool_cnt; i++) {
+        writer_line(&w, "buf_pool_blocks{pool=\"%s\"} %d\n", pools[i]->name, pools[i]->block_cnt);
+    }
+    writer_line(&w, "# TYPE buf_pool_in_use gauge\n");
+    for (int i = 0; i < pool_cnt; i++) {
+        writer_line(&w, "buf_pool_in_use{pool=\"%s\"} %u\n", pools[i]->name, atomic_load(&pools[i]->in_use));
+    }
+    writer_line(&w, "# TYPE buf_pool_high_water gauge\n");
+    for (int i = 0; i < pool_cnt; i++) {
+        writer_line(&w, "buf_pool_high_water{pool=\"%s\"} %u\n", pools[i]->name, atomic_load(&pools[i]->high_water));
+    }
+    writer_line(&w, "# TYPE buf_pool_exhausted_total counter\n");
+    for (int i = 0; i < pool_cnt; i++) {
+        writer_line(&w, "buf_pool_exhausted_total{pool=\"%s\"} %u\n", pools[i]->name,
+                    atomic_load(&pools[i]->exhausted));
+    }
+
+    int pending_high;
+    int pending = http_workers_pending(&pending_high);
+    writer_line(&w, "# TYPE http_workers_slots gauge\n");
+    writer_line(&w, "http_workers_slots %d\n", HTTP_PENDING_MAX);
+    writer_line(&w, "# TYPE http_workers_pending gauge\n");
+    writer_line(&w, "http_workers_pending %d\n", pending);
+    writer_line(&w, "# TYPE http_workers_pending_high_water gauge\n");
+    writer_line(&w, "http_workers_pending_high_water %d\n", pending_high);
+
+    //handlers run on the httpd task, so this is the least free httpd stack seen since boot
+    writer_line(&w, "# TYPE httpd_stack_free_min_bytes gauge\n");
+    writer_line(&w, "httpd_stack_free_min_bytes %u\n", (unsigned int)uxTaskGetStackHighWaterMark(NULL));
+
+    writer_flush(&w);
+    if (w.err == ESP_OK) w.err = httpd_resp_send_chunk(req, NULL, 0);
+    buf_pool_put(io_pool, w.buf);
+
+    metrics_record(METRIC_ROUTE_METRICS_GET, start_us, w.total);
+    return w.err;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+/*
+lock-free request metrics of the web server, exposed in prometheus text format.
+
+- every route has a request counter, a response byte counter and a log2 bucketed latency histogram in us.
+- recording is a few relaxed atomic adds, safe from any task.
+- 32-bit counters wrap, prometheus treats that as a counter reset.
+*/
+
+#define METRICS_LAT_BUCKETS     20  //le = 1, 2, 4 ... 2^18 us, +Inf
+
+typedef enum {
+    METRIC_ROUTE_INDEX_GET = 0,
+    METRIC_ROUTE_CMD_POST,
+    METRIC_ROUTE_BATCH_POST,
+    METRIC_ROUTE_STATUS_GET,
+    METRIC_ROUTE_WS,
+    METRIC_ROUTE_STATIC_GET,
+    METRIC_ROUTE_METRICS_GET,
+    METRIC_ROUTE_EVENTS_GET,
+    METRIC_ROUTE_API_LED_GET,
+    METRIC_ROUTE_API_LED_PUT,
+    METRIC_ROUTE_API_PRINT_POST,
+    METRIC_ROUTE_CNT
+} metric_route_t;
+
+typedef enum {
+    METRIC_CNT_BUS_POOL_EMPTY = 0,  //cmd dropped before publish, no free bus message
+    METRIC_CNT_BAD_REQ,             //malformed bodies and frames
+    METRIC_CNT_ADMITTED,            //cmds that got an admission token
+    METRIC_CNT_THROTTLED,           //cmds and requests refused by admission control
+    METRIC_CNT_INDEX_CYCLES,        //cpu cycles spent sending the index page, divide by its request count
+    METRIC_CNT_SSE_SKIPPED,         //events a slow SSE client missed because the ring wrapped
+    METRIC_CNT_UDP_CMDS,            //cmds published from the udp control endpoint
+    METRIC_CNT_CNT
+} metric_counter_t;
+
+/* start_us is the esp_timer_get_time() taken when the handler was entered */
+void metrics_record(metric_route_t route, int64_t start_us, size_t resp_bytes);
+
+void metrics_inc(metric_counter_t cnt);
+
+void metrics_add(metric_counter_t cnt, uint32_t n);
+
+/* GET /metrics */
+esp_err_t metrics_get_handler(httpd_req_t *req);
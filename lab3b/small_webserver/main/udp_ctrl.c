@@ -0,0 +1,162 @@
+#include <stddef.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include "udp_ctrl.h"
+#include "udp_ctrl_proto.h"
+#include "cmd_bus.h"
+#include "admission.h"
+#include "metrics.h"
+
+_Static_assert(UDP_CMD_TOGGLE == CMD_ID_TOGGLE && UDP_CMD_STR == CMD_ID_STR, "udp cmd ids must match cmd_id_t");
+_Static_assert(UDP_CTRL_VALUE_MAX == VAL_BUF_SIZE - 1, "udp value must fit a bus message");
+_Static_assert(offsetof(udp_cmd_pkt_t, value) == UDP_CMD_HDR_SIZE, "udp cmd header layout");
+
+static const char *TAG = "UDP_CTRL";
+
+_Static_assert(UDP_CTRL_DUP_WINDOW == 32, "the executed seqs are a 32 bit mask");
+
+typedef struct {
+    uint32_t ip;
+    uint16_t port;
+    uint32_t last_seq;      //newest executed seq, only valid once seq_seen
+    uint32_t ran;           //bit i: seq last_seq - i was executed
+    uint32_t tickets[UDP_CTRL_DUP_WINDOW];  //by seq % UDP_CTRL_DUP_WINDOW, acked again for a retransmission
+    bool seq_seen;          //a cmd of this peer was executed, last_seq is its seq
+    TickType_t seen;
+} udp_peer_t;
+
+//only touched by the udp task
+static udp_peer_t peers[UDP_CTRL_MAX_PEERS];
+
+static udp_peer_t *peer_find(const struct sockaddr_in *from) {
+    udp_peer_t *lru = &peers[0];
+
+    for (int i = 0; i < UDP_CTRL_MAX_PEERS; i++) {
+        if (peers[i].ip == from->sin_addr.s_addr && peers[i].port == from->sin_port) return &peers[i];
+        if (peers[i].seen < lru->seen) lru = &peers[i];
+    }
+
+    //the least recently seen peer is forgotten, nothing of it may be taken for the new peer's history
+    lru->ip = from->sin_addr.s_addr;
+    lru->port = from->sin_port;
+    lru->ran = 0;
+    lru->seq_seen = false;
+    return lru;
+}
+
+//serial number arithmetic, seq may wrap. a seq at least UDP_CTRL_DUP_WINDOW behind the newest one is a client
+//restarted on the same ip:port rather than a late retransmission
+static int32_t seq_behind(const udp_peer_t *peer, uint32_t seq) {
+    return (int32_t)(peer->last_seq - seq);
+}
+
+/* only a seq that was executed is a duplicate, one that arrives out of order or is retried after a throttled or
+busy ack still runs */
+static bool seq_ran(const udp_peer_t *peer, uint32_t seq, uint32_t *ticket) {
+    int32_t behind = seq_behind(peer, seq);
+    if (!peer->seq_seen || behind < 0 || behind >= UDP_CTRL_DUP_WINDOW || !(peer->ran & (1u << behind))) return false;
+    *ticket = peer->tickets[seq % UDP_CTRL_DUP_WINDOW];
+    return true;
+}
+
+static void seq_mark_ran(udp_peer_t *peer, uint32_t seq, uint32_t ticket) {
+    int32_t behind = seq_behind(peer, seq);
+    if (!peer->seq_seen || behind >= UDP_CTRL_DUP_WINDOW) {
+        peer->ran = 0;
+        behind = 0;
+        peer->last_seq = seq;
+        peer->seq_seen = true;
+    } else if (behind < 0) {
+        peer->ran = (-behind < UDP_CTRL_DUP_WINDOW) ? peer->ran << -behind : 0;
+        behind = 0;
+        peer->last_seq = seq;
+    }
+    peer->ran |= 1u << behind;
+    peer->tickets[seq % UDP_CTRL_DUP_WINDOW] = ticket;
+}
+
+/* validate, dedup, admit and publish one datagram. *ticket is set for UDP_ACK_OK and UDP_ACK_DUP */
+static udp_ack_status_t udp_handle_cmd(const udp_cmd_pkt_t *pkt, int len, const struct sockaddr_in *from,
+                                       uint32_t *ticket) {
+    *ticket = 0;
+    if (len < UDP_CMD_HDR_SIZE || pkt->magic != UDP_CTRL_MAGIC || pkt->version != UDP_CTRL_VERSION ||
+        pkt->len > len - UDP_CMD_HDR_SIZE || (pkt->cmd != UDP_CMD_TOGGLE && pkt->cmd != UDP_CMD_STR)) {
+        metrics_inc(METRIC_CNT_BAD_REQ);
+        return UDP_ACK_BAD;
+    }
+
+    udp_peer_t *peer = peer_find(from);
+    peer->seen = xTaskGetTickCount();
+    if (seq_ran(peer, pkt->seq, ticket)) return UDP_ACK_DUP;
+
+    if (!admission_take(from->sin_addr.s_addr)) {
+        metrics_inc(METRIC_CNT_THROTTLED);
+        return UDP_ACK_THROTTLED;
+    }
+    metrics_inc(METRIC_CNT_ADMITTED);
+
+    cmd_msg_t *msg = cmd_bus_alloc();
+    if (msg == NULL) {
+        metrics_inc(METRIC_CNT_BUS_POOL_EMPTY);
+        return UDP_ACK_BUSY;
+    }
+    msg->id = (cmd_id_t)pkt->cmd;
+    memcpy(msg->value, pkt->value, pkt->len);
+    msg->value[pkt->len] = '\0';
+    *ticket = cmd_bus_publish(msg);
+
+    //only executed cmds are marked, a throttled or busy one can be retried with the same seq
+    seq_mark_ran(peer, pkt->seq, *ticket);
+    metrics_inc(METRIC_CNT_UDP_CMDS);
+    return UDP_ACK_OK;
+}
+
+static void udp_ctrl_task(void *pvParameters) {
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(UDP_CTRL_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        ESP_LOGI(TAG, "cannot listen on udp port %d", UDP_CTRL_PORT);
+        if (sock >= 0) close(sock);
+        vTaskDelete(NULL);
+        return;
+    }
+    ESP_LOGI(TAG, "listening on udp port %d", UDP_CTRL_PORT);
+
+    for (;;) {
+        udp_cmd_pkt_t pkt;
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+
+        int len = recvfrom(sock, &pkt, sizeof(pkt), 0, (struct sockaddr *)&from, &from_len);
+        if (len < 0) continue;
+
+        uint32_t ticket;
+        udp_ack_status_t st = udp_handle_cmd(&pkt, len, &from, &ticket);
+        //a bad datagram may not even have a valid flags byte, it is never acked
+        if (st == UDP_ACK_BAD || !(pkt.flags & UDP_FLAG_ACK)) continue;
+
+        udp_ack_pkt_t ack = {
+            .magic = UDP_CTRL_ACK_MAGIC,
+            .version = UDP_CTRL_VERSION,
+            .status = st,
+            .seq = pkt.seq,
+            .ticket = ticket,
+        };
+        sendto(sock, &ack, sizeof(ack), 0, (struct sockaddr *)&from, from_len);
+    }
+
+    vTaskDelete(NULL);
+}
+
+void udp_ctrl_init(void) {
+    if (xTaskCreate(&udp_ctrl_task, "udp_ctrl", UDP_CTRL_TASK_STACK, NULL, UDP_CTRL_TASK_PRIO, NULL) == pdPASS) {
+        ESP_LOGI(TAG, "udp_ctrl created success");
+    }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+/*
+udp control endpoint: compact fixed layout command datagrams (udp_ctrl_proto.h) fed into the cmd bus
+through the same admission control as the http cmds, without a tcp handshake, headers or html per cmd.
+one task receives, validates, dedups by seq and publishes, then acks when asked to.
+*/
+
+#define UDP_CTRL_TASK_STACK     2560
+#define UDP_CTRL_TASK_PRIO      5
+#define UDP_CTRL_MAX_PEERS      4       //ip:port pairs remembered for duplicate detection
+#define UDP_CTRL_DUP_WINDOW     32      //executed seqs remembered per peer, up to this far behind the newest
+
+/* start the listener task, the network must be up */
+void udp_ctrl_init(void);
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+wire format of the udp control endpoint, shared by the firmware and host/udp_ctrl_client.c.
+
+- one command per datagram, fixed header followed by len bytes of value (no NUL on the wire).
+- integers are little endian, which both the esp32 and the usual hosts are, so the packed structs are sent as is.
+- seq is chosen by the client, a datagram whose seq was already executed for the same ip:port is a
+retransmission: it is acked again with the same ticket (UDP_ACK_DUP) but not executed twice. the server remembers
+the seqs less than UDP_CTRL_DUP_WINDOW behind the newest executed one, so an older seq that did not run yet (out
+of order, or retried after UDP_ACK_THROTTLED/UDP_ACK_BUSY) still runs. a seq further behind is taken as a
+restarted client.
+- UDP_FLAG_ACK asks for an ack datagram carrying the seq and the bus ticket.
+*/
+
+#define UDP_CTRL_PORT           3333
+#define UDP_CTRL_MAGIC          0xc5
+#define UDP_CTRL_ACK_MAGIC      0xca
+#define UDP_CTRL_VERSION        1
+#define UDP_CTRL_VALUE_MAX      49      //VAL_BUF_SIZE - 1, the value plus NUL fits a bus message
+
+#define UDP_FLAG_ACK            0x01
+
+//same numbering as cmd_id_t
+#define UDP_CMD_TOGGLE          1
+#define UDP_CMD_STR             2
+
+typedef enum {
+    UDP_ACK_OK = 0,
+    UDP_ACK_DUP,                //retransmission of a cmd already executed
+    UDP_ACK_THROTTLED,          //refused by admission control
+    UDP_ACK_BUSY,               //no free bus message
+    UDP_ACK_BAD,                //malformed datagram or unknown cmd
+} udp_ack_status_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t magic;
+    uint8_t version;
+    uint8_t cmd;
+    uint8_t flags;
+    uint32_t seq;
+    uint8_t len;
+    char value[UDP_CTRL_VALUE_MAX];
+} udp_cmd_pkt_t;
+
+#define UDP_CMD_HDR_SIZE        9       //udp_cmd_pkt_t without value
+
+typedef struct __attribute__((packed)) {
+    uint8_t magic;
+    uint8_t version;
+    uint8_t status;
+    uint8_t reserved;
+    uint32_t seq;
+    uint32_t ticket;            //0 unless status is UDP_ACK_OK
+} udp_ack_pkt_t;
@@ -0,0 +1,95 @@
+/*
+ * tokenize_bench: line tokenizer throughput on a capture
+ * - baseline is std::getline from an ifstream plus the same "(ts) TAG:" match on every line,
+ *   which is how a quick host script would read the log
+ * - then LineTokenizer with each instruction set over the mapped file
+ * - best of N passes, the file is small enough to stay in the page cache
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <string>
+
+#include "schedlog/line_parser.hpp"
+#include "schedlog/mapped_file.hpp"
+#include "schedlog/tokenizer.hpp"
+
+using namespace schedlog;
+
+namespace {
+
+struct Count {
+    uint64_t lines = 0;
+    uint64_t stamped = 0;
+    uint64_t bytes = 0;
+};
+
+using Clock = std::chrono::steady_clock;
+
+Count run_getline(const char *path) {
+    Count c;
+    std::ifstream in(path, std::ios::binary);
+    std::string line;
+    LogLine ln;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        c.lines++;
+        c.bytes += line.size();
+        if (parse_line(std::string_view(line), ln)) c.stamped++;
+    }
+    return c;
+}
+
+Count run_tokenizer(std::string_view buf, Isa isa) {
+    Count c;
+    LineTokenizer tok(buf, isa);
+    LineView v;
+    while (tok.next(v)) {
+        c.lines++;
+        c.bytes += v.raw.size();
+        if (v.has_stamp) c.stamped++;
+    }
+    return c;
+}
+
+template <typename Fn>
+void bench(const char *name, size_t size, int passes, Fn fn) {
+    double best = 1e9;
+    Count c;
+    for (int i = 0; i < passes; i++) {
+        auto t0 = Clock::now();
+        c = fn();
+        double s = std::chrono::duration<double>(Clock::now() - t0).count();
+        if (s < best) best = s;
+    }
+    printf("%-10s %8.3f ms %7.2f GB/s  lines %llu, stamped %llu\n", name, best * 1e3, size / best / 1e9,
+           static_cast<unsigned long long>(c.lines), static_cast<unsigned long long>(c.stamped));
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s LOG [passes]\n", argv[0]);
+        return 2;
+    }
+    int passes = argc > 2 ? atoi(argv[2]) : 20;
+    if (passes < 1) passes = 1;
+
+    try {
+        MappedFile file(argv[1]);
+        std::string_view buf = file.bytes();
+        printf("%s: %zu bytes, best of %d, best isa %s\n", argv[1], buf.size(), passes, isa_name(Isa::Best));
+
+        bench("getline", buf.size(), passes, [&] { return run_getline(argv[1]); });
+        bench("scalar", buf.size(), passes, [&] { return run_tokenizer(buf, Isa::Scalar); });
+        bench("sse2", buf.size(), passes, [&] { return run_tokenizer(buf, Isa::Sse2); });
+        bench("avx2", buf.size(), passes, [&] { return run_tokenizer(buf, Isa::Avx2); });
+    } catch (const std::exception &e) {
+        fprintf(stderr, "tokenize_bench: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "schedlog/tokenizer.hpp"
+
+namespace schedlog {
+
+/*
+ * what the parser got out of one line
+ * - head is the "(ts) TAG:" the line starts with, after ansi colour codes and an optional "I " level letter
+ * - extra holds further "(ts) TAG:" pairs inside the message, e.g. the idle task timestamp the preempt lab
+ *   appends to every task line, only the first few are kept
+ * - body is the text after the head tag
+ */
+struct LogLine {
+    static constexpr size_t kMaxExtra = 4;
+
+    bool has_head = false;
+    char level = 0;
+    Stamp head;
+    Stamp extra[kMaxExtra];
+    size_t extra_cnt = 0;
+    std::string_view body;
+};
+
+/* parse a single line (without its terminator), returns false when it has no leading "(ts) TAG:" */
+bool parse_line(std::string_view line, LogLine &out);
+
+/* same, reusing the head the tokenizer already matched */
+bool parse_line(const LineView &line, LogLine &out);
+
+}  // namespace schedlog
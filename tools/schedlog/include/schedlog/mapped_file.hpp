@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace schedlog {
+
+/* read only mapping of a whole file, the bytes stay valid as long as the object lives */
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    std::string_view bytes() const { return {static_cast<const char *>(data_), size_}; }
+
+private:
+    void *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+}  // namespace schedlog
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "schedlog/line_parser.hpp"
+
+namespace schedlog {
+
+struct Options {
+    //analyze boot output too, by default everything before "Starting scheduler" is skipped
+    bool all = false;
+    //turn "(ts) TAG:" pairs inside a message into events (the idle timestamp of the preempt lab)
+    bool extra = true;
+    //only these tags are events, empty means every tag
+    std::vector<std::string> tags;
+};
+
+/*
+ * log2 buckets for run lengths in ms
+ * - bucket 0 is a 0 ms run (two switches inside one tick), bucket k covers [2^(k-1), 2^k)
+ */
+constexpr size_t kHistBuckets = 18;
+
+struct TaskStats {
+    std::string name;
+    uint64_t lines = 0;
+    uint64_t runs = 0;
+    uint64_t busy_ms = 0;
+    uint64_t hist[kHistBuckets] = {};
+    //one entry per run, not per line
+    std::vector<uint32_t> slices;
+    //time between the end of one run and the start of the next one of the same task
+    std::vector<uint32_t> gaps;
+
+    uint32_t first_start = 0;
+    bool started = false;
+    uint32_t last_end = 0;
+    bool ran = false;
+    uint32_t last_extra = 0;
+    bool seen_extra = false;
+};
+
+struct Summary {
+    uint64_t bytes = 0;
+    uint64_t lines = 0;
+    uint64_t parsed = 0;
+    uint64_t events = 0;
+    uint64_t switches = 0;
+    uint64_t clamped = 0;
+    uint32_t segments = 0;
+    uint32_t first_ms = 0;
+    uint32_t last_ms = 0;
+    bool has_events = false;
+
+    uint32_t span_ms() const { return has_events ? last_ms - first_ms : 0; }
+};
+
+/*
+ * rebuilds who was running from the order of the task log lines
+ * - a task is taken as running from its first line until the first line of another task,
+ *   so consecutive lines of the same tag are one run and a change of tag is one context switch
+ * - timestamps are the esp_log ms clock, a small step backwards (lines printed out of order by
+ *   different cores) is clamped, a big one is a reset and starts a new segment that continues
+ *   the timeline where the previous one stopped
+ */
+class SchedModel {
+public:
+    explicit SchedModel(const Options &opt) : opt_(opt) {}
+
+    //one log per model, the views in buf are only used during the call
+    void analyze(std::string_view buf);
+
+    const std::vector<TaskStats> &tasks() const { return tasks_; }
+    const Summary &summary() const { return sum_; }
+
+private:
+    static constexpr uint32_t kResetJumpMs = 1000;
+
+    int intern(std::string_view tag);
+    bool wanted(std::string_view tag) const;
+    void event(uint32_t t, int id);
+    void close_run(uint32_t t);
+    void start_segment(uint32_t raw_ms);
+    void feed(const LogLine &ln);
+
+    const Options &opt_;
+    std::vector<TaskStats> tasks_;
+    int last_hit_ = -1;
+    Summary sum_;
+
+    int cur_ = -1;
+    uint32_t cur_start_ = 0;
+    uint32_t offset_ = 0;
+    uint32_t raw_last_ = 0;
+    bool raw_valid_ = false;
+    bool seg_open_ = false;
+    bool has_marker_ = false;
+    bool in_boot_ = false;
+};
+
+//nearest rank percentile of an unsorted sample, p in [0, 100]
+uint32_t percentile(std::vector<uint32_t> v, double p);
+
+double mean(const std::vector<uint32_t> &v);
+
+/*
+ * stretches of at least min_ms in which a task did not run
+ * - the gaps between its runs, plus the time before its first run and after its last one,
+ *   a task that never ran is starved for the whole span, one that ran only once is not counted
+ */
+struct Starvation {
+    uint64_t windows = 0;
+    uint64_t total_ms = 0;
+    uint32_t max_ms = 0;
+};
+
+Starvation starvation(const TaskStats &t, const Summary &s, uint32_t min_ms);
+
+}  // namespace schedlog
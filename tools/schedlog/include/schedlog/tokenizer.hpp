@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace schedlog {
+
+/*
+ * one "(timestamp) TAG:" pair found in a log line
+ * - the views point into the scanned buffer, nothing is copied
+ */
+struct Stamp {
+    uint32_t ms = 0;
+    std::string_view tag;
+};
+
+/*
+ * one line of a serial capture
+ * - raw is the whole line without its terminator
+ * - text is raw without the leading colour codes and the trailing "ESC[0m" reset
+ * - esc is how many ESC bytes raw has, 0 means text == raw and nothing needs stripping
+ * - when text starts with an optional "I " level and "(ts) TAG:", has_stamp is set and msg is
+ *   the rest of the line after the colon
+ */
+struct LineView {
+    std::string_view raw;
+    std::string_view text;
+    uint32_t esc = 0;
+    bool has_stamp = false;
+    char level = 0;
+    Stamp stamp;
+    std::string_view msg;
+};
+
+/* instruction set used to find the structural bytes, Best picks the widest one the cpu has */
+enum class Isa { Best, Scalar, Sse2, Avx2 };
+
+/* what Best resolves to on this machine */
+Isa best_isa();
+const char *isa_name(Isa isa);
+
+/*
+ * zero copy line splitter for serial captures
+ * - classifies 64 bytes at a time into bitmasks of line terminators ('\n', '\r') and ESC bytes,
+ *   with two 32 byte avx2 or four 16 byte sse2 compares per block, then walks the set bits,
+ *   so the bytes between them are never looked at one by one
+ * - "\n", "\r\n" and a bare "\r" all end a line, the captures mix them
+ * - the "(ts) TAG:" prefix is matched from digit and tag-character masks of the first 32 bytes of text
+ */
+class LineTokenizer {
+public:
+    explicit LineTokenizer(std::string_view buf, Isa isa = Isa::Best);
+
+    bool next(LineView &out);
+    size_t offset() const { return pos_; }
+
+private:
+    using ScanFn = void (*)(const char *p, uint64_t &eol, uint64_t &esc);
+    using ClassifyFn = void (*)(const char *p, uint32_t &digit, uint32_t &tag);
+
+    void load(size_t base);
+    void seek(size_t p);
+    bool match_prefix(std::string_view t, size_t &i, Stamp &out) const;
+
+    std::string_view buf_;
+    ScanFn scan_;
+    ClassifyFn classify_ = nullptr;
+    size_t pos_ = 0;
+    size_t base_ = 0;
+    uint64_t eol_ = 0;
+    uint64_t esc_ = 0;
+};
+
+//skip "ESC [ params final" sequences starting at i
+size_t skip_ansi(std::string_view s, size_t i);
+
+//match "(digits) TAG:" at i, on success i is moved past the colon
+bool match_stamp(std::string_view s, size_t &i, Stamp &out);
+
+}  // namespace schedlog
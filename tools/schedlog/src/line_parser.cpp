@@ -0,0 +1,60 @@
+#include "schedlog/line_parser.hpp"
+
+#include <cstring>
+
+namespace schedlog {
+
+namespace {
+
+//later pairs, only worth a look at each '('
+void parse_extra(std::string_view s, LogLine &out) {
+    size_t i = 0;
+    while (out.extra_cnt < LogLine::kMaxExtra) {
+        const void *open = memchr(s.data() + i, '(', s.size() - i);
+        if (open == nullptr) break;
+        i = static_cast<const char *>(open) - s.data();
+        if (!match_stamp(s, i, out.extra[out.extra_cnt])) {
+            i++;
+            continue;
+        }
+        out.extra_cnt++;
+    }
+}
+
+}  // namespace
+
+bool parse_line(std::string_view line, LogLine &out) {
+    out.has_head = false;
+    out.level = 0;
+    out.extra_cnt = 0;
+    out.body = {};
+
+    size_t i = skip_ansi(line, 0);
+    if (i + 1 < line.size() && line[i + 1] == ' ' &&
+        (line[i] == 'E' || line[i] == 'W' || line[i] == 'I' || line[i] == 'D' || line[i] == 'V')) {
+        out.level = line[i];
+        i += 2;
+    }
+    if (!match_stamp(line, i, out.head)) return false;
+    out.has_head = true;
+    out.body = line.substr(i);
+    parse_extra(out.body, out);
+    return true;
+}
+
+bool parse_line(const LineView &line, LogLine &out) {
+    out.extra_cnt = 0;
+    out.has_head = line.has_stamp;
+    if (!line.has_stamp) {
+        out.level = 0;
+        out.body = {};
+        return false;
+    }
+    out.level = line.level;
+    out.head = line.stamp;
+    out.body = line.msg;
+    parse_extra(out.body, out);
+    return true;
+}
+
+}  // namespace schedlog
@@ -0,0 +1,193 @@
+#include "schedlog/sched_model.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace schedlog {
+
+namespace {
+
+constexpr std::string_view kMarkerTag = "cpu_start";
+constexpr std::string_view kMarkerText = "Starting scheduler";
+
+size_t bucket_of(uint32_t ms) {
+    size_t b = 0;
+    while (ms != 0 && b + 1 < kHistBuckets) {
+        ms >>= 1;
+        b++;
+    }
+    return b;
+}
+
+}  // namespace
+
+uint32_t percentile(std::vector<uint32_t> v, double p) {
+    if (v.empty()) return 0;
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * v.size()));
+    if (rank > 0) rank--;
+    if (rank >= v.size()) rank = v.size() - 1;
+    std::nth_element(v.begin(), v.begin() + rank, v.end());
+    return v[rank];
+}
+
+double mean(const std::vector<uint32_t> &v) {
+    if (v.empty()) return 0;
+    uint64_t sum = 0;
+    for (uint32_t x : v) sum += x;
+    return static_cast<double>(sum) / v.size();
+}
+
+Starvation starvation(const TaskStats &t, const Summary &s, uint32_t min_ms) {
+    Starvation out;
+    auto add = [&](uint32_t len) {
+        if (len < min_ms || len == 0) return;
+        out.windows++;
+        out.total_ms += len;
+        if (len > out.max_ms) out.max_ms = len;
+    };
+    if (!t.started) {
+        add(s.span_ms());
+        return out;
+    }
+    //one run is setup code like app_main that logs and returns, it is not waiting for the cpu
+    if (t.runs <= 1) return out;
+    add(t.first_start - s.first_ms);
+    for (uint32_t g : t.gaps) add(g);
+    if (t.ran) add(s.last_ms - t.last_end);
+    return out;
+}
+
+int SchedModel::intern(std::string_view tag) {
+    if (last_hit_ >= 0 && tasks_[last_hit_].name == tag) return last_hit_;
+    //a lab has a handful of tasks, a linear scan beats hashing every line
+    for (size_t i = 0; i < tasks_.size(); i++) {
+        if (tasks_[i].name == tag) return last_hit_ = static_cast<int>(i);
+    }
+    tasks_.emplace_back();
+    tasks_.back().name = std::string(tag);
+    return last_hit_ = static_cast<int>(tasks_.size() - 1);
+}
+
+bool SchedModel::wanted(std::string_view tag) const {
+    if (opt_.tags.empty()) return true;
+    for (const auto &t : opt_.tags) {
+        if (t == tag) return true;
+    }
+    return false;
+}
+
+void SchedModel::close_run(uint32_t t) {
+    TaskStats &c = tasks_[cur_];
+    uint32_t len = t - cur_start_;
+    c.runs++;
+    c.busy_ms += len;
+    c.hist[bucket_of(len)]++;
+    c.slices.push_back(len);
+    c.last_end = t;
+    c.ran = true;
+}
+
+void SchedModel::event(uint32_t t, int id) {
+    if (!sum_.has_events) {
+        sum_.first_ms = sum_.last_ms = t;
+        sum_.has_events = true;
+    }
+    if (!seg_open_) {
+        sum_.segments++;
+        seg_open_ = true;
+    }
+    if (t < sum_.last_ms) {
+        t = sum_.last_ms;
+        sum_.clamped++;
+    }
+    sum_.last_ms = t;
+    sum_.events++;
+    if (id == cur_) return;
+
+    if (cur_ >= 0) {
+        close_run(t);
+        sum_.switches++;
+    }
+    TaskStats &n = tasks_[id];
+    if (!n.started) {
+        n.first_start = t;
+        n.started = true;
+    }
+    if (n.ran) n.gaps.push_back(t - n.last_end);
+    cur_ = id;
+    cur_start_ = t;
+}
+
+//a reboot restarts the ms clock, glue the new boot onto the end of the timeline
+void SchedModel::start_segment(uint32_t raw_ms) {
+    if (cur_ >= 0) close_run(sum_.last_ms);
+    cur_ = -1;
+    seg_open_ = false;
+    raw_valid_ = false;
+    offset_ = (sum_.has_events && sum_.last_ms > raw_ms) ? sum_.last_ms - raw_ms : 0;
+}
+
+void SchedModel::feed(const LogLine &ln) {
+    sum_.parsed++;
+    uint32_t raw = ln.head.ms;
+
+    if (!opt_.all && ln.head.tag == kMarkerTag && ln.body.find(kMarkerText) != std::string_view::npos) {
+        start_segment(raw);
+        in_boot_ = false;
+        return;
+    }
+    if (in_boot_) return;
+
+    if (raw_valid_ && raw + kResetJumpMs < raw_last_) {
+        start_segment(raw);
+        if (has_marker_) {
+            //skip the boot output of the new run up to its own marker
+            in_boot_ = true;
+            return;
+        }
+    }
+    raw_last_ = raw;
+    raw_valid_ = true;
+
+    if (!wanted(ln.head.tag)) return;
+    int id = intern(ln.head.tag);
+    tasks_[id].lines++;
+    uint32_t t = offset_ + raw;
+
+    if (opt_.extra) {
+        for (size_t i = 0; i < ln.extra_cnt; i++) {
+            const Stamp &x = ln.extra[i];
+            if (!wanted(x.tag)) continue;
+            int xid = intern(x.tag);
+            if (xid == id) continue;
+            TaskStats &xs = tasks_[xid];
+            bool fresh = xs.seen_extra && x.ms != xs.last_extra;
+            xs.last_extra = x.ms;
+            xs.seen_extra = true;
+            //a new sample means that task ran after the current run started and before this line
+            uint32_t xt = offset_ + x.ms;
+            if (fresh && cur_ >= 0 && cur_ != xid && xt >= cur_start_ && xt <= t) event(xt, xid);
+        }
+    }
+    event(t, id);
+}
+
+void SchedModel::analyze(std::string_view buf) {
+    sum_.bytes += buf.size();
+    has_marker_ = !opt_.all && buf.find(kMarkerText) != std::string_view::npos;
+    in_boot_ = has_marker_;
+    raw_valid_ = false;
+
+    LineTokenizer tok(buf);
+    LineView line;
+    LogLine ln;
+    while (tok.next(line)) {
+        sum_.lines++;
+        if (parse_line(line, ln)) feed(ln);
+    }
+    if (cur_ >= 0) close_run(sum_.last_ms);
+    cur_ = -1;
+    seg_open_ = false;
+}
+
+}  // namespace schedlog
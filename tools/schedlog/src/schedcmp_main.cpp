@@ -0,0 +1,236 @@
+/*
+ * schedcmp: the same tasks under different scheduler settings, side by side
+ * - every log is mapped and analyzed on its own thread (up to -j at a time), then the tasks are
+ *   lined up by tag and each metric is printed per log, with the change against the first log
+ * - starvation windows are stretches of at least -s ms in which a task did not run
+ * - ends with one verdict line per log: switch rate, biggest cpu share shift, tasks that starve
+ *   more than in the first log
+ */
+#include <getopt.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "schedlog/mapped_file.hpp"
+#include "schedlog/sched_model.hpp"
+
+using namespace schedlog;
+
+namespace {
+
+struct Run {
+    const char *path = nullptr;
+    std::unique_ptr<SchedModel> model;
+    std::string error;
+};
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-a] [-n] [-j JOBS] [-s MS] [-t TAG,TAG...] BASELINE LOG...\n"
+            "  -a  include the boot output before \"Starting scheduler\"\n"
+            "  -n  ignore \"(ts) TAG:\" pairs inside messages (e.g. the idle timestamp)\n"
+            "  -j  logs analyzed at once, default one per cpu\n"
+            "  -s  shortest starvation window in ms, default 500\n"
+            "  -t  only these tags are tasks\n",
+            prog);
+}
+
+std::vector<std::string> split_tags(const char *arg) {
+    std::vector<std::string> out;
+    std::string cur;
+    for (const char *p = arg;; p++) {
+        if (*p == ',' || *p == '\0') {
+            if (!cur.empty()) out.push_back(cur);
+            cur.clear();
+            if (*p == '\0') break;
+        } else {
+            cur += *p;
+        }
+    }
+    return out;
+}
+
+const char *base_name(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+const TaskStats *find_task(const SchedModel &m, const std::string &name) {
+    for (const TaskStats &t : m.tasks()) {
+        if (t.name == name) return &t;
+    }
+    return nullptr;
+}
+
+double cpu_share(const TaskStats &t, const Summary &s) {
+    uint32_t span = s.span_ms();
+    return span ? t.busy_ms * 100.0 / span : 0.0;
+}
+
+constexpr int kCol = 18;
+
+//one metric row, "-" where the log does not have the task, "(+d)" against the first log
+template <typename Fn>
+void metric_row(const char *task, const char *metric, const std::vector<Run> &runs, const std::string &name,
+                int prec, Fn value) {
+    printf("%-24s %-12s", task, metric);
+    const TaskStats *base = find_task(*runs[0].model, name);
+    double bv = base ? value(*base, runs[0].model->summary()) : 0;
+    for (size_t i = 0; i < runs.size(); i++) {
+        char cell[64];
+        const TaskStats *t = find_task(*runs[i].model, name);
+        if (t == nullptr) {
+            snprintf(cell, sizeof(cell), "-");
+        } else {
+            double v = value(*t, runs[i].model->summary());
+            int n = snprintf(cell, sizeof(cell), "%.*f", prec, v);
+            if (i > 0 && base != nullptr && n > 0 && std::fabs(v - bv) >= 0.5 * std::pow(10.0, -prec)) {
+                snprintf(cell + n, sizeof(cell) - n, " (%+.*f)", prec, v - bv);
+            }
+        }
+        printf(" %*s", kCol, cell);
+    }
+    printf("\n");
+}
+
+void print_verdict(const std::vector<Run> &runs, uint32_t starve_ms) {
+    const Run &b = runs[0];
+    const Summary &bs = b.model->summary();
+    double brate = bs.span_ms() ? bs.switches * 1000.0 / bs.span_ms() : 0;
+    printf("\nverdict against [0] %s:\n", base_name(b.path));
+    for (size_t i = 1; i < runs.size(); i++) {
+        const SchedModel &m = *runs[i].model;
+        const Summary &s = m.summary();
+        double rate = s.span_ms() ? s.switches * 1000.0 / s.span_ms() : 0;
+
+        std::string shift_task = "-";
+        double shift = 0;
+        std::string starved;
+        for (const TaskStats &t : m.tasks()) {
+            const TaskStats *bt = find_task(*b.model, t.name);
+            double d = cpu_share(t, s) - (bt ? cpu_share(*bt, bs) : 0.0);
+            if (std::fabs(d) > std::fabs(shift)) {
+                shift = d;
+                shift_task = t.name;
+            }
+            Starvation st = starvation(t, s, starve_ms);
+            Starvation bst = bt ? starvation(*bt, bs, starve_ms) : Starvation{};
+            if (st.windows > bst.windows || st.max_ms > bst.max_ms) {
+                char buf[96];
+                snprintf(buf, sizeof(buf), "%s%s (%llu windows, max %u ms)", starved.empty() ? "" : ", ",
+                         t.name.c_str(), static_cast<unsigned long long>(st.windows), st.max_ms);
+                starved += buf;
+            }
+        }
+        printf("[%zu] %s: switches %.1f/s (%+.1f), biggest cpu shift %s %+.2f pp, starves more: %s\n", i,
+               base_name(runs[i].path), rate, rate - brate, shift_task.c_str(), shift,
+               starved.empty() ? "none" : starved.c_str());
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Options opt;
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+    uint32_t starve_ms = 500;
+    int c;
+    while ((c = getopt(argc, argv, "anj:s:t:h")) != -1) {
+        switch (c) {
+        case 'a': opt.all = true; break;
+        case 'n': opt.extra = false; break;
+        case 'j': jobs = std::max(1, atoi(optarg)); break;
+        case 's': starve_ms = static_cast<uint32_t>(strtoul(optarg, nullptr, 10)); break;
+        case 't': opt.tags = split_tags(optarg); break;
+        default: usage(argv[0]); return c == 'h' ? 0 : 2;
+        }
+    }
+    if (argc - optind < 2) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<Run> runs(argc - optind);
+    for (size_t i = 0; i < runs.size(); i++) runs[i].path = argv[optind + i];
+
+    //each worker takes the next unclaimed log, the logs share nothing but the read only options
+    auto t0 = std::chrono::steady_clock::now();
+    std::atomic<size_t> next{0};
+    auto worker = [&] {
+        for (size_t i; (i = next.fetch_add(1)) < runs.size();) {
+            try {
+                MappedFile file(runs[i].path);
+                auto model = std::make_unique<SchedModel>(opt);
+                model->analyze(file.bytes());
+                runs[i].model = std::move(model);
+            } catch (const std::exception &e) {
+                runs[i].error = e.what();
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    jobs = std::min<unsigned>(jobs, runs.size());
+    for (unsigned i = 1; i < jobs; i++) pool.emplace_back(worker);
+    worker();
+    for (auto &th : pool) th.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    uint64_t bytes = 0;
+    for (const Run &r : runs) {
+        if (!r.error.empty()) {
+            fprintf(stderr, "schedcmp: %s\n", r.error.c_str());
+            return 1;
+        }
+        bytes += r.model->summary().bytes;
+    }
+
+    for (size_t i = 0; i < runs.size(); i++) {
+        const Summary &s = runs[i].model->summary();
+        printf("[%zu] %s: span %u ms, switches %llu%s\n", i, runs[i].path, s.span_ms(),
+               static_cast<unsigned long long>(s.switches), i == 0 ? " (baseline)" : "");
+    }
+    printf("%zu logs, %.1f MB in %.3f s on %u threads\n\n", runs.size(), bytes / 1e6, secs, jobs);
+
+    printf("%-24s %-12s", "task", "metric");
+    for (size_t i = 0; i < runs.size(); i++) {
+        char head[24];
+        snprintf(head, sizeof(head), "[%zu]", i);
+        printf(" %*s", kCol, head);
+    }
+    printf("\n");
+
+    //tasks in order of first appearance over all logs
+    std::vector<std::string> names;
+    for (const Run &r : runs) {
+        for (const TaskStats &t : r.model->tasks()) {
+            if (std::find(names.begin(), names.end(), t.name) == names.end()) names.push_back(t.name);
+        }
+    }
+    char starve_label[32];
+    snprintf(starve_label, sizeof(starve_label), "starved>=%u", starve_ms);
+    for (const std::string &name : names) {
+        metric_row(name.c_str(), "cpu%", runs, name, 2,
+                   [](const TaskStats &t, const Summary &s) { return cpu_share(t, s); });
+        metric_row("", "gap_mean", runs, name, 1, [](const TaskStats &t, const Summary &) { return mean(t.gaps); });
+        metric_row("", "gap_p99", runs, name, 0,
+                   [](const TaskStats &t, const Summary &) { return static_cast<double>(percentile(t.gaps, 99)); });
+        metric_row("", starve_label, runs, name, 0, [&](const TaskStats &t, const Summary &s) {
+            return static_cast<double>(starvation(t, s, starve_ms).windows);
+        });
+        metric_row("", "starved_max", runs, name, 0, [&](const TaskStats &t, const Summary &s) {
+            return static_cast<double>(starvation(t, s, starve_ms).max_ms);
+        });
+    }
+    print_verdict(runs, starve_ms);
+    return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * schedlog: scheduling statistics out of a captured serial log
+ * - every "(ts) TAG:" line is taken as "TAG is running at ts", see sched_model.hpp for the rules
+ * - prints per task line count, runs, busy time, cpu share, run length (timeslice) percentiles,
+ *   the gap between runs of the same task and a log2 histogram of the run lengths
+ * - the run lengths are only as fine as the esp_log ms clock and as complete as the logging of
+ *   the tasks, a task that never logs is counted in whoever logged before it
+ */
+#include <getopt.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+
+#include "schedlog/mapped_file.hpp"
+#include "schedlog/sched_model.hpp"
+
+using namespace schedlog;
+
+namespace {
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-a] [-n] [-H] [-c] [-t TAG,TAG...] LOG...\n"
+            "  -a  include the boot output before \"Starting scheduler\"\n"
+            "  -n  ignore \"(ts) TAG:\" pairs inside messages (e.g. the idle timestamp)\n"
+            "  -H  print the run length histograms\n"
+            "  -c  csv output, one row per task\n"
+            "  -t  only these tags are tasks\n",
+            prog);
+}
+
+std::vector<std::string> split_tags(const char *arg) {
+    std::vector<std::string> out;
+    std::string cur;
+    for (const char *p = arg;; p++) {
+        if (*p == ',' || *p == '\0') {
+            if (!cur.empty()) out.push_back(cur);
+            cur.clear();
+            if (*p == '\0') break;
+        } else {
+            cur += *p;
+        }
+    }
+    return out;
+}
+
+void print_histogram(const TaskStats &t) {
+    size_t top = 0;
+    for (size_t b = 0; b < kHistBuckets; b++) {
+        if (t.hist[b] != 0) top = b;
+    }
+    printf("  %-24s", t.name.c_str());
+    for (size_t b = 0; b <= top; b++) {
+        char label[32];
+        if (b == 0) snprintf(label, sizeof(label), "0");
+        else if (b == 1) snprintf(label, sizeof(label), "1");
+        else if (b + 1 == kHistBuckets) snprintf(label, sizeof(label), "%u+", 1u << (b - 1));
+        else snprintf(label, sizeof(label), "%u-%u", 1u << (b - 1), (1u << b) - 1);
+        printf(" %s:%llu", label, static_cast<unsigned long long>(t.hist[b]));
+    }
+    printf("\n");
+}
+
+void print_text(const char *path, const SchedModel &m, double secs, bool hist) {
+    const Summary &s = m.summary();
+    uint32_t span = s.span_ms();
+    printf("== %s\n", path);
+    printf("bytes %llu, lines %llu, parsed %llu, events %llu, segments %u, clamped %llu\n",
+           static_cast<unsigned long long>(s.bytes), static_cast<unsigned long long>(s.lines),
+           static_cast<unsigned long long>(s.parsed), static_cast<unsigned long long>(s.events), s.segments,
+           static_cast<unsigned long long>(s.clamped));
+    printf("span %u ms, switches %llu (%.1f/s), parsed in %.3f s (%.0f MB/s)\n", span,
+           static_cast<unsigned long long>(s.switches), span ? s.switches * 1000.0 / span : 0.0, secs,
+           secs > 0 ? s.bytes / secs / 1e6 : 0.0);
+    printf("%-24s %9s %8s %9s %6s %7s %5s %5s %6s %7s %6s %7s\n", "task", "lines", "runs", "busy_ms", "cpu%",
+           "mean", "p50", "p99", "max", "gap_avg", "gap99", "gap_max");
+    for (const TaskStats &t : m.tasks()) {
+        uint32_t smax = t.slices.empty() ? 0 : percentile(t.slices, 100);
+        uint32_t gmax = t.gaps.empty() ? 0 : percentile(t.gaps, 100);
+        printf("%-24s %9llu %8llu %9llu %6.2f %7.2f %5u %5u %6u %7.1f %6u %7u\n", t.name.c_str(),
+               static_cast<unsigned long long>(t.lines), static_cast<unsigned long long>(t.runs),
+               static_cast<unsigned long long>(t.busy_ms), span ? t.busy_ms * 100.0 / span : 0.0, mean(t.slices),
+               percentile(t.slices, 50), percentile(t.slices, 99), smax, mean(t.gaps), percentile(t.gaps, 99),
+               gmax);
+    }
+    if (hist) {
+        printf("run length histogram (ms):\n");
+        for (const TaskStats &t : m.tasks()) print_histogram(t);
+    }
+}
+
+void print_csv(const char *path, const SchedModel &m, bool header) {
+    const Summary &s = m.summary();
+    uint32_t span = s.span_ms();
+    if (header) printf("file,task,lines,runs,busy_ms,cpu_pct,slice_mean,slice_p50,slice_p99,slice_max,gap_mean,gap_p99,gap_max,span_ms,switches\n");
+    for (const TaskStats &t : m.tasks()) {
+        printf("%s,%s,%llu,%llu,%llu,%.3f,%.3f,%u,%u,%u,%.3f,%u,%u,%u,%llu\n", path, t.name.c_str(),
+               static_cast<unsigned long long>(t.lines), static_cast<unsigned long long>(t.runs),
+               static_cast<unsigned long long>(t.busy_ms), span ? t.busy_ms * 100.0 / span : 0.0, mean(t.slices),
+               percentile(t.slices, 50), percentile(t.slices, 99), percentile(t.slices, 100), mean(t.gaps),
+               percentile(t.gaps, 99), percentile(t.gaps, 100), span, static_cast<unsigned long long>(s.switches));
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Options opt;
+    bool hist = false;
+    bool csv = false;
+    int c;
+    while ((c = getopt(argc, argv, "anHct:h")) != -1) {
+        switch (c) {
+        case 'a': opt.all = true; break;
+        case 'n': opt.extra = false; break;
+        case 'H': hist = true; break;
+        case 'c': csv = true; break;
+        case 't': opt.tags = split_tags(optarg); break;
+        default: usage(argv[0]); return c == 'h' ? 0 : 2;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int rc = 0;
+    for (int i = optind; i < argc; i++) {
+        try {
+            MappedFile file(argv[i]);
+            SchedModel model(opt);
+            auto t0 = std::chrono::steady_clock::now();
+            model.analyze(file.bytes());
+            double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            if (csv) print_csv(argv[i], model, i == optind);
+            else print_text(argv[i], model, secs, hist);
+        } catch (const std::exception &e) {
+            fprintf(stderr, "schedlog: %s\n", e.what());
+            rc = 1;
+        }
+    }
+    return rc;
+}
@@ -0,0 +1,325 @@
+#include "schedlog/tokenizer.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCHEDLOG_X86 1
+#endif
+
+namespace schedlog {
+
+namespace {
+
+constexpr size_t kBlock = 64;
+
+inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+//[A-Za-z0-9_.-] as a table, the tag loop is the hot part of the scalar prefix match
+struct TagTable {
+    bool t[256] = {};
+    constexpr TagTable() {
+        for (int c = 0; c < 256; c++) {
+            t[c] = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_' ||
+                   c == '-' || c == '.';
+        }
+    }
+};
+constexpr TagTable kTag;
+
+inline bool is_tag_char(char c) { return kTag.t[static_cast<unsigned char>(c)]; }
+
+inline bool is_level(char c) { return c == 'E' || c == 'W' || c == 'I' || c == 'D' || c == 'V'; }
+
+//swar: exact per byte equality as the high bit of each byte, then gathered into 8 mask bits
+//(byte i to bit i assumes a little endian host, which every x86 and arm linux box is)
+inline uint64_t eq_bytes(uint64_t w, uint64_t pat) {
+    constexpr uint64_t k7f = 0x7f7f7f7f7f7f7f7full;
+    uint64_t t = w ^ pat;
+    return ~(((t & k7f) + k7f) | t | k7f);
+}
+
+inline uint64_t gather_bits(uint64_t m) { return ((m >> 7) * 0x0102040810204080ull) >> 56; }
+
+void scan_scalar(const char *p, uint64_t &eol, uint64_t &esc) {
+    constexpr uint64_t kOnes = 0x0101010101010101ull;
+    uint64_t e = 0, x = 0;
+    for (size_t i = 0; i < kBlock; i += 8) {
+        uint64_t w;
+        memcpy(&w, p + i, sizeof(w));
+        e |= gather_bits(eq_bytes(w, kOnes * '\n') | eq_bytes(w, kOnes * '\r')) << i;
+        x |= gather_bits(eq_bytes(w, kOnes * 0x1b)) << i;
+    }
+    eol = e;
+    esc = x;
+}
+
+#ifdef SCHEDLOG_X86
+void scan_sse2(const char *p, uint64_t &eol, uint64_t &esc) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i es = _mm_set1_epi8('\x1b');
+    uint64_t e = 0, x = 0;
+    for (size_t i = 0; i < kBlock; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        uint32_t me = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, cr)));
+        uint32_t mx = _mm_movemask_epi8(_mm_cmpeq_epi8(v, es));
+        e |= static_cast<uint64_t>(me) << i;
+        x |= static_cast<uint64_t>(mx) << i;
+    }
+    eol = e;
+    esc = x;
+}
+
+__attribute__((target("avx2"))) void scan_avx2(const char *p, uint64_t &eol, uint64_t &esc) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i es = _mm256_set1_epi8('\x1b');
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32));
+    uint32_t elo = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(lo, nl), _mm256_cmpeq_epi8(lo, cr)));
+    uint32_t ehi = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(hi, nl), _mm256_cmpeq_epi8(hi, cr)));
+    uint32_t xlo = _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, es));
+    uint32_t xhi = _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, es));
+    eol = static_cast<uint64_t>(ehi) << 32 | elo;
+    esc = static_cast<uint64_t>(xhi) << 32 | xlo;
+}
+
+/*
+ * class masks of 32 bytes for the prefix: digits and tag characters
+ * - alpha is tested as (c | 0x20) in 'a'..'z', bytes >= 0x80 are negative and fall out of every range
+ */
+inline __m128i in_range_sse2(__m128i v, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)), _mm_cmpgt_epi8(_mm_set1_epi8(hi + 1), v));
+}
+
+void classify_sse2(const char *p, uint32_t &digit, uint32_t &tag) {
+    uint32_t d = 0, t = 0;
+    for (size_t i = 0; i < 32; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        __m128i dg = in_range_sse2(v, '0', '9');
+        __m128i al = in_range_sse2(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+        __m128i pu = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('_')),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('-')), _mm_cmpeq_epi8(v, _mm_set1_epi8('.'))));
+        d |= static_cast<uint32_t>(_mm_movemask_epi8(dg)) << i;
+        t |= static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(dg, _mm_or_si128(al, pu)))) << i;
+    }
+    digit = d;
+    tag = t;
+}
+
+__attribute__((target("avx2"))) inline __m256i in_range_avx2(__m256i v, char lo, char hi) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v));
+}
+
+__attribute__((target("avx2"))) void classify_avx2(const char *p, uint32_t &digit, uint32_t &tag) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i dg = in_range_avx2(v, '0', '9');
+    __m256i al = in_range_avx2(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+    __m256i pu = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')),
+                                 _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('-')),
+                                                 _mm256_cmpeq_epi8(v, _mm256_set1_epi8('.'))));
+    digit = _mm256_movemask_epi8(dg);
+    tag = _mm256_movemask_epi8(_mm256_or_si256(dg, _mm256_or_si256(al, pu)));
+}
+#endif
+
+Isa resolve(Isa isa) {
+    if (isa == Isa::Best) return best_isa();
+#ifdef SCHEDLOG_X86
+    if (isa == Isa::Avx2 && !__builtin_cpu_supports("avx2")) return Isa::Sse2;
+    return isa;
+#else
+    return Isa::Scalar;
+#endif
+}
+
+//strip trailing "ESC[...m"-like sequences, the idf colour reset sits right before the line break
+std::string_view trim_ansi_tail(std::string_view s) {
+    while (!s.empty()) {
+        size_t lim = s.size() > 16 ? s.size() - 16 : 0;
+        size_t e = s.rfind('\x1b');
+        if (e == std::string_view::npos || e < lim || e + 2 > s.size() - 1 || s[e + 1] != '[') break;
+        char fin = s.back();
+        if (!(fin >= 0x40 && fin <= 0x7e)) break;
+        bool params = true;
+        for (size_t i = e + 2; i + 1 < s.size(); i++) {
+            if (!(s[i] >= 0x30 && s[i] <= 0x3f)) {
+                params = false;
+                break;
+            }
+        }
+        if (!params) break;
+        s = s.substr(0, e);
+    }
+    return s;
+}
+
+}  // namespace
+
+Isa best_isa() {
+#ifdef SCHEDLOG_X86
+    return __builtin_cpu_supports("avx2") ? Isa::Avx2 : Isa::Sse2;
+#else
+    return Isa::Scalar;
+#endif
+}
+
+const char *isa_name(Isa isa) {
+    switch (isa) {
+    case Isa::Scalar: return "scalar";
+    case Isa::Sse2: return "sse2";
+    case Isa::Avx2: return "avx2";
+    default: return isa_name(best_isa());
+    }
+}
+
+size_t skip_ansi(std::string_view s, size_t i) {
+    while (i + 1 < s.size() && s[i] == '\x1b' && s[i + 1] == '[') {
+        i += 2;
+        while (i < s.size() && !(s[i] >= 0x40 && s[i] <= 0x7e)) i++;
+        if (i < s.size()) i++;
+    }
+    return i;
+}
+
+bool match_stamp(std::string_view s, size_t &i, Stamp &out) {
+    size_t p = i;
+    if (p >= s.size() || s[p] != '(') return false;
+    p++;
+    size_t digits = p;
+    uint64_t ms = 0;
+    while (p < s.size() && is_digit(s[p])) ms = ms * 10 + (s[p++] - '0');
+    if (p == digits || p - digits > 10 || ms > UINT32_MAX) return false;
+    if (p + 1 >= s.size() || s[p] != ')' || s[p + 1] != ' ') return false;
+    p += 2;
+    size_t tag = p;
+    while (p < s.size() && is_tag_char(s[p])) p++;
+    if (p == tag || p >= s.size() || s[p] != ':') return false;
+
+    out.ms = static_cast<uint32_t>(ms);
+    out.tag = s.substr(tag, p - tag);
+    i = p + 1;
+    return true;
+}
+
+LineTokenizer::LineTokenizer(std::string_view buf, Isa isa) : buf_(buf) {
+    switch (resolve(isa)) {
+#ifdef SCHEDLOG_X86
+    case Isa::Avx2: scan_ = scan_avx2; break;
+    case Isa::Sse2: scan_ = scan_sse2; break;
+#endif
+    default: scan_ = scan_scalar; break;
+    }
+#ifdef SCHEDLOG_X86
+    if (scan_ == scan_avx2) classify_ = classify_avx2;
+    else if (scan_ == scan_sse2) classify_ = classify_sse2;
+#endif
+    load(0);
+}
+
+/*
+ * "(ts) TAG:" at the start of text, from one 32 byte class mask when it is safe to read 32 bytes
+ * - the window may run past the line into the next ones, the length check keeps matches inside the line
+ * - a tag longer than the window falls back to the scalar match
+ */
+bool LineTokenizer::match_prefix(std::string_view t, size_t &i, Stamp &out) const {
+    const char *p = t.data() + i;
+    const char *end = buf_.data() + buf_.size();
+    size_t len = t.size() - i;
+    if (classify_ == nullptr || end - p < 32 || len < 5) return match_stamp(t, i, out);
+    if (p[0] != '(') return false;
+
+    uint32_t digit, tag;
+    classify_(p, digit, tag);
+    unsigned nd = __builtin_ctz(~(digit >> 1));
+    if (nd == 0 || nd > 10 || nd + 3 >= len || p[1 + nd] != ')' || p[2 + nd] != ' ') return false;
+    unsigned ts = nd + 3;
+    //the extra bit just past the window stops the count at 32 - ts
+    unsigned nt = __builtin_ctz(~(tag >> ts) | (1u << (32 - ts)));
+    if (ts + nt >= 32) return match_stamp(t, i, out);
+    if (nt == 0 || ts + nt >= len || p[ts + nt] != ':') return false;
+
+    uint64_t ms = 0;
+    for (unsigned k = 1; k <= nd; k++) ms = ms * 10 + (p[k] - '0');
+    if (ms > UINT32_MAX) return false;
+    out.ms = static_cast<uint32_t>(ms);
+    out.tag = std::string_view(p + ts, nt);
+    i += ts + nt + 1;
+    return true;
+}
+
+//classify the block at base, the last partial block is scanned from a zero padded copy
+void LineTokenizer::load(size_t base) {
+    base_ = base;
+    if (base >= buf_.size()) {
+        eol_ = esc_ = 0;
+    } else if (base + kBlock <= buf_.size()) {
+        scan_(buf_.data() + base, eol_, esc_);
+    } else {
+        char pad[kBlock] = {};
+        memcpy(pad, buf_.data() + base, buf_.size() - base);
+        scan_(pad, eol_, esc_);
+    }
+}
+
+//move to p and drop the mask bits before it
+void LineTokenizer::seek(size_t p) {
+    pos_ = p;
+    if (p >= base_ + kBlock) load(p & ~(kBlock - 1));
+    uint64_t keep = ~0ull << (p - base_);
+    eol_ &= keep;
+    esc_ &= keep;
+}
+
+bool LineTokenizer::next(LineView &out) {
+    const size_t n = buf_.size();
+    if (pos_ >= n) return false;
+
+    size_t start = pos_;
+    uint32_t esc = 0;
+    size_t end;
+    for (;;) {
+        if (eol_ != 0) {
+            unsigned bit = __builtin_ctzll(eol_);
+            esc += __builtin_popcountll(esc_ & ((1ull << bit) - 1));
+            end = base_ + bit;
+            break;
+        }
+        esc += __builtin_popcountll(esc_);
+        if (base_ + kBlock >= n) {
+            end = n;
+            break;
+        }
+        load(base_ + kBlock);
+    }
+
+    size_t after = end;
+    if (end < n) after = (buf_[end] == '\r' && end + 1 < n && buf_[end + 1] == '\n') ? end + 2 : end + 1;
+    if (after < n) seek(after);
+    else pos_ = n;
+
+    std::string_view raw = buf_.substr(start, end - start);
+    out.raw = raw;
+    out.esc = esc;
+    out.text = esc ? trim_ansi_tail(raw.substr(skip_ansi(raw, 0))) : raw;
+    out.has_stamp = false;
+    out.level = 0;
+    out.msg = {};
+
+    std::string_view t = out.text;
+    size_t i = 0;
+    if (t.size() > 1 && t[1] == ' ' && is_level(t[0])) {
+        out.level = t[0];
+        i = 2;
+    }
+    if (match_prefix(t, i, out.stamp)) {
+        out.has_stamp = true;
+        out.msg = t.substr(i);
+    } else {
+        out.level = 0;
+    }
+    return true;
+}
+
+}  // namespace schedlog